@@ -1,12 +1,18 @@
 #pragma once
 #include <windows.h>
+#include <atomic>
 #include <thread>
 #include <vector>
 #include <mutex>
+#include <map>
 #include <set>
-#include <condition_variable>
 #include <sstream>
 
+#include "event_record.h"
+#include "event_ring.h"
+#include "message_filter.h"
+#include "shm_ring.h"
+
 static HHOOK     g_hook_handle_sys = nullptr;
 static HHOOK     g_hook_handle_wnd = nullptr;
 static HINSTANCE g_hDll = nullptr;
@@ -16,12 +22,13 @@ LRESULT CALLBACK SysMsgProc(int nCode, WPARAM wParam, LPARAM lParam);
 LRESULT CALLBACK CallWndProc(int nCode, WPARAM wParam, LPARAM lParam);
 extern "C" __declspec(dllexport) BOOL Initialize();
 extern "C" __declspec(dllexport) BOOL SetApprovedList(int* list);
+extern "C" __declspec(dllexport) BOOL SetMessageRule(int message, int* notify_codes, const wchar_t* window_class, const wchar_t* window_title, HWND root, int max_per_second);
+extern "C" __declspec(dllexport) BOOL ClearMessageRules();
 extern "C" __declspec(dllexport) HINSTANCE getDllHinstance() {
     return g_hDll;
 }
 
 class PipeManager {
-    const static size_t m_msg_size = sizeof(MSG);
     std::wstring m_pipe_name = L"\\\\.\\pipe\\pywinauto_recorder_pipe";
 
     HANDLE m_h_pipe;
@@ -61,17 +68,122 @@ public:
         CloseHandle(m_h_pipe);
     }
 
-    void send_message(const MSG* msg)
+    // One pipe message per frame (see event_record.h)
+    bool send_frame(const void* data, size_t size)
     {
         if (!m_pipe_initialized)
-            return;
+            return false;
 
-        if (!WriteFile(m_h_pipe, static_cast<const void*>(msg), static_cast<DWORD>(m_msg_size), &m_written_bytes, nullptr))
+        if (!WriteFile(m_h_pipe, data, static_cast<DWORD>(size), &m_written_bytes, nullptr))
         {
             CloseHandle(m_h_pipe);
             m_pipe_initialized = false;
             m_have_to_close = false;
+            return false;
         }
+        return true;
+    }
+};
+
+// Opt-in alternative to the pipe (see shm_ring.h): used when the recorder has created the
+// mapping and the wakeup event before Initialize(), otherwise we fall back to the pipe.
+class SharedMemoryChannel {
+    std::wstring m_mapping_name = L"Local\\pywinauto_recorder_shm";
+    std::wstring m_event_name   = L"Local\\pywinauto_recorder_shm_event";
+
+    HANDLE  m_h_mapping = nullptr;
+    HANDLE  m_h_wake    = nullptr;
+    void*   m_view      = nullptr;
+    ShmRing m_ring;
+
+    void release()
+    {
+        if (m_view)
+            UnmapViewOfFile(m_view);
+        if (m_h_wake)
+            CloseHandle(m_h_wake);
+        if (m_h_mapping)
+            CloseHandle(m_h_mapping);
+
+        m_view = nullptr;
+        m_h_wake = nullptr;
+        m_h_mapping = nullptr;
+        m_ring = ShmRing();
+    }
+
+public:
+    SharedMemoryChannel() {}
+
+    SharedMemoryChannel(const SharedMemoryChannel&) = delete;
+    SharedMemoryChannel& operator=(const SharedMemoryChannel&) = delete;
+
+    bool initialize(const HelloPayload& hello)
+    {
+        m_h_mapping = OpenFileMappingW(FILE_MAP_READ | FILE_MAP_WRITE, FALSE, m_mapping_name.c_str());
+        if (!m_h_mapping)
+            return false;
+
+        m_h_wake = OpenEventW(EVENT_MODIFY_STATE, FALSE, m_event_name.c_str());
+        m_view = MapViewOfFile(m_h_mapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, 0);
+
+        MEMORY_BASIC_INFORMATION info = {};
+        if (m_view && VirtualQuery(m_view, &info, sizeof(info)))
+            m_ring = ShmRing::attach(m_view, info.RegionSize);
+
+        if (!m_h_wake || !m_ring.attached())
+        {
+            release();
+            return false;
+        }
+
+        m_ring.announce(hello);
+        return true;
+    }
+
+    ~SharedMemoryChannel()
+    {
+        release();
+    }
+
+    bool initialized() const
+    {
+        return m_ring.attached();
+    }
+
+    void send(const EventRecord* records, size_t count, uint64_t dropped)
+    {
+        if (m_ring.write(records, count, dropped))
+            SetEvent(m_h_wake);
+    }
+
+    void close()
+    {
+        if (initialized() && m_ring.close())
+            SetEvent(m_h_wake);
+    }
+};
+
+// Window queries for MessageRule::accepts
+struct HookWindows {
+    bool class_is(uintptr_t hwnd, const std::wstring& name) const
+    {
+        wchar_t buffer[256];
+        const int length = GetClassNameW(reinterpret_cast<HWND>(hwnd), buffer, 256);
+        return length > 0 && _wcsicmp(buffer, name.c_str()) == 0;
+    }
+
+    // InternalGetWindowText reads the stored title; GetWindowText would send WM_GETTEXT
+    // to a window of another thread from inside its hook callback.
+    bool title_is(uintptr_t hwnd, const std::wstring& title) const
+    {
+        wchar_t buffer[256];
+        const int length = InternalGetWindowText(reinterpret_cast<HWND>(hwnd), buffer, 256);
+        return length > 0 && title.compare(0, std::wstring::npos, buffer, length) == 0;
+    }
+
+    bool is_within(uintptr_t hwnd, uintptr_t root) const
+    {
+        return hwnd == root || IsChild(reinterpret_cast<HWND>(root), reinterpret_cast<HWND>(hwnd));
     }
 };
 
@@ -84,28 +196,127 @@ class InjectorManager {
         pipe_failed,
     };
 
-    bool                            m_hook_stop_thread = false;
+    // Records per pipe write; the pipe is in message mode, so this bounds the message size.
+    const static size_t m_max_batch = 256;
+
+    std::atomic<bool>               m_hook_stop_thread{ false };
     HookStatus                      m_status = undefined;
     PipeManager                     m_pipe_manager;
-    std::set<int>                   m_approved_messages_ids;
+    SharedMemoryChannel             m_shm_channel;
     std::unique_ptr<std::thread>    m_hook_thread;
-    std::condition_variable         m_hook_cv;
-    std::mutex                      m_hook_mutex;
-    std::mutex                      m_send_mutex;
+
+    // Hot path reads m_filter only; the rest is for SetApprovedList / SetMessageRule.
+    FilterSlot                      m_filter;
+    std::set<int>                   m_approved_messages_ids;
+    std::map<uint32_t, MessageRule> m_rules;
+    std::mutex                      m_filter_mutex;
+
+    // Hook callbacks only push into the ring; the hook thread drains it into the pipe.
+    MpscRing<EventRecord, 4096>     m_ring;
+    std::atomic<bool>               m_sender_idle{ false };
+    HANDLE                          m_sender_wake = nullptr;
 
 private:
-    void cpu_save_infinite_wait() {
-        std::unique_lock<std::mutex> lock(m_hook_mutex);
-        while (!m_hook_stop_thread)
+    // Runs on the hook thread until stop_sender(): one pipe write per batch of messages,
+    // so a slow recorder only fills the ring instead of stalling the hooked threads.
+    void run_sender() {
+        std::vector<unsigned char> frame;
+        std::vector<EventRecord> batch(m_max_batch);
+        for (;;)
         {
-            m_hook_cv.wait(lock);
+            const bool stopping = m_hook_stop_thread.load(std::memory_order_acquire);
+            const size_t count = m_ring.pop_bulk(batch.data(), batch.size());
+            const uint64_t dropped = m_ring.take_dropped();
+            if (count || dropped)
+            {
+                if (m_shm_channel.initialized())
+                {
+                    m_shm_channel.send(batch.data(), count, dropped);
+                }
+                else
+                {
+                    encode_events(frame, batch.data(), static_cast<uint32_t>(count), dropped);
+                    m_pipe_manager.send_frame(frame.data(), frame.size());
+                }
+                continue;
+            }
+            if (stopping)
+                break;
+
+            // Producers signal only while we are idle. The timeout covers a push that
+            // raced with going idle.
+            m_sender_idle.store(true, std::memory_order_seq_cst);
+            if (m_ring.empty())
+                WaitForSingleObject(m_sender_wake, 50);
+            m_sender_idle.store(false, std::memory_order_relaxed);
         }
     }
 
-    void stop_infinite_wait() {
-        std::unique_lock<std::mutex> lock(m_hook_mutex);
-        m_hook_stop_thread = true;
-        m_hook_cv.notify_one();
+    // m_filter_mutex must be held
+    void publish_filter() {
+        std::vector<MessageRule> rules;
+        for (const auto& rule : m_rules)
+            rules.push_back(rule.second);
+
+        m_filter.publish(std::make_unique<MessageFilter>(m_approved_messages_ids.begin(), m_approved_messages_ids.end(), std::move(rules)));
+    }
+
+    static HelloPayload make_hello() {
+        LARGE_INTEGER frequency;
+        QueryPerformanceFrequency(&frequency);
+
+        HelloPayload hello = {};
+        hello.qpc_frequency = static_cast<uint64_t>(frequency.QuadPart);
+        hello.process_id    = GetCurrentProcessId();
+        hello.pointer_bits  = static_cast<uint32_t>(sizeof(void*) * 8);
+        hello.record_size   = sizeof(EventRecord);
+        return hello;
+    }
+
+    // Shared memory if the recorder set it up, the pipe otherwise
+    bool connect() {
+        const HelloPayload hello = make_hello();
+        if (m_shm_channel.initialize(hello))
+            return true;
+
+        if (!m_pipe_manager.initialize())
+            return false;
+
+        std::vector<unsigned char> frame;
+        encode_hello(frame, hello);
+        m_pipe_manager.send_frame(frame.data(), frame.size());
+        return true;
+    }
+
+    void enqueue(const MessageFilter* filter, const MSG& msg, uint32_t notify_code, bool is_notify)
+    {
+        const MessageRule* rule = filter->rule(msg.message);
+        if (rule && !rule->accepts(reinterpret_cast<uintptr_t>(msg.hwnd), notify_code, GetTickCount64(), HookWindows()))
+            return;
+
+        LARGE_INTEGER now;
+        QueryPerformanceCounter(&now);
+
+        EventRecord record;
+        record.timestamp   = static_cast<uint64_t>(now.QuadPart);
+        record.hwnd        = reinterpret_cast<uintptr_t>(msg.hwnd);
+        record.wparam      = static_cast<uint64_t>(msg.wParam);
+        record.lparam      = static_cast<int64_t>(msg.lParam);
+        record.message     = msg.message;
+        record.thread_id   = GetCurrentThreadId();
+        record.notify_code = notify_code;
+        record.flags       = is_notify ? event_has_notify_code : 0;
+
+        // The sequence number is the ring slot, so it matches the order records are sent in.
+        // Full ring: the event is dropped and counted in the next frame.
+        const bool pushed = m_ring.push(record, [](EventRecord& r, uint64_t ticket) { r.sequence = ticket; });
+        if (pushed && m_sender_idle.exchange(false, std::memory_order_seq_cst))
+            SetEvent(m_sender_wake);
+    }
+
+    void stop_sender() {
+        m_hook_stop_thread.store(true, std::memory_order_release);
+        SetEvent(m_sender_wake);
         if (m_hook_thread && m_hook_thread->joinable())
             m_hook_thread->join();
     }
@@ -120,22 +331,32 @@ public:
 
     void send_msg(const MSG* msg)
     {
-        std::lock_guard<std::mutex> lg(m_send_mutex);
-        if (m_approved_messages_ids.count(msg->message))
-            m_pipe_manager.send_message(msg);
+        const MessageFilter* filter = m_filter.current();
+        if (!filter || !filter->approved(msg->message))
+            return;
+
+        enqueue(filter, *msg, 0, false);
     }
 
     void send_msg(const CWPSTRUCT* data)
     {
+        // Most WH_CALLWNDPROC traffic is not approved: reject it before copying anything
+        // or touching the NMHDR behind lParam.
+        const MessageFilter* filter = m_filter.current();
+        if (!filter || !filter->approved(data->message))
+            return;
+
         MSG msg = { data->hwnd, data->message, data->wParam, data->lParam };
+        uint32_t notify_code = 0;
         if (data->message == WM_NOTIFY)
         {
             LPNMHDR hdr = (LPNMHDR)(data->lParam);
+            notify_code = hdr->code;
             msg.lParam = hdr->code;
             msg.hwnd = hdr->hwndFrom;
         }
 
-        send_msg(&msg);
+        enqueue(filter, msg, notify_code, data->message == WM_NOTIFY);
     }
     
     int get_status() const
@@ -145,15 +366,34 @@ public:
 
     void parse_skip_list(int** list)
     {
+        std::lock_guard<std::mutex> lg(m_filter_mutex);
         size_t size = static_cast<size_t>((*list)[0]);
         for (size_t i = 0; i < size; ++i)
             m_approved_messages_ids.insert((*list)[i + 1]);
+
+        publish_filter();
+    }
+
+    void set_rule(MessageRule rule)
+    {
+        std::lock_guard<std::mutex> lg(m_filter_mutex);
+        const uint32_t message = rule.message;
+        m_rules[message] = std::move(rule);
+        publish_filter();
+    }
+
+    void clear_rules()
+    {
+        std::lock_guard<std::mutex> lg(m_filter_mutex);
+        m_rules.clear();
+        publish_filter();
     }
 
     void initialize()
     {
+        m_sender_wake = CreateEventW(nullptr, FALSE, FALSE, nullptr);
         m_hook_thread = std::make_unique<std::thread>([&] {
-            if (!m_pipe_manager.initialize())
+            if (!connect())
             {
                 m_status = HookStatus::pipe_failed;
                 return;
@@ -165,7 +405,7 @@ public:
             if (g_hook_handle_sys && g_hook_handle_wnd)
             {
                 m_status = HookStatus::success;
-                cpu_save_infinite_wait();
+                run_sender();
             }
             else
             {
@@ -176,18 +416,29 @@ public:
 
     ~InjectorManager() {
 
-        MSG msg = {};
-        msg.message = 0xFFFFFFFF;
-        m_pipe_manager.send_message(&msg);
-
         if (g_hook_handle_sys && UnhookWindowsHookEx(g_hook_handle_sys))
             g_hook_handle_sys = nullptr;
 
         if (g_hook_handle_wnd && UnhookWindowsHookEx(g_hook_handle_wnd))
             g_hook_handle_wnd = nullptr;
 
+        // Flushes what is left in the ring before the end marker goes out.
         if (m_status == HookStatus::success)
-            stop_infinite_wait();
+            stop_sender();
+
+        if (m_shm_channel.initialized())
+        {
+            m_shm_channel.close();
+        }
+        else
+        {
+            std::vector<unsigned char> frame;
+            encode_end(frame);
+            m_pipe_manager.send_frame(frame.data(), frame.size());
+        }
+
+        if (m_sender_wake)
+            CloseHandle(m_sender_wake);
     }
 
     static auto& instance() {
@@ -216,6 +467,36 @@ BOOL SetApprovedList(int* list)
     return TRUE;
 }
 
+// Narrows down an approved message (rules never approve anything by themselves);
+// replaces the previous rule for the same message. notify_codes has the SetApprovedList
+// layout (count first) and may be null, as may window_class and root.
+// max_per_second <= 0 means no rate limit.
+BOOL SetMessageRule(int message, int* notify_codes, const wchar_t* window_class, const wchar_t* window_title, HWND root, int max_per_second)
+{
+    MessageRule rule;
+    rule.message = static_cast<uint32_t>(message);
+    if (notify_codes)
+    {
+        for (int i = 0; i < notify_codes[0]; ++i)
+            rule.notify_codes.push_back(static_cast<uint32_t>(notify_codes[i + 1]));
+    }
+    if (window_class)
+        rule.window_class = window_class;
+    if (window_title)
+        rule.window_title = window_title;
+    rule.root = reinterpret_cast<uintptr_t>(root);
+    rule.rate = RateLimiter(max_per_second > 0 ? static_cast<uint32_t>(max_per_second) : 0);
+
+    InjectorManager::instance().set_rule(std::move(rule));
+    return TRUE;
+}
+
+BOOL ClearMessageRules()
+{
+    InjectorManager::instance().clear_rules();
+    return TRUE;
+}
+
 template<typename M>
 LRESULT HandleWindowMessage(HHOOK hook_handle, int nCode, WPARAM wParam, LPARAM lParam)
 {
@@ -0,0 +1,156 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// Wire format of the hook -> recorder stream. Fixed layout (no pointer-sized fields,
+// little-endian like every Windows target), so 32- and 64-bit hooks look the same to one
+// recorder. Portable: encoder and decoder build anywhere.
+//
+// Every pipe message is one frame: FrameHeader followed by its payload.
+//   frame_hello   HelloPayload, first frame after connecting
+//   frame_events  `count` EventRecord back to back
+//   frame_end     no payload, last frame before the hook goes away
+// Records are numbered per hooked process in the order they are sent, so `sequence`
+// increases by one from record to record. Events lost to a full queue are counted in
+// `dropped` (they never got a number); a gap in `sequence` means frames were lost.
+
+const static uint32_t event_frame_magic   = 0x4B4F4F48; // "HOOK"
+const static uint16_t event_frame_version = 1;
+
+enum FrameKind : uint16_t
+{
+    frame_hello = 1,
+    frame_events,
+    frame_end,
+};
+
+struct FrameHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t kind;
+    uint32_t count;    // records in the payload (frame_events)
+    uint32_t dropped;  // records lost to a full queue since the previous frame
+};
+static_assert(sizeof(FrameHeader) == 16, "FrameHeader layout is part of the protocol");
+
+struct HelloPayload {
+    uint64_t qpc_frequency;  // timestamp ticks per second
+    uint32_t process_id;
+    uint32_t pointer_bits;   // 32 or 64: the hooked process
+    uint32_t record_size;    // sizeof(EventRecord)
+    uint32_t reserved;
+};
+static_assert(sizeof(HelloPayload) == 24, "HelloPayload layout is part of the protocol");
+
+enum EventFlags : uint32_t
+{
+    event_has_notify_code = 1,  // WM_NOTIFY: hwnd is NMHDR::hwndFrom, notify_code is NMHDR::code
+};
+
+struct EventRecord {
+    uint64_t timestamp;    // QueryPerformanceCounter ticks
+    uint64_t sequence;
+    uint64_t hwnd;
+    uint64_t wparam;
+    int64_t  lparam;       // sign-extended on 32-bit targets
+    uint32_t message;
+    uint32_t thread_id;
+    uint32_t notify_code;
+    uint32_t flags;        // EventFlags
+};
+static_assert(sizeof(EventRecord) == 56, "EventRecord layout is part of the protocol");
+
+inline void encode_header(std::vector<unsigned char>& frame, uint16_t kind, uint32_t count, uint32_t dropped, size_t payload_size)
+{
+    FrameHeader header;
+    header.magic   = event_frame_magic;
+    header.version = event_frame_version;
+    header.kind    = kind;
+    header.count   = count;
+    header.dropped = dropped;
+
+    frame.resize(sizeof(header) + payload_size);
+    std::memcpy(frame.data(), &header, sizeof(header));
+}
+
+inline size_t encode_hello(std::vector<unsigned char>& frame, const HelloPayload& hello)
+{
+    encode_header(frame, frame_hello, 0, 0, sizeof(hello));
+    std::memcpy(frame.data() + sizeof(FrameHeader), &hello, sizeof(hello));
+    return frame.size();
+}
+
+inline size_t encode_events(std::vector<unsigned char>& frame, const EventRecord* records, uint32_t count, uint64_t dropped)
+{
+    encode_header(frame, frame_events, count, dropped > UINT32_MAX ? UINT32_MAX : static_cast<uint32_t>(dropped),
+                  count * sizeof(EventRecord));
+    if (count)
+        std::memcpy(frame.data() + sizeof(FrameHeader), records, count * sizeof(EventRecord));
+    return frame.size();
+}
+
+inline size_t encode_end(std::vector<unsigned char>& frame)
+{
+    encode_header(frame, frame_end, 0, 0, 0);
+    return frame.size();
+}
+
+enum DecodeStatus
+{
+    decode_ok = 0,
+    decode_truncated,    // shorter than the header or than the payload it announces
+    decode_bad_magic,
+    decode_bad_version,  // newer protocol than this decoder
+    decode_bad_kind,
+    decode_bad_size,     // trailing bytes after the payload
+};
+
+struct DecodedFrame {
+    FrameHeader              header = {};
+    HelloPayload             hello = {};
+    std::vector<EventRecord> events;
+};
+
+inline DecodeStatus decode_frame(const void* data, size_t size, DecodedFrame& out)
+{
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    if (size < sizeof(FrameHeader))
+        return decode_truncated;
+
+    std::memcpy(&out.header, bytes, sizeof(FrameHeader));
+    if (out.header.magic != event_frame_magic)
+        return decode_bad_magic;
+    if (out.header.version > event_frame_version)
+        return decode_bad_version;
+
+    size_t payload_size = 0;
+    switch (out.header.kind)
+    {
+    case frame_hello:  payload_size = sizeof(HelloPayload); break;
+    case frame_events: payload_size = static_cast<size_t>(out.header.count) * sizeof(EventRecord); break;
+    case frame_end:    payload_size = 0; break;
+    default:           return decode_bad_kind;
+    }
+
+    const size_t body = size - sizeof(FrameHeader);
+    if (body < payload_size)
+        return decode_truncated;
+    if (body > payload_size)
+        return decode_bad_size;
+
+    const unsigned char* payload = bytes + sizeof(FrameHeader);
+    out.events.clear();
+    if (out.header.kind == frame_hello)
+    {
+        std::memcpy(&out.hello, payload, sizeof(HelloPayload));
+    }
+    else if (out.header.kind == frame_events)
+    {
+        out.events.resize(out.header.count);
+        if (payload_size)
+            std::memcpy(out.events.data(), payload, payload_size);
+    }
+    return decode_ok;
+}
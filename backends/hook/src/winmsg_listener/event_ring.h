@@ -0,0 +1,122 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+// Portable core of the hook -> recorder path: hook callbacks (any GUI thread of the target)
+// push records into a bounded lock-free ring, one sender thread drains it in batches
+// (framing is in event_record.h).
+// No Windows dependencies, so it can be built and exercised on any platform.
+
+// Bounded multi-producer / single-consumer queue (D. Vyukov's bounded queue: every cell
+// carries a sequence number telling producers and the consumer whose turn it is).
+// push() never blocks, locks or allocates; when the ring is full the record is dropped
+// and counted, so a stalled recorder can't slow down the window procedures we hook.
+template <typename T, size_t Capacity>
+class MpscRing {
+    static_assert(Capacity >= 2 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+    static_assert(std::is_trivially_copyable<T>::value, "records are copied between threads by value");
+
+    // 64-bit positions even in 32-bit hooks: they double as record sequence numbers.
+    struct Cell {
+        std::atomic<uint64_t> seq;
+        T value;
+    };
+
+    static const size_t m_mask = Capacity - 1;
+
+    alignas(64) std::atomic<uint64_t> m_head{ 0 };  // next slot to claim (producers)
+    alignas(64) uint64_t              m_tail = 0;   // next slot to read (consumer only)
+    alignas(64) std::atomic<uint64_t> m_dropped{ 0 };
+    Cell m_cells[Capacity];
+
+public:
+    MpscRing()
+    {
+        for (size_t i = 0; i < Capacity; ++i)
+            m_cells[i].seq.store(i, std::memory_order_relaxed);
+    }
+
+    MpscRing(const MpscRing&) = delete;
+    MpscRing& operator=(const MpscRing&) = delete;
+
+    static constexpr size_t capacity() { return Capacity; }
+
+    // Any thread. Returns false (and counts a drop) if the ring is full.
+    bool push(const T& value) noexcept
+    {
+        return push(value, [](T&, uint64_t) {});
+    }
+
+    // Like push(value), but calls stamp(record, ticket) on the copy in the ring before it is
+    // published. Tickets number the claimed slots 0, 1, 2, ... and the consumer pops in
+    // ticket order, so a sequence number taken from the ticket is exactly the delivery
+    // order (one taken before push() is not: producers can be preempted in between).
+    template <typename Stamp>
+    bool push(const T& value, Stamp stamp) noexcept
+    {
+        uint64_t pos = m_head.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell& cell = m_cells[pos & m_mask];
+            const uint64_t seq = cell.seq.load(std::memory_order_acquire);
+            const int64_t diff = static_cast<int64_t>(seq - pos);
+            if (diff == 0)
+            {
+                if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    cell.value = value;
+                    stamp(cell.value, pos);
+                    cell.seq.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+            {
+                m_dropped.fetch_add(1, std::memory_order_relaxed);
+                return false;
+            }
+            else
+            {
+                pos = m_head.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    // Consumer thread only. Stops at a slot that has been claimed but not written yet,
+    // so records always come out in the order their slots were claimed.
+    bool pop(T& out) noexcept
+    {
+        Cell& cell = m_cells[m_tail & m_mask];
+        const uint64_t seq = cell.seq.load(std::memory_order_acquire);
+        if (seq != m_tail + 1)
+            return false;
+
+        out = cell.value;
+        cell.seq.store(m_tail + Capacity, std::memory_order_release);
+        ++m_tail;
+        return true;
+    }
+
+    // Consumer thread only: pops up to max records, returns how many.
+    size_t pop_bulk(T* out, size_t max) noexcept
+    {
+        size_t n = 0;
+        while (n < max && pop(out[n]))
+            ++n;
+        return n;
+    }
+
+    // Consumer thread only; a hint, producers may be adding records concurrently.
+    bool empty() const noexcept
+    {
+        return m_cells[m_tail & m_mask].seq.load(std::memory_order_acquire) != m_tail + 1;
+    }
+
+    // Records dropped since the previous call.
+    uint64_t take_dropped() noexcept
+    {
+        return m_dropped.exchange(0, std::memory_order_relaxed);
+    }
+};
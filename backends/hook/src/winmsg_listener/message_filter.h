@@ -0,0 +1,92 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "message_rules.h"
+
+// Approved-message filter checked by every hook callback. Portable (no Windows
+// dependencies) so it can be built and measured on any platform.
+
+// Immutable set of approved message ids. Ids below m_direct_limit (system messages,
+// WM_USER and WM_APP ranges) are one bit each; registered messages (0xC000 and up) are
+// rare, so they go to a small sorted vector. Approved ids may carry a MessageRule.
+class MessageFilter {
+public:
+    const static uint32_t m_direct_limit = 0xC000;
+
+    template <typename It>
+    MessageFilter(It first, It last, std::vector<MessageRule> rules = {})
+        : m_rules(std::move(rules))
+    {
+        for (; first != last; ++first)
+        {
+            const uint32_t message = static_cast<uint32_t>(*first);
+            if (message < m_direct_limit)
+                m_bits[message >> 6] |= uint64_t(1) << (message & 63);
+            else
+                m_high.push_back(message);
+        }
+        std::sort(m_high.begin(), m_high.end());
+        m_high.erase(std::unique(m_high.begin(), m_high.end()), m_high.end());
+
+        for (MessageRule& rule : m_rules)
+            std::sort(rule.notify_codes.begin(), rule.notify_codes.end());
+        std::sort(m_rules.begin(), m_rules.end(), [](const MessageRule& a, const MessageRule& b) {
+            return a.message < b.message;
+        });
+    }
+
+    MessageFilter(const MessageFilter&) = delete;
+    MessageFilter& operator=(const MessageFilter&) = delete;
+
+    bool approved(uint32_t message) const noexcept
+    {
+        if (message < m_direct_limit)
+            return (m_bits[message >> 6] >> (message & 63)) & 1;
+
+        return !m_high.empty() && std::binary_search(m_high.begin(), m_high.end(), message);
+    }
+
+    // Rule for an approved message, nullptr if it has none.
+    const MessageRule* rule(uint32_t message) const noexcept
+    {
+        if (m_rules.empty())
+            return nullptr;
+
+        auto it = std::lower_bound(m_rules.begin(), m_rules.end(), message, [](const MessageRule& r, uint32_t m) {
+            return r.message < m;
+        });
+        return it != m_rules.end() && it->message == message ? &*it : nullptr;
+    }
+
+private:
+    uint64_t                 m_bits[m_direct_limit / 64] = {};
+    std::vector<uint32_t>    m_high;
+    std::vector<MessageRule> m_rules;
+};
+
+// Current filter, swapped atomically so readers never lock. A hook callback may still be
+// looking at the previous filter after a swap, and we can't know when it is done, so
+// published filters are kept until the slot itself goes away (after the hooks are
+// removed). Updates are rare, so this costs a few KB per SetApprovedList call.
+class FilterSlot {
+    std::atomic<const MessageFilter*>           m_current{ nullptr };
+    std::vector<std::unique_ptr<MessageFilter>> m_published;
+
+public:
+    // Any thread. nullptr until the first publish().
+    const MessageFilter* current() const noexcept
+    {
+        return m_current.load(std::memory_order_acquire);
+    }
+
+    // Writers must be serialized by the caller.
+    void publish(std::unique_ptr<MessageFilter> filter)
+    {
+        m_current.store(filter.get(), std::memory_order_release);
+        m_published.push_back(std::move(filter));
+    }
+};
@@ -0,0 +1,78 @@
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Per-message rules that narrow down an approved message id. Portable: window
+// queries go through a caller supplied object (see MessageRule::accepts).
+
+// At most m_per_second events per wall-clock second, lock-free. Counting restarts at
+// each second boundary, so bursts straddling a boundary may get up to twice the limit.
+class RateLimiter {
+    uint32_t                      m_per_second = 0;
+    mutable std::atomic<uint64_t> m_window{ 0 };
+    mutable std::atomic<uint32_t> m_count{ 0 };
+
+public:
+    explicit RateLimiter(uint32_t per_second = 0) : m_per_second(per_second) {}
+
+    // Copies the limit, not the counters.
+    RateLimiter(const RateLimiter& other) : m_per_second(other.m_per_second) {}
+    RateLimiter& operator=(const RateLimiter& other)
+    {
+        m_per_second = other.m_per_second;
+        m_window.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        return *this;
+    }
+
+    uint32_t per_second() const { return m_per_second; }
+
+    bool allow(uint64_t now_ms) const noexcept
+    {
+        if (!m_per_second)
+            return true;
+
+        const uint64_t window = now_ms / 1000 + 1;
+        uint64_t seen = m_window.load(std::memory_order_relaxed);
+        if (seen != window && m_window.compare_exchange_strong(seen, window, std::memory_order_relaxed))
+            m_count.store(0, std::memory_order_relaxed);
+
+        return m_count.fetch_add(1, std::memory_order_relaxed) < m_per_second;
+    }
+};
+
+struct MessageRule {
+    uint32_t              message = 0;
+    std::vector<uint32_t> notify_codes;  // WM_NOTIFY only: accepted NMHDR::code values, empty = any
+    std::wstring          window_class;  // accepted window class (case-insensitive), empty = any
+    std::wstring          window_title;  // accepted window title (exact), empty = any
+    uintptr_t             root = 0;      // accepted window and its descendants, 0 = any
+    RateLimiter           rate;          // 0 = unlimited
+
+    // hwnd is the window the event is reported for (NMHDR::hwndFrom for WM_NOTIFY),
+    // notify_code is NMHDR::code for WM_NOTIFY and 0 otherwise. Windows must provide
+    //   bool class_is(uintptr_t hwnd, const std::wstring& name) const;
+    //   bool title_is(uintptr_t hwnd, const std::wstring& title) const;
+    //   bool is_within(uintptr_t hwnd, uintptr_t root) const;
+    // Cheap checks go first; the rate limit is consumed only by otherwise accepted events.
+    template <typename Windows>
+    bool accepts(uintptr_t hwnd, uint32_t notify_code, uint64_t now_ms, const Windows& windows) const
+    {
+        if (!notify_codes.empty() && !std::binary_search(notify_codes.begin(), notify_codes.end(), notify_code))
+            return false;
+
+        if (root && !windows.is_within(hwnd, root))
+            return false;
+
+        if (!window_class.empty() && !windows.class_is(hwnd, window_class))
+            return false;
+
+        if (!window_title.empty() && !windows.title_is(hwnd, window_title))
+            return false;
+
+        return rate.allow(now_ms);
+    }
+};
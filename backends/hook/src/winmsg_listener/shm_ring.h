@@ -0,0 +1,185 @@
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include "event_record.h"
+
+// Shared-memory alternative to the pipe: a single-producer / single-consumer ring of
+// EventRecord in a region mapped by both the hook (producer: the sender thread) and the
+// recorder (consumer). Portable: the region can be a Windows file mapping or POSIX shm,
+// the wakeup object is up to the platform code.
+//
+// Protocol:
+//   - The recorder creates the region and calls ShmRing::create(), then waits for
+//     `producer_pid` to become non-zero.
+//   - The hook calls attach() and announce(); announce() fills what frame_hello carries.
+//   - The producer copies records in and publishes them with one store of write_index.
+//     The consumer reads them in place (peek) and gives them back (release). Nothing is
+//     copied on the consumer side.
+//   - A full ring drops records. `dropped` counts them together with what the hook's own
+//     queue dropped; records dropped here had been numbered, so they also leave a gap.
+//   - Before sleeping the consumer sets consumer_waiting and re-checks the ring. The
+//     producer signals the wakeup object only if it clears a set consumer_waiting.
+//   - close() replaces frame_end.
+
+const static uint32_t shm_ring_magic   = 0x4D48534B; // "KSHM"
+const static uint16_t shm_ring_version = 1;
+
+struct ShmRingHeader {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t reserved;
+    uint32_t record_size;   // sizeof(EventRecord)
+    uint32_t capacity;      // records, power of two
+
+    // Filled by announce()
+    uint64_t              qpc_frequency;
+    uint32_t              pointer_bits;
+    std::atomic<uint32_t> producer_pid;
+
+    alignas(64) std::atomic<uint64_t> write_index;   // producer
+    alignas(64) std::atomic<uint64_t> read_index;    // consumer
+    alignas(64) std::atomic<uint64_t> dropped;       // records lost, see write()
+    std::atomic<uint32_t>             consumer_waiting;
+    std::atomic<uint32_t>             closed;
+};
+static_assert(std::atomic<uint64_t>::is_always_lock_free && std::atomic<uint32_t>::is_always_lock_free,
+              "the ring is shared between processes, its atomics must not use a lock");
+static_assert(sizeof(ShmRingHeader) == 256, "ShmRingHeader layout is part of the protocol");
+
+class ShmRing {
+    ShmRingHeader* m_header  = nullptr;
+    EventRecord*   m_records = nullptr;
+    uint64_t       m_mask    = 0;
+
+    ShmRing(void* region)
+        : m_header(static_cast<ShmRingHeader*>(region))
+        , m_records(reinterpret_cast<EventRecord*>(static_cast<unsigned char*>(region) + sizeof(ShmRingHeader)))
+        , m_mask(m_header->capacity - 1)
+    {}
+
+public:
+    ShmRing() {}
+
+    static size_t region_size(uint32_t capacity)
+    {
+        return sizeof(ShmRingHeader) + static_cast<size_t>(capacity) * sizeof(EventRecord);
+    }
+
+    // Consumer: formats a zeroed or reused region. Returns a detached ring if capacity
+    // is not a power of two or the region is too small.
+    static ShmRing create(void* region, size_t size, uint32_t capacity)
+    {
+        if (!region || capacity < 2 || (capacity & (capacity - 1)) || size < region_size(capacity))
+            return ShmRing();
+
+        ShmRingHeader* header = static_cast<ShmRingHeader*>(region);
+        std::memset(static_cast<void*>(header), 0, sizeof(ShmRingHeader));
+        header->record_size = sizeof(EventRecord);
+        header->capacity    = capacity;
+        header->version     = shm_ring_version;
+        std::atomic_thread_fence(std::memory_order_release);
+        header->magic       = shm_ring_magic;
+        return ShmRing(region);
+    }
+
+    // Producer: validates a region formatted by create(). Returns a detached ring if the
+    // layout doesn't match this build.
+    static ShmRing attach(void* region, size_t size)
+    {
+        if (!region || size < sizeof(ShmRingHeader))
+            return ShmRing();
+
+        const ShmRingHeader* header = static_cast<const ShmRingHeader*>(region);
+        if (header->magic != shm_ring_magic || header->version != shm_ring_version
+            || header->record_size != sizeof(EventRecord))
+            return ShmRing();
+
+        const uint32_t capacity = header->capacity;
+        if (capacity < 2 || (capacity & (capacity - 1)) || size < region_size(capacity))
+            return ShmRing();
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return ShmRing(region);
+    }
+
+    bool attached() const { return m_header != nullptr; }
+
+    void announce(const HelloPayload& hello)
+    {
+        m_header->qpc_frequency = hello.qpc_frequency;
+        m_header->pointer_bits  = hello.pointer_bits;
+        m_header->producer_pid.store(hello.process_id, std::memory_order_release);
+    }
+
+    // Producer. Copies as many records as fit, counts the rest (and `dropped` from an
+    // earlier stage) as dropped. Returns true if the consumer is asleep and must be
+    // woken up.
+    bool write(const EventRecord* records, size_t count, uint64_t dropped)
+    {
+        const uint64_t w = m_header->write_index.load(std::memory_order_relaxed);
+        const uint64_t r = m_header->read_index.load(std::memory_order_acquire);
+        const uint64_t capacity = m_mask + 1;
+        const size_t n = static_cast<size_t>(count < capacity - (w - r) ? count : capacity - (w - r));
+
+        const size_t offset = static_cast<size_t>(w & m_mask);
+        const size_t first  = n < capacity - offset ? n : static_cast<size_t>(capacity - offset);
+        std::memcpy(m_records + offset, records, first * sizeof(EventRecord));
+        std::memcpy(m_records, records + first, (n - first) * sizeof(EventRecord));
+
+        if (dropped + (count - n))
+            m_header->dropped.fetch_add(dropped + (count - n), std::memory_order_relaxed);
+        m_header->write_index.store(w + n, std::memory_order_seq_cst);
+
+        return m_header->consumer_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+    // Producer: last call. Returns true if the consumer must be woken up.
+    bool close()
+    {
+        m_header->closed.store(1, std::memory_order_seq_cst);
+        return m_header->consumer_waiting.exchange(0, std::memory_order_seq_cst) != 0;
+    }
+
+    // Consumer: contiguous run of unread records (up to the wrap point), read in place.
+    size_t peek(const EventRecord** first) const
+    {
+        const uint64_t r = m_header->read_index.load(std::memory_order_relaxed);
+        const uint64_t w = m_header->write_index.load(std::memory_order_acquire);
+        const uint64_t offset = r & m_mask;
+        const uint64_t until_wrap = m_mask + 1 - offset;
+        *first = m_records + offset;
+        return static_cast<size_t>(w - r < until_wrap ? w - r : until_wrap);
+    }
+
+    // Consumer: hands back the first n records returned by peek().
+    void release(size_t n)
+    {
+        const uint64_t r = m_header->read_index.load(std::memory_order_relaxed);
+        m_header->read_index.store(r + n, std::memory_order_release);
+    }
+
+    // Consumer: call before sleeping on the wakeup object; sleep only if it returns true
+    // (the ring is still empty and the producer hasn't closed it).
+    bool prepare_wait()
+    {
+        m_header->consumer_waiting.store(1, std::memory_order_seq_cst);
+        const uint64_t r = m_header->read_index.load(std::memory_order_relaxed);
+        if (m_header->write_index.load(std::memory_order_seq_cst) != r || closed())
+        {
+            m_header->consumer_waiting.store(0, std::memory_order_relaxed);
+            return false;
+        }
+        return true;
+    }
+
+    bool closed() const { return m_header->closed.load(std::memory_order_acquire) != 0; }
+
+    // Records lost so far (ShmRingHeader::dropped). Any process mapping the region can read
+    // it; take_dropped() is the consumer's way to read and reset it.
+    uint64_t dropped() const { return m_header->dropped.load(std::memory_order_relaxed); }
+
+    uint64_t take_dropped() { return m_header->dropped.exchange(0, std::memory_order_relaxed); }
+};
@@ -0,0 +1,93 @@
+#include "event_record.h"
+#include "event_ring.h"
+#include "test_common.h"
+
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Producer throughput of the hook's event path: MpscRing + batched drain against the
+// mutex-guarded queue a per-message lock amounts to. Usage: bench_event_ring [records]
+
+namespace {
+
+const size_t batch_size = 256;
+
+template <typename Push, typename Drain>
+double run(unsigned producers, uint64_t records, Push push, Drain drain)
+{
+    std::atomic<unsigned> running{ producers };
+    const auto start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> threads;
+    for (unsigned p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&, p] {
+            EventRecord record = {};
+            record.thread_id = p;
+            for (uint64_t i = 0; i < records / producers; ++i)
+            {
+                record.sequence = i;
+                push(record);
+            }
+            running.fetch_sub(1, std::memory_order_release);
+        });
+    }
+
+    std::vector<EventRecord> batch(batch_size);
+    for (;;)
+    {
+        const bool done = running.load(std::memory_order_acquire) == 0;
+        if (!drain(batch.data()) && done)
+            break;
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+    return records / seconds_since(start) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint64_t records = count_arg(argc, argv, 20000000);
+
+    for (unsigned producers : { 1u, 2u, 4u })
+    {
+        MpscRing<EventRecord, 4096> ring;
+        std::atomic<uint64_t> drained{ 0 };
+        const double ring_rate = run(producers, records,
+            [&](const EventRecord& r) { ring.push(r); },
+            [&](EventRecord* out) {
+                const size_t n = ring.pop_bulk(out, batch_size);
+                drained += n;
+                return n;
+            });
+        const uint64_t ring_dropped = ring.take_dropped();
+        HOOK_CHECK(drained + ring_dropped == records / producers * producers);
+
+        std::mutex mutex;
+        std::deque<EventRecord> queue;
+        const double mutex_rate = run(producers, records,
+            [&](const EventRecord& r) {
+                std::lock_guard<std::mutex> lg(mutex);
+                queue.push_back(r);
+            },
+            [&](EventRecord* out) {
+                std::lock_guard<std::mutex> lg(mutex);
+                size_t n = 0;
+                for (; n < batch_size && !queue.empty(); ++n)
+                {
+                    out[n] = queue.front();
+                    queue.pop_front();
+                }
+                return n;
+            });
+
+        std::printf("%u producer(s): ring %.1f M rec/s (%llu dropped), mutex+deque %.1f M rec/s\n", producers,
+                    ring_rate, static_cast<unsigned long long>(ring_dropped), mutex_rate);
+    }
+    return 0;
+}
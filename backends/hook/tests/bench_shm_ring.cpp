@@ -0,0 +1,168 @@
+#include "shm_test_util.h"
+
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <thread>
+#include <vector>
+
+// Cross-process throughput of the shared-memory channel against the framed stream the pipe
+// transport sends, over a pipe and a socketpair. Usage: bench_shm_ring [records]
+
+namespace {
+
+const size_t batch_size = 256;  // InjectorManager::m_max_batch
+
+void wait_child(pid_t pid)
+{
+    int status = 0;
+    HOOK_CHECK(waitpid(pid, &status, 0) == pid);
+    HOOK_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+// The producer waits for room instead of dropping, so both sides measure the same work.
+double bench_shm(uint64_t records)
+{
+    const uint32_t capacity = 1 << 14;
+    ShmRegion shm(capacity);
+    ShmRing consumer = ShmRing::create(shm.region, shm.size, capacity);
+    const auto start = std::chrono::steady_clock::now();
+
+    const pid_t pid = fork();
+    HOOK_CHECK(pid >= 0);
+    if (pid == 0)
+    {
+        ShmRing producer = ShmRing::attach(shm.region, shm.size);
+        const ShmRingHeader* header = static_cast<const ShmRingHeader*>(shm.region);
+        std::vector<EventRecord> batch(batch_size);
+        for (uint64_t next = 0; next < records;)
+        {
+            const uint64_t room = capacity - (header->write_index.load() - header->read_index.load());
+            size_t n = static_cast<size_t>(room < batch_size ? room : batch_size);
+            n = static_cast<size_t>(records - next < n ? records - next : n);
+            for (size_t i = 0; i < n; ++i)
+                batch[i].sequence = next + i;
+            if (n && producer.write(batch.data(), n, 0))
+                shm.signal();
+            if (!n)
+                std::this_thread::yield();
+            next += n;
+        }
+        if (producer.close())
+            shm.signal();
+        _exit(0);
+    }
+
+    uint64_t received = 0;
+    for (;;)
+    {
+        const EventRecord* first = nullptr;
+        const size_t n = consumer.peek(&first);
+        if (n)
+        {
+            HOOK_CHECK(first[n - 1].sequence == received + n - 1);
+            received += n;
+            consumer.release(n);
+        }
+        else if (consumer.closed())
+        {
+            if (!consumer.peek(&first))
+                break;
+        }
+        else if (consumer.prepare_wait())
+        {
+            shm.wait(1000);
+        }
+    }
+    wait_child(pid);
+    HOOK_CHECK(received == records);
+    return records / seconds_since(start) / 1e6;
+}
+
+// One encoded frame per batch, written to fds[1] by a child and decoded here from fds[0].
+// With a stream (pipe) the reader reassembles frames from the byte stream.
+double bench_stream(int fds[2], uint64_t records)
+{
+    const auto start = std::chrono::steady_clock::now();
+    const pid_t pid = fork();
+    HOOK_CHECK(pid >= 0);
+    if (pid == 0)
+    {
+        close(fds[0]);
+        std::vector<unsigned char> frame;
+        std::vector<EventRecord> batch(batch_size);
+        for (uint64_t next = 0; next < records; next += batch_size)
+        {
+            const uint32_t n = static_cast<uint32_t>(records - next < batch_size ? records - next : batch_size);
+            for (uint32_t i = 0; i < n; ++i)
+                batch[i].sequence = next + i;
+            encode_events(frame, batch.data(), n, 0);
+            for (size_t off = 0; off < frame.size();)
+            {
+                const ssize_t w = write(fds[1], frame.data() + off, frame.size() - off);
+                if (w <= 0)
+                    _exit(2);
+                off += static_cast<size_t>(w);
+            }
+        }
+        close(fds[1]);
+        _exit(0);
+    }
+    close(fds[1]);
+
+    std::vector<unsigned char> buffer;
+    std::vector<unsigned char> chunk(1 << 16);
+    DecodedFrame decoded;
+    uint64_t received = 0;
+    size_t used = 0;
+    for (;;)
+    {
+        const ssize_t r = read(fds[0], chunk.data(), chunk.size());
+        if (r <= 0)
+            break;
+        buffer.insert(buffer.end(), chunk.begin(), chunk.begin() + r);
+
+        // Split complete frames off the front.
+        for (;;)
+        {
+            if (buffer.size() - used < sizeof(FrameHeader))
+                break;
+            FrameHeader header;
+            std::memcpy(&header, buffer.data() + used, sizeof(header));
+            const size_t frame_size = sizeof(FrameHeader) + header.count * sizeof(EventRecord);
+            if (buffer.size() - used < frame_size)
+                break;
+            HOOK_CHECK(decode_frame(buffer.data() + used, frame_size, decoded) == decode_ok);
+            HOOK_CHECK(decoded.events.front().sequence == received);
+            received += decoded.events.size();
+            used += frame_size;
+        }
+        buffer.erase(buffer.begin(), buffer.begin() + used);
+        used = 0;
+    }
+    close(fds[0]);
+    wait_child(pid);
+    HOOK_CHECK(received == records);
+    return records / seconds_since(start) / 1e6;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    const uint64_t records = count_arg(argc, argv, 20000000);
+
+    const double shm = bench_shm(records);
+
+    int pipe_fds[2];
+    HOOK_CHECK(pipe(pipe_fds) == 0);
+    const double piped = bench_stream(pipe_fds, records);
+
+    int socket_fds[2];
+    HOOK_CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, socket_fds) == 0);
+    const double socket = bench_stream(socket_fds, records);
+
+    std::printf("%llu records: shm %.1f M rec/s, pipe %.1f M rec/s, socketpair %.1f M rec/s\n",
+                static_cast<unsigned long long>(records), shm, piped, socket);
+    return 0;
+}
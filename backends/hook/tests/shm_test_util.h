@@ -0,0 +1,71 @@
+#pragma once
+#include <fcntl.h>
+#include <semaphore.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <ctime>
+
+#include "shm_ring.h"
+#include "test_common.h"
+
+// POSIX stand-ins for what the hook uses on Windows: shm_open for the file mapping and a
+// process-shared semaphore for the wakeup event.
+struct ShmRegion {
+    void*  region = nullptr;
+    size_t size = 0;
+    sem_t* wake = nullptr;
+
+    explicit ShmRegion(uint32_t capacity)
+        : size(ShmRing::region_size(capacity))
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "/injectlib_hook_ring_%d", static_cast<int>(getpid()));
+        const int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0600);
+        HOOK_CHECK(fd >= 0);
+        shm_unlink(name);  // the mapping keeps it alive, children inherit it
+        HOOK_CHECK(ftruncate(fd, static_cast<off_t>(size)) == 0);
+        region = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        HOOK_CHECK(region != MAP_FAILED);
+        close(fd);
+
+        void* event = mmap(nullptr, sizeof(sem_t), PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+        HOOK_CHECK(event != MAP_FAILED);
+        wake = static_cast<sem_t*>(event);
+        HOOK_CHECK(sem_init(wake, 1, 0) == 0);
+    }
+
+    ~ShmRegion()
+    {
+        sem_destroy(wake);
+        munmap(wake, sizeof(sem_t));
+        munmap(region, size);
+    }
+
+    ShmRegion(const ShmRegion&) = delete;
+    ShmRegion& operator=(const ShmRegion&) = delete;
+
+    // Consumer side of the wakeup; false on timeout.
+    bool wait(int timeout_ms) const
+    {
+        timespec deadline;
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000L;
+        if (deadline.tv_nsec >= 1000000000L)
+        {
+            deadline.tv_sec += 1;
+            deadline.tv_nsec -= 1000000000L;
+        }
+        while (sem_timedwait(wake, &deadline) != 0)
+        {
+            if (errno != EINTR)
+                return false;
+        }
+        return true;
+    }
+
+    void signal() const { sem_post(wake); }
+};
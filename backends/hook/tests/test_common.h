@@ -0,0 +1,25 @@
+#pragma once
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+
+// No test framework here: a failed check prints where it failed and exits non-zero, which
+// is all ctest needs.
+#define HOOK_CHECK(cond)                                                                  \
+    do {                                                                                  \
+        if (!(cond)) {                                                                    \
+            std::fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+            std::exit(1);                                                                 \
+        }                                                                                 \
+    } while (0)
+
+inline double seconds_since(std::chrono::steady_clock::time_point start)
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// First command line argument as a count, def_val if there is none.
+inline unsigned long long count_arg(int argc, char** argv, unsigned long long def_val)
+{
+    return argc > 1 ? std::strtoull(argv[1], nullptr, 10) : def_val;
+}
@@ -0,0 +1,135 @@
+#include "event_record.h"
+#include "test_common.h"
+
+#include <climits>
+
+namespace {
+
+EventRecord make_record(uint64_t sequence)
+{
+    EventRecord r;
+    r.timestamp   = 1234567890123ull + sequence;
+    r.sequence    = sequence;
+    r.hwnd        = 0xFFFFFFFF00001234ull;  // 64-bit handle values survive unchanged
+    r.wparam      = 0x8000000000000001ull;
+    r.lparam      = -1;                     // sign-extended lParam from a 32-bit hook
+    r.message     = 0x004E;
+    r.thread_id   = 4242;
+    r.notify_code = static_cast<uint32_t>(-12);
+    r.flags       = event_has_notify_code;
+    return r;
+}
+
+bool same(const EventRecord& a, const EventRecord& b)
+{
+    return std::memcmp(&a, &b, sizeof(EventRecord)) == 0;
+}
+
+void test_round_trip()
+{
+    std::vector<unsigned char> frame;
+    DecodedFrame decoded;
+
+    const HelloPayload hello = { 10000000, 777, 32, sizeof(EventRecord), 0 };
+    HOOK_CHECK(encode_hello(frame, hello) == sizeof(FrameHeader) + sizeof(HelloPayload));
+    HOOK_CHECK(decode_frame(frame.data(), frame.size(), decoded) == decode_ok);
+    HOOK_CHECK(decoded.header.kind == frame_hello && decoded.header.version == event_frame_version);
+    HOOK_CHECK(decoded.hello.qpc_frequency == 10000000 && decoded.hello.process_id == 777);
+    HOOK_CHECK(decoded.hello.pointer_bits == 32 && decoded.hello.record_size == sizeof(EventRecord));
+
+    std::vector<EventRecord> records;
+    for (uint64_t i = 0; i < 300; ++i)
+        records.push_back(make_record(i));
+    encode_events(frame, records.data(), static_cast<uint32_t>(records.size()), 5);
+    HOOK_CHECK(frame.size() == sizeof(FrameHeader) + records.size() * sizeof(EventRecord));
+    HOOK_CHECK(decode_frame(frame.data(), frame.size(), decoded) == decode_ok);
+    HOOK_CHECK(decoded.header.kind == frame_events && decoded.header.count == records.size());
+    HOOK_CHECK(decoded.header.dropped == 5);
+    HOOK_CHECK(decoded.events.size() == records.size());
+    for (size_t i = 0; i < records.size(); ++i)
+        HOOK_CHECK(same(decoded.events[i], records[i]));
+
+    // A drop report without records, and a drop count too large for the header.
+    encode_events(frame, nullptr, 0, uint64_t(UINT32_MAX) + 10);
+    HOOK_CHECK(decode_frame(frame.data(), frame.size(), decoded) == decode_ok);
+    HOOK_CHECK(decoded.header.count == 0 && decoded.events.empty());
+    HOOK_CHECK(decoded.header.dropped == UINT32_MAX);
+
+    HOOK_CHECK(encode_end(frame) == sizeof(FrameHeader));
+    HOOK_CHECK(decode_frame(frame.data(), frame.size(), decoded) == decode_ok);
+    HOOK_CHECK(decoded.header.kind == frame_end && decoded.events.empty());
+}
+
+void test_rejects()
+{
+    std::vector<unsigned char> frame;
+    DecodedFrame decoded;
+    const EventRecord records[2] = { make_record(0), make_record(1) };
+    encode_events(frame, records, 2, 0);
+
+    // Truncated: within the header and within the payload.
+    HOOK_CHECK(decode_frame(frame.data(), 0, decoded) == decode_truncated);
+    HOOK_CHECK(decode_frame(frame.data(), sizeof(FrameHeader) - 1, decoded) == decode_truncated);
+    HOOK_CHECK(decode_frame(frame.data(), frame.size() - 1, decoded) == decode_truncated);
+    HOOK_CHECK(decode_frame(frame.data(), sizeof(FrameHeader), decoded) == decode_truncated);
+
+    // Trailing bytes, also after a frame kind without payload.
+    std::vector<unsigned char> longer = frame;
+    longer.push_back(0);
+    HOOK_CHECK(decode_frame(longer.data(), longer.size(), decoded) == decode_bad_size);
+    encode_end(longer);
+    longer.resize(longer.size() + sizeof(EventRecord));
+    HOOK_CHECK(decode_frame(longer.data(), longer.size(), decoded) == decode_bad_size);
+
+    FrameHeader header;
+    std::memcpy(&header, frame.data(), sizeof(header));
+
+    auto decode_with = [&](const FrameHeader& h) {
+        std::vector<unsigned char> bad = frame;
+        std::memcpy(bad.data(), &h, sizeof(h));
+        return decode_frame(bad.data(), bad.size(), decoded);
+    };
+
+    FrameHeader bad = header;
+    bad.magic = 0x504F4F48;  // "HOOP"
+    HOOK_CHECK(decode_with(bad) == decode_bad_magic);
+    bad.magic = 0;
+    HOOK_CHECK(decode_with(bad) == decode_bad_magic);
+
+    bad = header;
+    bad.version = event_frame_version + 1;
+    HOOK_CHECK(decode_with(bad) == decode_bad_version);
+    bad.version = 0xFFFF;
+    HOOK_CHECK(decode_with(bad) == decode_bad_version);
+
+    for (uint16_t kind : { uint16_t(0), uint16_t(frame_end + 1), uint16_t(0xFFFF) })
+    {
+        bad = header;
+        bad.kind = kind;
+        HOOK_CHECK(decode_with(bad) == decode_bad_kind);
+    }
+
+    // A count that doesn't match the payload, in both directions.
+    bad = header;
+    bad.count = 3;
+    HOOK_CHECK(decode_with(bad) == decode_truncated);
+    bad.count = 1;
+    HOOK_CHECK(decode_with(bad) == decode_bad_size);
+    bad.count = UINT32_MAX;
+    HOOK_CHECK(decode_with(bad) == decode_truncated);
+
+    // A hello frame of the wrong size.
+    bad = header;
+    bad.kind = frame_hello;
+    HOOK_CHECK(decode_with(bad) == decode_bad_size);
+}
+
+} // namespace
+
+int main()
+{
+    test_round_trip();
+    test_rejects();
+    std::puts("event_record: ok");
+    return 0;
+}
@@ -0,0 +1,153 @@
+#include "event_record.h"
+#include "event_ring.h"
+#include "test_common.h"
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+void test_single_thread()
+{
+    MpscRing<EventRecord, 8> ring;
+    EventRecord record = {};
+    HOOK_CHECK(ring.empty());
+
+    // Fill, overflow, then drain across the wrap point twice.
+    for (int round = 0; round < 3; ++round)
+    {
+        for (uint32_t i = 0; i < 8; ++i)
+        {
+            record.message = i;
+            HOOK_CHECK(ring.push(record));
+        }
+        HOOK_CHECK(!ring.push(record));
+        HOOK_CHECK(!ring.push(record));
+        HOOK_CHECK(ring.take_dropped() == 2);
+        HOOK_CHECK(ring.take_dropped() == 0);
+
+        EventRecord out[8];
+        HOOK_CHECK(ring.pop_bulk(out, 5) == 5);
+        HOOK_CHECK(ring.pop_bulk(out + 5, 8) == 3);
+        for (uint32_t i = 0; i < 8; ++i)
+            HOOK_CHECK(out[i].message == i);
+        HOOK_CHECK(ring.empty());
+        HOOK_CHECK(!ring.pop(record));
+    }
+}
+
+// Several producers against one consumer on a small ring, so it keeps wrapping and
+// overflowing. Producers retry on a full ring (the hook drops instead) so that every record
+// can be accounted for: each must arrive exactly once and in its producer's order, and
+// every failed push must show up in the drop count.
+void test_multi_producer_stress()
+{
+    const uint32_t producers = 4;
+    const uint32_t per_producer = 200000;
+
+    MpscRing<EventRecord, 256> ring;
+    std::vector<uint64_t> failed(producers, 0);
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&ring, &failed, p] {
+            EventRecord record = {};
+            record.thread_id = p;
+            for (uint32_t i = 0; i < per_producer; ++i)
+            {
+                record.message = i;
+                while (!ring.push(record))
+                {
+                    ++failed[p];
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    std::vector<uint32_t> next(producers, 0);
+    uint64_t received = 0;
+    uint64_t dropped = 0;
+    std::vector<EventRecord> batch(64);
+    while (received < uint64_t(producers) * per_producer)
+    {
+        const size_t n = ring.pop_bulk(batch.data(), batch.size());
+        for (size_t i = 0; i < n; ++i)
+        {
+            const EventRecord& r = batch[i];
+            HOOK_CHECK(r.thread_id < producers);
+            HOOK_CHECK(r.message == next[r.thread_id]);
+            ++next[r.thread_id];
+        }
+        received += n;
+        dropped += ring.take_dropped();
+        if (!n)
+            std::this_thread::yield();
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+    dropped += ring.take_dropped();
+
+    uint64_t total_failed = 0;
+    for (uint32_t p = 0; p < producers; ++p)
+    {
+        HOOK_CHECK(next[p] == per_producer);
+        total_failed += failed[p];
+    }
+    HOOK_CHECK(dropped == total_failed);
+    HOOK_CHECK(ring.empty());
+}
+
+// Sequence numbers stamped from the slot ticket come out of the ring as 0, 1, 2, ...
+// whatever the interleaving of the producers; drops don't use up numbers.
+void test_ticket_sequence()
+{
+    const uint32_t producers = 4;
+    const uint32_t per_producer = 100000;
+
+    MpscRing<EventRecord, 64> ring;
+    std::atomic<uint64_t> pushed{ 0 };
+    std::atomic<uint32_t> running{ producers };
+    std::vector<std::thread> threads;
+    for (uint32_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&] {
+            EventRecord record = {};
+            for (uint32_t i = 0; i < per_producer; ++i)
+            {
+                if (ring.push(record, [](EventRecord& r, uint64_t ticket) { r.sequence = ticket; }))
+                    ++pushed;
+            }
+            --running;
+        });
+    }
+
+    uint64_t expected = 0;
+    std::vector<EventRecord> batch(32);
+    for (;;)
+    {
+        const bool finished = running == 0;
+        const size_t n = ring.pop_bulk(batch.data(), batch.size());
+        for (size_t i = 0; i < n; ++i)
+            HOOK_CHECK(batch[i].sequence == expected++);
+        if (!n && finished)
+            break;
+    }
+
+    for (std::thread& t : threads)
+        t.join();
+    HOOK_CHECK(expected == pushed);
+    HOOK_CHECK(expected + ring.take_dropped() == uint64_t(producers) * per_producer);
+}
+
+} // namespace
+
+int main()
+{
+    test_single_thread();
+    test_multi_producer_stress();
+    test_ticket_sequence();
+    std::puts("event_ring: ok");
+    return 0;
+}
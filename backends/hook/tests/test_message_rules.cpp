@@ -0,0 +1,236 @@
+#include "message_filter.h"
+#include "message_rules.h"
+#include "test_common.h"
+
+#include <cwctype>
+#include <map>
+#include <thread>
+#include <vector>
+
+namespace {
+
+// Stand-in for HookWindows: a fixed window tree instead of user32.
+class FakeWindows {
+    struct Window {
+        uintptr_t    parent;
+        std::wstring class_name;
+        std::wstring title;
+    };
+    std::map<uintptr_t, Window> m_windows;
+
+public:
+    mutable int queries = 0;
+
+    void add(uintptr_t hwnd, uintptr_t parent, const std::wstring& class_name, const std::wstring& title)
+    {
+        m_windows[hwnd] = Window{ parent, class_name, title };
+    }
+
+    bool class_is(uintptr_t hwnd, const std::wstring& name) const
+    {
+        ++queries;
+        auto it = m_windows.find(hwnd);
+        if (it == m_windows.end() || it->second.class_name.size() != name.size())
+            return false;
+        for (size_t i = 0; i < name.size(); ++i)
+        {
+            if (std::towlower(it->second.class_name[i]) != std::towlower(name[i]))
+                return false;
+        }
+        return true;
+    }
+
+    bool title_is(uintptr_t hwnd, const std::wstring& title) const
+    {
+        ++queries;
+        auto it = m_windows.find(hwnd);
+        return it != m_windows.end() && it->second.title == title;
+    }
+
+    bool is_within(uintptr_t hwnd, uintptr_t root) const
+    {
+        ++queries;
+        for (auto it = m_windows.find(hwnd); it != m_windows.end(); it = m_windows.find(it->second.parent))
+        {
+            if (it->first == root)
+                return true;
+        }
+        return false;
+    }
+};
+
+FakeWindows make_windows()
+{
+    FakeWindows windows;
+    windows.add(1, 0, L"#32770", L"Open");
+    windows.add(2, 1, L"Button", L"OK");
+    windows.add(3, 1, L"SysListView32", L"");
+    windows.add(4, 3, L"Edit", L"name");
+    windows.add(5, 0, L"Button", L"OK");
+    return windows;
+}
+
+void test_filter()
+{
+    // WM_PAINT, WM_MOUSEMOVE, WM_USER, WM_APP + 1, a registered message, and -1 the way
+    // SetApprovedList passes it.
+    const std::vector<int> ids = { 0x000F, 0x0200, 0x0400, 0x8001, 0xC123, -1 };
+    const MessageFilter filter(ids.begin(), ids.end());
+    for (int id : ids)
+        HOOK_CHECK(filter.approved(static_cast<uint32_t>(id)));
+    for (uint32_t id : { 0x0000u, 0x000Eu, 0x0010u, 0x0201u, 0x8000u, 0xBFFFu, 0xC000u, 0xC122u, 0xFFFFu })
+        HOOK_CHECK(!filter.approved(id));
+    HOOK_CHECK(!filter.rule(0x000F));
+
+    FilterSlot slot;
+    HOOK_CHECK(!slot.current());
+    slot.publish(std::make_unique<MessageFilter>(ids.begin(), ids.begin() + 2));
+    const MessageFilter* first = slot.current();
+    HOOK_CHECK(first->approved(0x0200) && !first->approved(0x0400));
+    slot.publish(std::make_unique<MessageFilter>(ids.begin(), ids.end()));
+    HOOK_CHECK(slot.current() != first && slot.current()->approved(0x0400));
+    HOOK_CHECK(first->approved(0x0200));  // still valid for a reader that loaded it earlier
+}
+
+void test_rule_lookup_and_notify_codes()
+{
+    const std::vector<int> ids = { 0x004E, 0x0200, 0x000F };
+    std::vector<MessageRule> rules(2);
+    rules[0].message = 0x004E;             // WM_NOTIFY
+    rules[0].notify_codes = { 7, 3, 5 };   // unsorted on purpose, the filter sorts them
+    rules[1].message = 0x000F;
+    const MessageFilter filter(ids.begin(), ids.end(), rules);
+
+    HOOK_CHECK(filter.rule(0x004E) && filter.rule(0x004E)->message == 0x004E);
+    HOOK_CHECK(filter.rule(0x000F) && filter.rule(0x000F)->message == 0x000F);
+    HOOK_CHECK(!filter.rule(0x0200));
+    HOOK_CHECK(!filter.rule(0x0201));
+
+    const FakeWindows windows = make_windows();
+    const MessageRule& notify = *filter.rule(0x004E);
+    for (uint32_t code : { 3u, 5u, 7u })
+        HOOK_CHECK(notify.accepts(2, code, 0, windows));
+    for (uint32_t code : { 0u, 4u, 8u })
+        HOOK_CHECK(!notify.accepts(2, code, 0, windows));
+    HOOK_CHECK(windows.queries == 0);  // no window queries without window conditions
+}
+
+void test_window_rules()
+{
+    const FakeWindows windows = make_windows();
+
+    MessageRule subtree;
+    subtree.root = 1;
+    HOOK_CHECK(subtree.accepts(1, 0, 0, windows));
+    HOOK_CHECK(subtree.accepts(2, 0, 0, windows));
+    HOOK_CHECK(subtree.accepts(4, 0, 0, windows));   // grandchild
+    HOOK_CHECK(!subtree.accepts(5, 0, 0, windows));  // another top-level window
+    HOOK_CHECK(!subtree.accepts(42, 0, 0, windows)); // unknown window
+
+    MessageRule by_class;
+    by_class.window_class = L"button";
+    HOOK_CHECK(by_class.accepts(2, 0, 0, windows));
+    HOOK_CHECK(by_class.accepts(5, 0, 0, windows));
+    HOOK_CHECK(!by_class.accepts(3, 0, 0, windows));
+    by_class.window_class = L"Butto";
+    HOOK_CHECK(!by_class.accepts(2, 0, 0, windows));
+
+    MessageRule by_title;
+    by_title.window_title = L"OK";
+    HOOK_CHECK(by_title.accepts(2, 0, 0, windows));
+    HOOK_CHECK(by_title.accepts(5, 0, 0, windows));
+    HOOK_CHECK(!by_title.accepts(1, 0, 0, windows));
+    by_title.window_title = L"ok";  // titles are compared exactly
+    HOOK_CHECK(!by_title.accepts(2, 0, 0, windows));
+
+    // All conditions must hold: the OK button of the dialog, not the top-level one.
+    MessageRule combined;
+    combined.root = 1;
+    combined.window_class = L"Button";
+    combined.window_title = L"OK";
+    HOOK_CHECK(combined.accepts(2, 0, 0, windows));
+    HOOK_CHECK(!combined.accepts(5, 0, 0, windows));
+    HOOK_CHECK(!combined.accepts(4, 0, 0, windows));
+
+    // A failed cheap check skips the window queries.
+    MessageRule notify_first = combined;
+    notify_first.notify_codes = { 1 };
+    windows.queries = 0;
+    HOOK_CHECK(!notify_first.accepts(2, 2, 0, windows));
+    HOOK_CHECK(windows.queries == 0);
+}
+
+void test_rate_limiter()
+{
+    const RateLimiter unlimited;
+    for (int i = 0; i < 1000; ++i)
+        HOOK_CHECK(unlimited.allow(0));
+
+    const RateLimiter limiter(3);
+    HOOK_CHECK(limiter.allow(0));
+    HOOK_CHECK(limiter.allow(400));
+    HOOK_CHECK(limiter.allow(999));
+    HOOK_CHECK(!limiter.allow(999));
+    // A new wall-clock second starts a new window...
+    HOOK_CHECK(limiter.allow(1000));
+    HOOK_CHECK(limiter.allow(1001));
+    HOOK_CHECK(limiter.allow(1999));
+    HOOK_CHECK(!limiter.allow(1999));
+    // ...also after a gap of several seconds, and the very first window is not special.
+    HOOK_CHECK(limiter.allow(7500));
+    HOOK_CHECK(limiter.allow(7500));
+    HOOK_CHECK(limiter.allow(7500));
+    HOOK_CHECK(!limiter.allow(7999));
+
+    // Copies take the limit, not the counters.
+    RateLimiter copy(limiter);
+    HOOK_CHECK(copy.per_second() == 3);
+    HOOK_CHECK(copy.allow(7999));
+    copy = limiter;
+    HOOK_CHECK(copy.allow(7999));
+
+    // Concurrent callers within one window: exactly per_second get through. The window is
+    // opened first; callers racing on a window change may get a few extra through.
+    const RateLimiter shared(100);
+    HOOK_CHECK(shared.allow(5000));
+    std::atomic<int> allowed{ 1 };
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t)
+    {
+        threads.emplace_back([&] {
+            for (int i = 0; i < 1000; ++i)
+                allowed += shared.allow(5000 + i % 1000) ? 1 : 0;
+        });
+    }
+    for (std::thread& t : threads)
+        t.join();
+    HOOK_CHECK(allowed == 100);
+}
+
+void test_rate_consumed_last()
+{
+    const FakeWindows windows = make_windows();
+    MessageRule rule;
+    rule.window_class = L"Button";
+    rule.rate = RateLimiter(2);
+
+    // Rejected events don't use up the budget.
+    for (int i = 0; i < 10; ++i)
+        HOOK_CHECK(!rule.accepts(3, 0, 0, windows));
+    HOOK_CHECK(rule.accepts(2, 0, 0, windows));
+    HOOK_CHECK(rule.accepts(2, 0, 0, windows));
+    HOOK_CHECK(!rule.accepts(2, 0, 0, windows));
+}
+
+} // namespace
+
+int main()
+{
+    test_filter();
+    test_rule_lookup_and_notify_codes();
+    test_window_rules();
+    test_rate_limiter();
+    test_rate_consumed_last();
+    std::puts("message_rules: ok");
+    return 0;
+}
@@ -0,0 +1,206 @@
+#include "shm_test_util.h"
+
+#include <sys/wait.h>
+
+#include <thread>
+#include <vector>
+
+namespace {
+
+const size_t batch_size = 256;
+
+void test_create_and_attach()
+{
+    std::vector<unsigned char> memory(ShmRing::region_size(64));
+    void* region = memory.data();
+
+    HOOK_CHECK(!ShmRing::create(region, memory.size(), 48).attached());   // not a power of two
+    HOOK_CHECK(!ShmRing::create(region, memory.size(), 128).attached());  // doesn't fit
+    HOOK_CHECK(!ShmRing::create(nullptr, memory.size(), 64).attached());
+    HOOK_CHECK(!ShmRing::attach(region, memory.size()).attached());       // not formatted yet
+
+    ShmRing consumer = ShmRing::create(region, memory.size(), 64);
+    HOOK_CHECK(consumer.attached());
+    HOOK_CHECK(!ShmRing::attach(region, memory.size() - 1).attached());
+
+    ShmRingHeader* header = static_cast<ShmRingHeader*>(region);
+    header->record_size = sizeof(EventRecord) + 8;  // a producer built with another layout
+    HOOK_CHECK(!ShmRing::attach(region, memory.size()).attached());
+    header->record_size = sizeof(EventRecord);
+    header->version = shm_ring_version + 1;
+    HOOK_CHECK(!ShmRing::attach(region, memory.size()).attached());
+    header->version = shm_ring_version;
+
+    ShmRing producer = ShmRing::attach(region, memory.size());
+    HOOK_CHECK(producer.attached());
+    const HelloPayload hello = { 10000000, 4321, 32, sizeof(EventRecord), 0 };
+    producer.announce(hello);
+    HOOK_CHECK(header->producer_pid.load() == 4321);
+    HOOK_CHECK(header->qpc_frequency == 10000000 && header->pointer_bits == 32);
+}
+
+void test_wrap_and_drops()
+{
+    std::vector<unsigned char> memory(ShmRing::region_size(256));
+    ShmRing consumer = ShmRing::create(memory.data(), memory.size(), 256);
+    ShmRing producer = ShmRing::attach(memory.data(), memory.size());
+
+    std::vector<EventRecord> records(300);
+    for (size_t i = 0; i < records.size(); ++i)
+        records[i].sequence = i;
+
+    // 200 in, 200 out, then 200 more wrap around the end of the ring.
+    producer.write(records.data(), 200, 0);
+    const EventRecord* first = nullptr;
+    HOOK_CHECK(consumer.peek(&first) == 200 && first[199].sequence == 199);
+    consumer.release(200);
+    producer.write(records.data() + 100, 200, 0);
+    HOOK_CHECK(consumer.peek(&first) == 56 && first[0].sequence == 100);
+    consumer.release(56);
+    HOOK_CHECK(consumer.peek(&first) == 144 && first[0].sequence == 156 && first[143].sequence == 299);
+    consumer.release(144);
+    HOOK_CHECK(consumer.peek(&first) == 0);
+    HOOK_CHECK(consumer.dropped() == 0);
+
+    // Overflow: 256 fit, 44 are dropped, plus 3 the producer's own queue dropped.
+    producer.write(records.data(), 300, 3);
+    HOOK_CHECK(consumer.dropped() == 47);
+    HOOK_CHECK(producer.write(records.data(), 1, 0) == false);
+    HOOK_CHECK(consumer.take_dropped() == 48);
+    HOOK_CHECK(consumer.dropped() == 0 && consumer.take_dropped() == 0);
+    HOOK_CHECK(consumer.peek(&first) == 112 && first[0].sequence == 0);  // up to the wrap point
+    consumer.release(112);
+    HOOK_CHECK(consumer.peek(&first) == 144 && first[143].sequence == 255);
+    consumer.release(144);
+
+    // A sleeping consumer is woken exactly once.
+    HOOK_CHECK(consumer.prepare_wait());
+    HOOK_CHECK(producer.write(records.data(), 1, 0));
+    HOOK_CHECK(!producer.write(records.data(), 1, 0));
+    HOOK_CHECK(!consumer.prepare_wait());  // not empty, don't sleep
+    HOOK_CHECK(consumer.peek(&first) == 2);
+    consumer.release(2);
+    HOOK_CHECK(consumer.prepare_wait());
+    HOOK_CHECK(producer.close());
+    HOOK_CHECK(consumer.closed());
+    HOOK_CHECK(!consumer.prepare_wait());
+}
+
+// Producer: a forked process writing `records` numbered records. With `lossless` it waits
+// for room the way a test can (the hook never waits); otherwise a full ring drops records.
+// Every 100th batch also reports one record as dropped by an earlier stage.
+void produce(const ShmRegion& shm, uint64_t records, bool lossless)
+{
+    ShmRing producer = ShmRing::attach(shm.region, shm.size);
+    if (!producer.attached())
+        _exit(2);
+    const HelloPayload hello = { 1000000000, static_cast<uint32_t>(getpid()), 64, sizeof(EventRecord), 0 };
+    producer.announce(hello);
+
+    const ShmRingHeader* header = static_cast<const ShmRingHeader*>(shm.region);
+    const uint64_t capacity = header->capacity;
+    std::vector<EventRecord> batch(batch_size);
+    uint64_t batches = 0;
+    for (uint64_t next = 0; next < records; ++batches)
+    {
+        const size_t count = static_cast<size_t>(records - next < batch_size ? records - next : batch_size);
+        for (size_t i = 0; i < count; ++i)
+            batch[i].sequence = next + i;
+
+        size_t done = 0;
+        uint64_t dropped = batches % 100 == 99 ? 1 : 0;
+        do
+        {
+            size_t n = count - done;
+            if (lossless)
+            {
+                const uint64_t room = capacity - (header->write_index.load() - header->read_index.load());
+                n = static_cast<size_t>(room < n ? room : n);
+            }
+            if (n || dropped)
+            {
+                if (producer.write(batch.data() + done, n, dropped))
+                    shm.signal();
+                dropped = 0;
+            }
+            if (!n)
+                std::this_thread::yield();
+            done += n;
+        } while (lossless && done < count);
+        next += count;
+    }
+
+    if (producer.close())
+        shm.signal();
+    _exit(0);
+}
+
+void test_cross_process(bool lossless)
+{
+    const uint64_t records = 2000000;
+    const uint64_t earlier_drops = (records + batch_size - 1) / batch_size / 100;
+
+    ShmRegion shm(1024);
+    ShmRing consumer = ShmRing::create(shm.region, shm.size, 1024);
+    HOOK_CHECK(consumer.attached());
+
+    const pid_t pid = fork();
+    HOOK_CHECK(pid >= 0);
+    if (pid == 0)
+        produce(shm, records, lossless);
+
+    uint64_t received = 0;
+    uint64_t dropped = 0;
+    uint64_t last = 0;
+    for (;;)
+    {
+        const EventRecord* first = nullptr;
+        const size_t n = consumer.peek(&first);
+        if (n)
+        {
+            for (size_t i = 0; i < n; ++i)
+            {
+                // In order; gaps only where records were dropped.
+                HOOK_CHECK(received + i == 0 || first[i].sequence > last);
+                HOOK_CHECK(!lossless || first[i].sequence == received + i);
+                last = first[i].sequence;
+            }
+            received += n;
+            consumer.release(n);
+            dropped += consumer.take_dropped();
+            continue;
+        }
+        if (consumer.closed())
+        {
+            if (consumer.peek(&first))
+                continue;
+            break;
+        }
+        // The producer never pauses, so a timeout here is a lost wakeup.
+        if (consumer.prepare_wait())
+            HOOK_CHECK(shm.wait(5000));
+    }
+    dropped += consumer.take_dropped();
+
+    int status = 0;
+    HOOK_CHECK(waitpid(pid, &status, 0) == pid);
+    HOOK_CHECK(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    HOOK_CHECK(static_cast<ShmRingHeader*>(shm.region)->producer_pid.load() == static_cast<uint32_t>(pid));
+
+    if (lossless)
+        HOOK_CHECK(received == records && dropped == earlier_drops);
+    else
+        HOOK_CHECK(received + dropped == records + earlier_drops);
+}
+
+} // namespace
+
+int main()
+{
+    test_create_and_attach();
+    test_wrap_and_drops();
+    test_cross_process(true);
+    test_cross_process(false);
+    std::puts("shm_ring: ok");
+    return 0;
+}
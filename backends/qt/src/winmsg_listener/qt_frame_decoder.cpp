@@ -0,0 +1,142 @@
+#include "qt_frame_decoder.h"
+
+#include <QIODevice>
+
+#include <cstring>
+
+namespace {
+
+const int kInitialBuffer = 64 * 1024;
+
+bool is_blank(char ch) {
+    return ch == ' ' || ch == '\t' || ch == '\r';
+}
+
+} // namespace
+
+FrameDecoder::FrameDecoder(int maxFrameSize)
+    : m_maxFrame(maxFrameSize)
+{
+}
+
+qint64 FrameDecoder::readFrom(QIODevice* dev) {
+    const qint64 avail = dev->bytesAvailable();
+    if (avail <= 0)
+        return 0;
+
+    // Never buffer more than one maximal frame plus its header ahead of the parser.
+    const int chunk = static_cast<int>(qMin<qint64>(avail, static_cast<qint64>(m_maxFrame) + kMaxHeader));
+    reserve(chunk);
+    const qint64 n = dev->read(m_buf.data() + m_end, chunk);
+    if (n > 0)
+        m_end += static_cast<int>(n);
+    return n;
+}
+
+void FrameDecoder::append(const char* data, int size) {
+    if (size <= 0) return;
+    reserve(size);
+    std::memcpy(m_buf.data() + m_end, data, static_cast<size_t>(size));
+    m_end += size;
+}
+
+void FrameDecoder::reserve(int extra) {
+    if (m_pos == m_end) {
+        // Everything consumed: rewind, and give back memory a huge frame left behind.
+        m_scan -= m_pos;
+        m_pos = m_end = 0;
+        if (m_buf.size() > 4 * kInitialBuffer && extra <= kInitialBuffer)
+            m_buf = QByteArray();
+    }
+
+    if (m_buf.size() - m_end >= extra)
+        return;
+
+    // Slide the unconsumed tail to the front before growing.
+    if (m_pos > 0) {
+        const int live = m_end - m_pos;
+        std::memmove(m_buf.data(), m_buf.constData() + m_pos, static_cast<size_t>(live));
+        m_scan -= m_pos;
+        m_end = live;
+        m_pos = 0;
+        if (m_buf.size() - m_end >= extra)
+            return;
+    }
+
+    int cap = qMax(m_buf.size(), kInitialBuffer);
+    while (cap - m_end < extra)
+        cap *= 2;
+    m_buf.resize(cap);
+}
+
+FrameDecoder::Result FrameDecoder::fail(const QString& error) {
+    m_error = error;
+    return Result::Error;
+}
+
+FrameDecoder::Result FrameDecoder::next(QByteArray& payload) {
+    if (!m_error.isEmpty())
+        return Result::Error;
+
+    if (m_expected < 0 && m_binary) {
+        if (m_end - m_pos < 4)
+            return Result::NeedMore;
+
+        const uchar* h = reinterpret_cast<const uchar*>(m_buf.constData() + m_pos);
+        const quint32 length = (quint32(h[0]) << 24) | (quint32(h[1]) << 16) | (quint32(h[2]) << 8) | quint32(h[3]);
+        if (length == 0)
+            return fail(QStringLiteral("Invalid frame length: 0"));
+        if (length > static_cast<quint32>(m_maxFrame))
+            return fail(QStringLiteral("Frame exceeds %1 bytes").arg(m_maxFrame));
+
+        m_expected = static_cast<int>(length);
+        m_pos += 4;
+        m_scan = m_pos;
+    }
+
+    if (m_expected < 0) {
+        const char* d = m_buf.constData();
+        int nl = qMax(m_scan, m_pos);
+        while (nl < m_end && d[nl] != '\n')
+            ++nl;
+
+        if (nl == m_end) {
+            m_scan = nl;
+            if (m_end - m_pos > kMaxHeader)
+                return fail(QStringLiteral("Frame header too long"));
+            return Result::NeedMore;
+        }
+
+        // Parse "<digits>[\r]". Blanks around the number are tolerated like the old trimmed()
+        // did, but not inside it: "1 2" is an error, not 12.
+        int i = m_pos;
+        while (i < nl && is_blank(d[i]))
+            ++i;
+        qint64 length = 0;
+        int digits = 0;
+        for (; i < nl && d[i] >= '0' && d[i] <= '9'; ++i, ++digits) {
+            if (length <= m_maxFrame) // stop accumulating once oversized, keep validating
+                length = length * 10 + (d[i] - '0');
+        }
+        while (i < nl && is_blank(d[i]))
+            ++i;
+        if (i != nl || digits == 0 || length <= 0)
+            return fail(QStringLiteral("Invalid frame length: '%1'")
+                            .arg(QString::fromLatin1(d + m_pos, nl - m_pos)));
+        if (length > m_maxFrame)
+            return fail(QStringLiteral("Frame exceeds %1 bytes").arg(m_maxFrame));
+
+        m_expected = static_cast<int>(length);
+        m_pos = nl + 1;
+        m_scan = m_pos;
+    }
+
+    if (m_end - m_pos < m_expected)
+        return Result::NeedMore;
+
+    payload = QByteArray::fromRawData(m_buf.constData() + m_pos, m_expected);
+    m_pos += m_expected;
+    m_scan = m_pos;
+    m_expected = -1;
+    return Result::Frame;
+}
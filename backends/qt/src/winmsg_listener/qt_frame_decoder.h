@@ -0,0 +1,59 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+class QIODevice;
+
+/// Incremental decoder for "<decimal length>\n<payload>" frames, or, once switched to
+/// binary framing, for "<4-byte big-endian length><payload>" frames.
+///
+/// Bytes are appended into one reusable buffer as they arrive; partial headers and
+/// payloads simply wait for more data, and the header is never rescanned. next() hands
+/// out payloads as non-owning views into the buffer (QByteArray::fromRawData), so they
+/// can be parsed without an extra copy but are only valid until the next readFrom()/append().
+class FrameDecoder {
+public:
+    enum class Result {
+        NeedMore, // no complete frame buffered
+        Frame,    // a payload was returned
+        Error     // malformed or oversized frame; the stream cannot be resynchronized
+    };
+
+    /// Longest text header accepted: the decimal length, optional blanks and '\r', some slack.
+    static const int kMaxHeader = 16;
+
+    explicit FrameDecoder(int maxFrameSize = 16 * 1024 * 1024);
+
+    /// Appends everything the device has available. Returns bytes read or -1 on read error.
+    qint64 readFrom(QIODevice* dev);
+
+    /// Appends raw bytes.
+    void append(const char* data, int size);
+
+    /// Extracts the next complete payload, if any.
+    Result next(QByteArray& payload);
+
+    /// Switches between text and binary length prefixes. Takes effect with the next frame.
+    void setBinary(bool binary) noexcept { m_binary = binary; }
+    bool isBinary() const noexcept { return m_binary; }
+
+    /// Bytes buffered but not consumed yet.
+    int buffered() const noexcept { return m_end - m_pos; }
+
+    int maxFrameSize() const noexcept { return m_maxFrame; }
+    QString errorString() const { return m_error; }
+
+private:
+    void reserve(int extra);
+    Result fail(const QString& error);
+
+    QByteArray m_buf;
+    int m_pos = 0;        // first unconsumed byte
+    int m_end = 0;        // one past the last buffered byte
+    int m_scan = 0;       // where the search for the header '\n' resumes
+    int m_expected = -1;  // payload length once the header has been parsed
+    int m_maxFrame;
+    bool m_binary = false;
+    QString m_error;
+};
@@ -0,0 +1,274 @@
+#include "qt_id_table.h"
+
+#include <QGraphicsItem>
+#include <QGraphicsObject>
+#include <QGraphicsScene>
+
+namespace {
+
+// What a plain item lives and dies with: its scene, or outside a scene the nearest
+// QGraphicsObject above it. nullptr if it has neither.
+QObject* plain_item_owner(QGraphicsItem* item) {
+    if (QGraphicsScene* scene = item->scene())
+        return scene;
+    for (QGraphicsItem* p = item->parentItem(); p; p = p->parentItem()) {
+        if (QGraphicsObject* go = p->toGraphicsObject())
+            return go;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+ElementIdTable::Slot* ElementIdTable::slotFor(int id) {
+    if (id <= 0) return nullptr;
+    const int index = (id & kIndexMask) - 1;
+    if (index < 0 || index >= m_slots.size()) return nullptr;
+
+    Slot& s = m_slots[index];
+    if (s.kind == Kind::Free) return nullptr;
+    if ((s.generation & kGenerationMask) != (static_cast<quint32>(id) >> kIndexBits)) return nullptr;
+    return &s;
+}
+
+int ElementIdTable::allocate() {
+    if (m_freeHead >= 0) {
+        const int index = m_freeHead;
+        m_freeHead = m_slots[index].nextFree;
+        m_slots[index].nextFree = -1;
+        return index;
+    }
+    if (m_slots.size() > kIndexMask - 1) {
+        m_overflow = true;
+        return -1;
+    }
+    m_slots.push_back(Slot());
+    return m_slots.size() - 1;
+}
+
+void ElementIdTable::freeSlot(int index) {
+    Slot& s = m_slots[index];
+    if (s.kind == Kind::Free) return;
+
+    if (s.kind == Kind::Accessible) {
+        auto it = m_acc2id.find(s.accessibleId);
+        if (it != m_acc2id.end() && (it.value() & kIndexMask) - 1 == index)
+            m_acc2id.erase(it);
+    } else {
+        auto it = m_ptr2id.find(s.key);
+        if (it != m_ptr2id.end() && (it.value() & kIndexMask) - 1 == index)
+            m_ptr2id.erase(it);
+    }
+    if (s.owner) {
+        auto ow = m_owned.find(s.owner);
+        if (ow != m_owned.end()) {
+            ow->indices.remove(index);
+            if (ow->indices.isEmpty())
+                m_owned.erase(ow);
+        }
+    }
+
+    s.track.clear();
+    s.key = nullptr;
+    s.item = nullptr;
+    s.owner = nullptr;
+    s.accessibleId = 0;
+    s.kind = Kind::Free;
+    --m_live;
+    ++s.generation; // ids handed out for this slot become stale
+    if (s.generation > kGenerationMask + 1) {
+        // Every generation has been handed out: reusing the slot would repeat an old id.
+        ++m_retired;
+        return;
+    }
+    s.nextFree = m_freeHead;
+    m_freeHead = index;
+}
+
+int ElementIdTable::findKey(const void* key, Kind kind) const {
+    const int id = m_ptr2id.value(key, 0);
+    if (!id) return 0;
+    // A dead object at the same address means the entry is stale.
+    const Slot& s = m_slots[(id & kIndexMask) - 1];
+    return (s.kind == kind && !s.track.isNull()) ? id : 0;
+}
+
+int ElementIdTable::find(QObject* obj) const {
+    if (!obj) return 0;
+    if (QGraphicsObject* go = qobject_cast<QGraphicsObject*>(obj))
+        return findKey(static_cast<QGraphicsItem*>(go), Kind::GraphicsItem);
+    return findKey(obj, Kind::Object);
+}
+
+int ElementIdTable::findItem(QGraphicsItem* item) const {
+    return item ? findKey(item, Kind::GraphicsItem) : 0;
+}
+
+int ElementIdTable::idForObject(QObject* obj) {
+    if (!obj) return 0;
+    if (QGraphicsObject* go = qobject_cast<QGraphicsObject*>(obj))
+        return idForItem(go);
+
+    auto it = m_ptr2id.find(obj);
+    if (it != m_ptr2id.end()) {
+        const int index = (it.value() & kIndexMask) - 1;
+        Slot& s = m_slots[index];
+        if (s.kind == Kind::Object && s.track.data() == obj)
+            return it.value();
+        // The previous owner of this address is gone: recycle its slot.
+        m_ptr2id.erase(it);
+        freeSlot(index);
+    }
+
+    const int index = allocate();
+    if (index < 0) return 0;
+    Slot& s = m_slots[index];
+    s.kind  = Kind::Object;
+    s.track = obj;
+    s.key   = obj;
+    ++m_live;
+
+    const int id = makeId(index, s.generation);
+    m_ptr2id.insert(obj, id);
+    return id;
+}
+
+int ElementIdTable::idForItem(QGraphicsItem* item) {
+    if (!item) return 0;
+    QGraphicsObject* go = item->toGraphicsObject();
+    QObject* owner = go ? nullptr : plain_item_owner(item);
+
+    auto it = m_ptr2id.find(item);
+    if (it != m_ptr2id.end()) {
+        const int index = (it.value() & kIndexMask) - 1;
+        Slot& s = m_slots[index];
+        if (s.kind == Kind::GraphicsItem && !s.track.isNull() && s.owner == owner)
+            return it.value();
+        // Gone, or a plain item that moved to another owner: start over.
+        m_ptr2id.erase(it);
+        freeSlot(index);
+    }
+    if (!go && !owner) return 0;
+
+    const int index = allocate();
+    if (index < 0) return 0;
+    Slot& s = m_slots[index];
+    s.kind = Kind::GraphicsItem;
+    s.item = item;
+    s.key  = item;
+    // QGraphicsObjects can be tracked exactly; plain items live and die with their owner.
+    if (go) {
+        s.track = go;
+    } else {
+        s.track = owner;
+        s.owner = owner;
+        OwnedItems& ow = m_owned[owner];
+        ow.indices.insert(index);
+        // A new index holds only this item, which the caller just got from its owner.
+        if (ow.indices.size() == 1)
+            ow.checkedPass = m_pass;
+    }
+    ++m_live;
+
+    const int id = makeId(index, s.generation);
+    m_ptr2id.insert(item, id);
+    return id;
+}
+
+int ElementIdTable::idForAccessible(quint32 accessibleId, QObject* owner) {
+    if (!accessibleId || !owner) return 0;
+
+    auto it = m_acc2id.find(accessibleId);
+    if (it != m_acc2id.end()) {
+        const int index = (it.value() & kIndexMask) - 1;
+        Slot& s = m_slots[index];
+        if (s.kind == Kind::Accessible && !s.track.isNull())
+            return it.value();
+        m_acc2id.erase(it);
+        if (s.kind == Kind::Accessible && s.accessibleId == accessibleId)
+            freeSlot(index);
+    }
+
+    const int index = allocate();
+    if (index < 0) return 0;
+    Slot& s = m_slots[index];
+    s.kind = Kind::Accessible;
+    s.accessibleId = accessibleId;
+    s.track = owner;
+    ++m_live;
+
+    const int id = makeId(index, s.generation);
+    m_acc2id.insert(accessibleId, id);
+    return id;
+}
+
+QObject* ElementIdTable::object(int id) {
+    Slot* s = slotFor(id);
+    if (!s || s->kind != Kind::Object) return nullptr;
+    if (s->track.isNull()) {
+        freeSlot((id & kIndexMask) - 1);
+        return nullptr;
+    }
+    return s->track.data();
+}
+
+void ElementIdTable::validateOwner(const QObject* owner) {
+    auto ow = m_owned.find(owner);
+    if (ow == m_owned.end() || ow->checkedPass == m_pass) return;
+    ow->checkedPass = m_pass;
+
+    QSet<const QGraphicsItem*> present;
+    if (auto scene = qobject_cast<const QGraphicsScene*>(owner)) {
+        const QList<QGraphicsItem*> items = scene->items();
+        present.reserve(items.size());
+        for (QGraphicsItem* it : items)
+            present.insert(it);
+    } else if (auto go = qobject_cast<const QGraphicsObject*>(owner)) {
+        QList<QGraphicsItem*> pending = go->childItems();
+        while (!pending.isEmpty()) {
+            QGraphicsItem* it = pending.takeLast();
+            present.insert(it);
+            pending.append(it->childItems());
+        }
+    }
+
+    // freeSlot() edits the index (and drops it once empty), so iterate over a copy. A slot
+    // whose owner died may share the key with a new object at the same address.
+    const QSet<int> indices = ow->indices;
+    for (int index : indices) {
+        const Slot& s = m_slots[index];
+        if (s.track.isNull() || !present.contains(s.item))
+            freeSlot(index);
+    }
+}
+
+QGraphicsItem* ElementIdTable::graphicsItem(int id) {
+    Slot* s = slotFor(id);
+    if (!s || s->kind != Kind::GraphicsItem) return nullptr;
+    if (s->track.isNull()) {
+        freeSlot((id & kIndexMask) - 1);
+        return nullptr;
+    }
+    if (s->owner) {
+        // A plain item may have been deleted while its owner lives on.
+        validateOwner(s->owner);
+        s = slotFor(id);
+        if (!s) return nullptr;
+    }
+    return s->item;
+}
+
+quint32 ElementIdTable::accessibleId(int id) {
+    Slot* s = slotFor(id);
+    if (!s || s->kind != Kind::Accessible) return 0;
+    if (s->track.isNull()) {
+        freeSlot((id & kIndexMask) - 1);
+        return 0;
+    }
+    return s->accessibleId;
+}
+
+void ElementIdTable::release(int id) {
+    if (slotFor(id))
+        freeSlot((id & kIndexMask) - 1);
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <QHash>
+#include <QPointer>
+#include <QSet>
+#include <QVector>
+
+class QGraphicsItem;
+
+/// Element ids for QObjects and QGraphicsItems in one id space.
+///
+/// Ids are slot indices tagged with a per-slot generation counter, so a slot can be
+/// reused once its element is gone while ids handed out earlier are detected as stale
+/// instead of silently resolving to the new occupant. A slot whose generations are used
+/// up is retired rather than reused, so no id is ever handed out twice. The limit that
+/// comes with 31-bit ids: about 2^31 registrations (2M slots x 1024 generations) over the
+/// life of the process, after which registrations fail like any other overflow.
+/// Objects are tracked through QPointer (no per-object signal connection); dead entries
+/// are reclaimed lazily when they are looked up or their address is registered again.
+///
+/// Plain QGraphicsItems cannot be observed, so they are tied to an owner they live and
+/// die with: their scene, or outside a scene their nearest QGraphicsObject ancestor.
+/// Before an id of a plain item resolves, the table checks that the item is still in its
+/// owner. That check lists the owner's items, so it is done at most once per owner and
+/// pass; the server starts a new pass (newPass()) whenever application code may have run
+/// since the last lookup. Plain items with neither owner get id 0, since nothing could
+/// tell when they are deleted. QGraphicsObjects are tracked like QObjects and have one id
+/// whether they are registered as object or as item.
+///
+/// Accessible interfaces without an object of their own (item view cells, list items) are
+/// registered by their QAccessible::Id and tied to an owner object, usually the view.
+class ElementIdTable {
+public:
+    /// Returns the id of obj/item, registering it if needed (0 for nullptr).
+    int idForObject(QObject* obj);
+    int idForItem(QGraphicsItem* item);
+    int idForAccessible(quint32 accessibleId, QObject* owner);
+
+    /// Id already assigned to obj/item, 0 if none.
+    int find(QObject* obj) const;
+    int findItem(QGraphicsItem* item) const;
+
+    /// Resolves an id; nullptr if unknown, stale or of the other kind. Ids of
+    /// QGraphicsObjects resolve through graphicsItem().
+    QObject* object(int id);
+    QGraphicsItem* graphicsItem(int id);
+    /// QAccessible::Id registered for id, 0 if unknown, stale or of another kind.
+    /// The caller still has to check that the interface exists.
+    quint32 accessibleId(int id);
+
+    /// Frees the slot of id (no-op for unknown/stale ids).
+    void release(int id);
+
+    /// Plain items looked up from now on are checked against their scene again.
+    void newPass() noexcept { ++m_pass; }
+
+    /// Whether a registration failed because all slots are taken (such elements get id 0)
+    /// since the previous call.
+    bool takeOverflow() noexcept { const bool o = m_overflow; m_overflow = false; return o; }
+
+    /// Number of live slots.
+    int size() const noexcept { return m_live; }
+    /// Number of slots retired because their generations ran out.
+    int retired() const noexcept { return m_retired; }
+
+private:
+    enum class Kind : quint8 { Free, Object, GraphicsItem, Accessible };
+
+    struct Slot {
+        QPointer<QObject> track;      // the object itself, the owner of a plain graphics item
+                                      // or the owner of an accessible interface
+        const void* key = nullptr;    // m_ptr2id key, kept raw: track is null once the object is gone
+        QGraphicsItem* item = nullptr;
+        const QObject* owner = nullptr; // plain graphics items: scene or ancestor, kept raw like key
+        quint32 accessibleId = 0;
+        quint32 generation = 1;
+        int nextFree = -1;
+        Kind kind = Kind::Free;
+    };
+
+    static const int kIndexBits = 21; // up to 2M live elements, 1024 generations per slot
+    static const int kIndexMask = (1 << kIndexBits) - 1;
+    static const quint32 kGenerationMask = (1u << (31 - kIndexBits)) - 1;
+
+    static int makeId(int index, quint32 generation) {
+        return static_cast<int>((generation & kGenerationMask) << kIndexBits) | (index + 1);
+    }
+    Slot* slotFor(int id);
+    int allocate();
+    void freeSlot(int index);
+    int findKey(const void* key, Kind kind) const;
+    void validateOwner(const QObject* owner);
+
+    // Plain items per owner, so an owner is validated without scanning all slots.
+    struct OwnedItems {
+        QSet<int> indices;
+        quint64 checkedPass = 0;
+    };
+
+    QVector<Slot> m_slots;
+    QHash<const void*, int> m_ptr2id; // QObject* / QGraphicsItem* -> id
+    QHash<quint32, int> m_acc2id;     // QAccessible::Id -> id
+    QHash<const QObject*, OwnedItems> m_owned;
+    quint64 m_pass = 1;
+    int m_freeHead = -1;
+    int m_live = 0;
+    int m_retired = 0;
+    bool m_overflow = false;
+};
@@ -0,0 +1,158 @@
+#include "qt_model_pager.h"
+
+#include <QAbstractItemModel>
+#include <QAbstractItemView>
+#include <QHeaderView>
+#include <QItemSelectionModel>
+#include <QTableView>
+#include <QTreeView>
+
+namespace injectlib {
+
+namespace {
+
+QJsonArray rect_to_array(const QRect& r) {
+    return QJsonArray{ r.x(), r.y(), r.width(), r.height() };
+}
+
+QJsonArray header_labels(const QAbstractItemModel* model, int first, int count) {
+    QJsonArray out;
+    for (int c = first; c < first + count; ++c)
+        out.push_back(model->headerData(c, Qt::Horizontal, Qt::DisplayRole).toString());
+    return out;
+}
+
+} // namespace
+
+quint32 parse_model_fields(const QJsonValue& names) {
+    const QJsonArray list = names.toArray();
+    if (list.isEmpty())
+        return ModelAll;
+
+    quint32 mask = 0;
+    for (const QJsonValue& n : list) {
+        const QString f = n.toString();
+        if (f == QLatin1String("text"))          mask |= ModelText;
+        else if (f == QLatin1String("selected")) mask |= ModelSelected;
+        else if (f == QLatin1String("rect"))     mask |= ModelRect;
+        else if (f == QLatin1String("checked"))  mask |= ModelChecked;
+    }
+    return mask;
+}
+
+bool resolve_model_path(const QAbstractItemView* view, const QJsonArray& path, QModelIndex& out, QString* error) {
+    const QAbstractItemModel* model = view->model();
+    QModelIndex idx = view->rootIndex();
+    for (const QJsonValue& v : path) {
+        const int row = v.toInt(-1);
+        if (row < 0 || row >= model->rowCount(idx)) {
+            *error = QStringLiteral("parent row %1 out of range").arg(row);
+            return false;
+        }
+        idx = model->index(row, 0, idx);
+    }
+    out = idx;
+    return true;
+}
+
+QJsonObject model_info(const QAbstractItemView* view, const QModelIndex& parent) {
+    const QAbstractItemModel* model = view->model();
+    const int columns = model->columnCount(parent);
+
+    QJsonObject r;
+    r["rows"]    = model->rowCount(parent);
+    r["columns"] = columns;
+    r["headers"] = header_labels(model, 0, columns);
+    r["model_class"] = QString::fromLatin1(model->metaObject()->className());
+    if (const QModelIndex cur = view->currentIndex(); cur.isValid() && cur.parent() == parent)
+        r["current"] = QJsonArray{ cur.row(), cur.column() };
+    return r;
+}
+
+QJsonObject model_page(const QAbstractItemView* view, const ModelPage& page) {
+    const QAbstractItemModel* model = view->model();
+    const QItemSelectionModel* sel = view->selectionModel();
+    const QTreeView* tree = qobject_cast<const QTreeView*>(view);
+    const QTableView* table = qobject_cast<const QTableView*>(view);
+    const QWidget* viewport = view->viewport();
+    const QRect visibleArea = viewport->rect();
+
+    const int totalRows = model->rowCount(page.parent);
+    const int totalCols = model->columnCount(page.parent);
+    const int row0 = qBound(0, page.row, totalRows);
+    int row1 = qBound(row0, row0 + qMax(0, page.count), totalRows);
+    const int col0 = qBound(0, page.column, totalCols);
+    int col1 = page.columns < 0 ? totalCols : qBound(col0, col0 + page.columns, totalCols);
+
+    // Every cell costs data() calls and possibly a visualRect, so wide models are capped by
+    // cells, not rows. The client continues at the row after the last one returned.
+    bool truncated = false;
+    if (page.maxCells > 0) {
+        if (col1 - col0 > page.maxCells) {
+            col1 = col0 + page.maxCells;
+            truncated = true;
+        }
+        const int maxRows = page.maxCells / qMax(1, col1 - col0);
+        if (row1 - row0 > maxRows) {
+            row1 = row0 + maxRows;
+            truncated = true;
+        }
+    }
+
+    QJsonArray rows;
+    for (int r = row0; r < row1; ++r) {
+        QJsonObject row;
+        row["row"] = r;
+
+        const bool hidden = (tree && tree->isRowHidden(r, page.parent)) || (table && table->isRowHidden(r));
+        if (hidden)
+            row["hidden"] = true;
+
+        QJsonArray cells;
+        for (int c = col0; c < col1; ++c) {
+            const QModelIndex idx = model->index(r, c, page.parent);
+            QJsonObject cell;
+            if (page.fields & ModelText)
+                cell["text"] = idx.data(Qt::DisplayRole).toString();
+            if (page.fields & ModelSelected)
+                cell["selected"] = sel ? sel->isSelected(idx) : false;
+            if (page.fields & ModelChecked) {
+                const QVariant check = idx.data(Qt::CheckStateRole);
+                if (check.isValid())
+                    cell["checked"] = check.toInt();
+            }
+            if ((page.fields & ModelRect) && !hidden) {
+                // visualRect is in viewport coordinates and empty for cells that are not laid out.
+                const QRect vr = view->visualRect(idx);
+                if (vr.isValid()) {
+                    cell["rect"]    = rect_to_array(QRect(viewport->mapToGlobal(vr.topLeft()), vr.size()));
+                    cell["visible"] = visibleArea.intersects(vr);
+                }
+            }
+            cells.push_back(cell);
+        }
+        row["cells"] = cells;
+
+        if (tree) {
+            const QModelIndex first = model->index(r, 0, page.parent);
+            const bool children = model->hasChildren(first);
+            row["has_children"] = children;
+            if (children)
+                row["expanded"] = tree->isExpanded(first);
+        }
+        rows.push_back(row);
+    }
+
+    QJsonObject out;
+    out["rows"]    = totalRows;
+    out["columns"] = totalCols;
+    out["row"]     = row0;
+    out["column"]  = col0;
+    out["headers"] = header_labels(model, col0, col1 - col0);
+    out["items"]   = rows;
+    if (truncated)
+        out["truncated"] = true;
+    return out;
+}
+
+} // namespace injectlib
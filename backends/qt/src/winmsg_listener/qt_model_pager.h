@@ -0,0 +1,47 @@
+#pragma once
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QModelIndex>
+#include <QString>
+
+class QAbstractItemView;
+
+// Windowed access to the model behind an item view (model.info / model.rows).
+// Only the requested rows x columns are touched, so huge models cost no more than
+// a page; cells are addressed by (row, column, parent path) and never get element ids.
+namespace injectlib {
+
+/// Cell attributes that can be requested via the "fields" parameter of model.rows.
+enum ModelField : quint32 {
+    ModelText     = 1u << 0, // Qt::DisplayRole as string
+    ModelSelected = 1u << 1,
+    ModelRect     = 1u << 2, // global rect and whether it is inside the viewport
+    ModelChecked  = 1u << 3, // Qt::CheckStateRole, only for checkable cells
+    ModelAll      = (1u << 4) - 1
+};
+
+quint32 parse_model_fields(const QJsonValue& names);
+
+struct ModelPage {
+    QModelIndex parent;  // invalid: top level
+    int row = 0;
+    int count = 100;
+    int column = 0;
+    int columns = -1;    // < 0: up to the last column
+    quint32 fields = ModelAll;
+    int maxCells = 0;    // > 0: at most this many cells (rows x columns), <= 0: no limit
+};
+
+/// Resolves a parent path (row numbers from the top level, column 0) to an index.
+/// An empty path is the top level. Returns false if a row is out of range.
+bool resolve_model_path(const QAbstractItemView* view, const QJsonArray& path, QModelIndex& out, QString* error);
+
+/// Dimensions and header labels of view's model under parent.
+QJsonObject model_info(const QAbstractItemView* view, const QModelIndex& parent);
+
+/// The requested window of rows/columns (clamped to the model and to page.maxCells;
+/// "truncated" is set if the cell limit cut it short).
+QJsonObject model_page(const QAbstractItemView* view, const ModelPage& page);
+
+} // namespace injectlib
@@ -0,0 +1,396 @@
+#include "qt_net_worker.h"
+#include "qt_server.h"
+#include "qt_util.h"
+#include "qt_stats.h"
+
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QLocalServer>
+#include <QLocalSocket>
+#include <QJsonDocument>
+#include <QCborValue>
+#include <QCborMap>
+#include <QMetaObject>
+#include <QThread>
+#include <QElapsedTimer>
+
+using injectlib::dbg;
+using injectlib::read_env_int;
+using injectlib::clamp_int;
+using injectlib::ServerStats;
+using injectlib::server_stats;
+
+namespace {
+
+// Client connections are QTcpSockets or QLocalSockets; the few socket calls that are not
+// part of QIODevice go through these.
+bool is_connected(const QIODevice* dev) {
+    if (auto s = qobject_cast<const QAbstractSocket*>(dev))
+        return s->state() == QAbstractSocket::ConnectedState;
+    if (auto l = qobject_cast<const QLocalSocket*>(dev))
+        return l->state() == QLocalSocket::ConnectedState;
+    return false;
+}
+
+void flush_device(QIODevice* dev) {
+    if (auto s = qobject_cast<QAbstractSocket*>(dev))
+        s->flush();
+    else if (auto l = qobject_cast<QLocalSocket*>(dev))
+        l->flush();
+}
+
+void drop_client(QIODevice* dev) {
+    if (auto s = qobject_cast<QAbstractSocket*>(dev))
+        s->disconnectFromHost();
+    else if (auto l = qobject_cast<QLocalSocket*>(dev))
+        l->disconnectFromServer();
+}
+
+// Serializes and writes one frame; the time of both steps is accounted to the given
+// statistics slot (see ServerStats::methodIndex).
+void write_frame(QIODevice* sock, const QJsonObject& obj, bool cbor, int statSlot) {
+    QElapsedTimer t;
+    t.start();
+    QByteArray frame;
+    if (cbor) {
+        const QByteArray payload = QCborValue::fromJsonValue(obj).toCbor();
+        const quint32 n = static_cast<quint32>(payload.size());
+        const char prefix[4] = { char(n >> 24), char(n >> 16), char(n >> 8), char(n) };
+        frame.reserve(payload.size() + 4);
+        frame.append(prefix, 4);
+        frame.append(payload);
+    } else {
+        QByteArray payload = QJsonDocument(obj).toJson(QJsonDocument::Compact);
+        frame = QByteArray::number(payload.size()) + "\n" + payload;
+    }
+    ServerStats& stats = server_stats();
+    const qint64 serialized = t.nsecsElapsed();
+    stats.record(statSlot, ServerStats::StageSerialize, serialized);
+
+    sock->write(frame);
+    flush_device(sock);
+    stats.record(statSlot, ServerStats::StageWrite, t.nsecsElapsed() - serialized);
+    stats.bytesOut.fetch_add(static_cast<quint64>(frame.size()), std::memory_order_relaxed);
+    stats.framesOut.fetch_add(1, std::memory_order_relaxed);
+}
+
+// Decodes one request payload in the connection's current encoding.
+bool decode_request(const QByteArray& payload, bool cbor, QJsonObject& req, QString& error) {
+    if (cbor) {
+        QCborParserError parseError;
+        const QCborValue v = QCborValue::fromCbor(payload, &parseError);
+        if (parseError.error != QCborError::NoError || !v.isMap()) {
+            error = parseError.error != QCborError::NoError ? parseError.errorString()
+                                                            : QStringLiteral("request is not a map");
+            return false;
+        }
+        req = v.toMap().toJsonObject();
+        return true;
+    }
+
+    QJsonParseError parseError;
+    QJsonDocument doc = QJsonDocument::fromJson(payload, &parseError);
+    if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
+        error = parseError.error != QJsonParseError::NoError ? parseError.errorString()
+                                                             : QStringLiteral("request is not an object");
+        return false;
+    }
+    req = doc.object();
+    return true;
+}
+
+} // namespace
+
+QtNetWorker::QtNetWorker(QtHelloServer* handler)
+    : QObject(nullptr),
+      m_handler(handler),
+      m_maxInflight(clamp_int(read_env_int("QT_INJECTED_MAX_INFLIGHT", 32), 1, 4096)),
+      m_maxPendingWrite(static_cast<qint64>(clamp_int(read_env_int("QT_INJECTED_MAX_PENDING_WRITE_KB", 8192),
+                                                      64, 1024 * 1024)) * 1024),
+      m_maxFrame(clamp_int(read_env_int("QT_INJECTED_MAX_FRAME_KB", 16384), 1, 1024 * 1024) * 1024),
+      m_tcpNoDelay(read_env_int("QT_INJECTED_TCP_NODELAY", 1) != 0)
+{
+    // The servers are created in listen()/listenLocal() on the network thread.
+}
+
+void QtNetWorker::listen(const QHostAddress& addr, quint16 port) {
+    if (!m_server) {
+        m_server = new QTcpServer(this);
+        connect(m_server, &QTcpServer::newConnection,
+                this, &QtNetWorker::onNewConnection);
+    }
+
+    if (!m_server->listen(addr, port)) {
+        emit listenFailed(m_server->errorString());
+        return;
+    }
+    emit listening(m_server->serverPort());
+}
+
+void QtNetWorker::listenLocal(const QString& name) {
+    if (!m_localServer) {
+        m_localServer = new QLocalServer(this);
+        // Only the user running the target may connect.
+        m_localServer->setSocketOptions(QLocalServer::UserAccessOption);
+        connect(m_localServer, &QLocalServer::newConnection,
+                this, &QtNetWorker::onNewLocalConnection);
+    }
+
+    // A socket file left behind by a crashed process with the same PID would make listen() fail.
+    QLocalServer::removeServer(name);
+    if (!m_localServer->listen(name)) {
+        emit listenFailed(m_localServer->errorString());
+        return;
+    }
+    emit listeningLocal(m_localServer->fullServerName());
+}
+
+void QtNetWorker::close() {
+    if (m_server)
+        m_server->close();
+    if (m_localServer)
+        m_localServer->close();
+
+    const QList<QIODevice*> clients = m_conns.keys();
+    for (QIODevice* c : clients)
+        drop_client(c);
+
+    emit closed();
+}
+
+void QtNetWorker::onNewConnection() {
+    while (m_server->hasPendingConnections()) {
+        QTcpSocket* c = m_server->nextPendingConnection();
+        // Frames are small and latency bound; don't let Nagle hold them back.
+        if (m_tcpNoDelay)
+            c->setSocketOption(QAbstractSocket::LowDelayOption, 1);
+        // Qt buffers without limit by default; past one frame, leave the rest in the kernel
+        // so a client outrunning the GUI thread is throttled by TCP flow control.
+        c->setReadBufferSize(static_cast<qint64>(m_maxFrame) + FrameDecoder::kMaxHeader);
+        connect(c, &QTcpSocket::disconnected, c, &QObject::deleteLater);
+        addConnection(c);
+    }
+}
+
+void QtNetWorker::onNewLocalConnection() {
+    while (m_localServer->hasPendingConnections()) {
+        QLocalSocket* c = m_localServer->nextPendingConnection();
+        c->setReadBufferSize(static_cast<qint64>(m_maxFrame) + FrameDecoder::kMaxHeader);
+        connect(c, &QLocalSocket::disconnected, c, &QObject::deleteLater);
+        addConnection(c);
+    }
+}
+
+void QtNetWorker::addConnection(QIODevice* c) {
+    INJECTLIB_LOG(injectlib::LogDebug, QString::fromLatin1("[injectlib] New connection (sock=%1)\n")
+            .arg(reinterpret_cast<qulonglong>(c)));
+
+    // Parent the socket to us (the servers parent it to themselves).
+    c->setParent(this);
+    ConnState st;
+    st.decoder = FrameDecoder(m_maxFrame);
+    st.id = m_nextConnId++;
+    m_conns.insert(c, st);
+
+    // Let the GUI thread drop per-connection state such as subscriptions.
+    const quint64 connId = st.id;
+    QtHelloServer* handler = m_handler;
+    server_stats().connections.fetch_add(1, std::memory_order_relaxed);
+    connect(c, &QObject::destroyed, this, [this, c, connId, handler]() {
+        server_stats().connections.fetch_sub(1, std::memory_order_relaxed);
+        m_conns.remove(c);
+        QMetaObject::invokeMethod(handler, [handler, connId]() { handler->connectionClosed(connId); },
+                                  Qt::QueuedConnection);
+    });
+    connect(c, &QIODevice::readyRead, this, [this, c]() { onReadyRead(c); });
+
+    // Backpressure: resume reading once the client has drained enough output.
+    connect(c, &QIODevice::bytesWritten, this, [this, c]() {
+        if (c->bytesToWrite() < m_maxPendingWrite / 2 && hasUnread(c))
+            onReadyRead(c);
+    });
+}
+
+bool QtNetWorker::canAccept(QIODevice* c) const {
+    const auto it = m_conns.constFind(c);
+    if (it == m_conns.constEnd()) return false;
+    return it->inflight < m_maxInflight && c->bytesToWrite() < m_maxPendingWrite;
+}
+
+bool QtNetWorker::hasUnread(QIODevice* c) const {
+    const auto it = m_conns.constFind(c);
+    if (it == m_conns.constEnd()) return false;
+    return it->decoder.buffered() > 0 || c->bytesAvailable() > 0;
+}
+
+void QtNetWorker::onReadyRead(QIODevice* c) {
+    auto it = m_conns.find(c);
+    if (it == m_conns.end()) return;
+    FrameDecoder& decoder = it->decoder;
+
+    // Unread frames stay buffered (and then in the socket) until a slot frees up,
+    // see finishRequest().
+    while (canAccept(c)) {
+        QByteArray payload;
+        const FrameDecoder::Result r = decoder.next(payload);
+
+        if (r == FrameDecoder::Result::Error) {
+            INJECTLIB_LOG(injectlib::LogError, QString::fromLatin1("[injectlib] %1\n").arg(decoder.errorString()));
+            drop_client(c);
+            return;
+        }
+        if (r == FrameDecoder::Result::NeedMore) {
+            // Partial frame: wait for the next readyRead unless the socket already has more.
+            const qint64 n = decoder.readFrom(c);
+            if (n <= 0)
+                return;
+            server_stats().bytesIn.fetch_add(static_cast<quint64>(n), std::memory_order_relaxed);
+            continue;
+        }
+
+        // payload is a view into the decoder buffer; parse before reading more.
+        QElapsedTimer parse;
+        parse.start();
+        QJsonObject req;
+        QString error;
+        server_stats().framesIn.fetch_add(1, std::memory_order_relaxed);
+        if (!decode_request(payload, decoder.isBinary(), req, error)) {
+            INJECTLIB_LOG(injectlib::LogError, QString::fromLatin1("[injectlib] Invalid request: %1\n").arg(error));
+            drop_client(c);
+            return;
+        }
+
+        handleRequest(c, req, parse.nsecsElapsed());
+    }
+}
+
+void QtNetWorker::handleRequest(QIODevice* c, const QJsonObject& req, qint64 parseNs) {
+    const int reqId = req.value("id").toInt(-1);
+    const QString method = req.value("method").toString();
+    const int statSlot = ServerStats::methodIndex(method);
+    server_stats().record(statSlot, ServerStats::StageParse, parseNs);
+
+    INJECTLIB_LOG(injectlib::LogDebug, QString::fromLatin1("[injectlib] Request: id=%1, method=%2\n").arg(reqId).arg(method));
+
+    // Nothing in ping touches the widget tree, so it never waits for the GUI thread.
+    if (method == QLatin1String("ping")) {
+        answerLocally(c, QtHelloServer::handlePing(reqId), statSlot);
+        return;
+    }
+
+    // Statistics and logging are process-wide atomics; answering here keeps them available
+    // while the GUI thread is busy, which is when they are needed most.
+    // Expect: { "id": X, "method": "server.stats", "params": { "reset": <bool> } }
+    if (method == QLatin1String("server.stats")) {
+        QJsonObject resp;
+        resp["id"] = reqId;
+        QJsonObject result = server_stats().toJson();
+        result["log_level"] = injectlib::log_level();
+        resp["result"] = result;
+        if (req.value("params").toObject().value("reset").toBool(false))
+            server_stats().reset();
+        answerLocally(c, resp, statSlot);
+        return;
+    }
+    // Expect: { "id": X, "method": "server.setLogLevel", "params": { "level": 0..4 } }
+    if (method == QLatin1String("server.setLogLevel")) {
+        injectlib::set_log_level(req.value("params").toObject().value("level").toInt(injectlib::LogInfo));
+        QJsonObject resp;
+        resp["id"] = reqId;
+        QJsonObject result;
+        result["log_level"] = injectlib::log_level();
+        resp["result"] = result;
+        answerLocally(c, resp, statSlot);
+        return;
+    }
+
+    // Connection-level wire format switch, advertised by ping's "encodings".
+    // Expect: { "id": X, "method": "session.setEncoding", "params": { "encoding": "json" | "cbor" } }
+    // The reply still uses the old encoding; everything after it uses the new one, so the
+    // client must not pipeline other requests behind this one.
+    if (method == QLatin1String("session.setEncoding")) {
+        const QString enc = req.value("params").toObject().value("encoding").toString();
+        QJsonObject resp;
+        resp["id"] = reqId;
+        if (enc != QLatin1String("json") && enc != QLatin1String("cbor")) {
+            QJsonObject err;
+            err["code"] = -32602;
+            err["message"] = QStringLiteral("Invalid params: unsupported encoding");
+            resp["error"] = err;
+            answerLocally(c, resp, statSlot);
+            return;
+        }
+        QJsonObject result;
+        result["ok"] = true;
+        result["encoding"] = enc;
+        resp["result"] = result;
+        answerLocally(c, resp, statSlot);
+
+        auto it = m_conns.find(c);
+        if (it != m_conns.end())
+            it->decoder.setBinary(enc == QLatin1String("cbor"));
+        return;
+    }
+
+    ConnState& st = m_conns[c];
+    ++st.inflight;
+    server_stats().inflight.fetch_add(1, std::memory_order_relaxed);
+
+    // Runs on the GUI thread once the request is handled, possibly out of order with
+    // respect to other requests on this connection; the client matches on "id".
+    QPointer<QIODevice> sock(c);
+    QtNetWorker* worker = this;
+    QtHelloServer* handler = m_handler;
+    auto reply = [handler, worker, sock, statSlot](const QJsonObject& resp) {
+        // The worker is only ever deleted by stop() on the GUI thread.
+        if (handler->netWorker() != worker) return;
+        QMetaObject::invokeMethod(worker, [worker, sock, resp, statSlot]() {
+            server_stats().inflight.fetch_sub(1, std::memory_order_relaxed);
+            if (sock) worker->finishRequest(sock.data(), resp, statSlot);
+        }, Qt::QueuedConnection);
+    };
+
+    // Unsolicited frames (e.g. change notifications), valid for the connection's lifetime.
+    auto push = [handler, worker, sock](const QJsonObject& frame) {
+        if (handler->netWorker() != worker) return;
+        QMetaObject::invokeMethod(worker, [worker, sock, frame]() {
+            if (sock) worker->sendFrame(sock.data(), frame, ServerStats::pushIndex());
+        }, Qt::QueuedConnection);
+    };
+
+    QtHelloServer::PendingRequest pending;
+    pending.req   = req;
+    pending.reply = reply;
+    pending.push  = push;
+    pending.conn  = st.id;
+    pending.statSlot = statSlot;
+    pending.queued.start();
+    QMetaObject::invokeMethod(handler, [handler, pending]() { handler->submit(pending); },
+                              Qt::QueuedConnection);
+}
+
+void QtNetWorker::answerLocally(QIODevice* c, const QJsonObject& resp, int statSlot) {
+    server_stats().countCall(statSlot, resp.contains("error"));
+    sendFrame(c, resp, statSlot);
+}
+
+void QtNetWorker::finishRequest(QIODevice* c, const QJsonObject& resp, int statSlot) {
+    auto it = m_conns.find(c);
+    if (it == m_conns.end()) return;
+    --it->inflight;
+
+    server_stats().countCall(statSlot, resp.contains("error"));
+    sendFrame(c, resp, statSlot);
+
+    // A slot is free again: pick up frames left unread while we were at the limit.
+    if (hasUnread(c))
+        onReadyRead(c);
+}
+
+void QtNetWorker::sendFrame(QIODevice* sock, const QJsonObject& frame, int statSlot) {
+    if (!is_connected(sock))
+        return;
+    const auto it = m_conns.constFind(sock);
+    const bool cbor = it != m_conns.constEnd() && it->decoder.isBinary();
+    write_frame(sock, frame, cbor, statSlot);
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QJsonObject>
+#include <QPointer>
+#include <QHash>
+
+#include "qt_frame_decoder.h"
+
+class QIODevice;
+class QLocalServer;
+class QTcpServer;
+class QtHelloServer;
+
+/// Owns the listening socket and all client connections on a dedicated network thread.
+/// Clients connect over TCP or over a local socket (Unix domain socket / named pipe);
+/// past accept() both are handled as plain QIODevices.
+/// Framing, JSON parsing and serialization happen here; only the handler work that
+/// touches the widget tree is marshalled to the GUI thread (one queued call per request).
+///
+/// Requests are pipelined: a client may keep many requests in flight on one connection
+/// and responses go out as soon as they are ready, matched by their "id". Reading stops
+/// while a connection is at its in-flight limit or has too much unsent output.
+class QtNetWorker : public QObject {
+    Q_OBJECT
+public:
+    explicit QtNetWorker(QtHelloServer* handler);
+
+    /// Start listening. Must run on the network thread; emits listening() or listenFailed().
+    void listen(const QHostAddress& addr, quint16 port);
+
+    /// Start listening on a local socket. Must run on the network thread; emits
+    /// listeningLocal() with the full server name (socket path / pipe name) or listenFailed().
+    void listenLocal(const QString& name);
+
+    /// Stop listening and drop all clients. Must run on the network thread.
+    void close();
+
+signals:
+    void listening(quint16 port);
+    void listeningLocal(const QString& fullServerName);
+    void listenFailed(const QString& error);
+    void closed();
+
+private:
+    struct ConnState {
+        FrameDecoder decoder; // binary framing <=> CBOR encoding (session.setEncoding)
+        int inflight = 0; // requests handed to the GUI thread and not answered yet
+        quint64 id = 0;   // identifies the connection to the GUI thread (subscriptions)
+    };
+
+    void onNewConnection();
+    void onNewLocalConnection();
+    void addConnection(QIODevice* sock);
+    void onReadyRead(QIODevice* sock);
+    bool canAccept(QIODevice* sock) const;
+    bool hasUnread(QIODevice* sock) const;
+    void handleRequest(QIODevice* sock, const QJsonObject& req, qint64 parseNs);
+    void answerLocally(QIODevice* sock, const QJsonObject& resp, int statSlot);
+    void finishRequest(QIODevice* sock, const QJsonObject& resp, int statSlot);
+    void sendFrame(QIODevice* sock, const QJsonObject& frame, int statSlot);
+
+    QtHelloServer* m_handler{nullptr}; // lives on the GUI thread
+    QTcpServer*    m_server{nullptr};
+    QLocalServer*  m_localServer{nullptr};
+    QHash<QIODevice*, ConnState> m_conns;
+    quint64 m_nextConnId = 1;
+
+    int    m_maxInflight;     // per connection, QT_INJECTED_MAX_INFLIGHT
+    qint64 m_maxPendingWrite; // bytes, QT_INJECTED_MAX_PENDING_WRITE_KB
+    int    m_maxFrame;        // bytes, QT_INJECTED_MAX_FRAME_KB
+    bool   m_tcpNoDelay;      // QT_INJECTED_TCP_NODELAY (default on)
+};
@@ -0,0 +1,125 @@
+#include "qt_property_reader.h"
+
+#include <QColor>
+#include <QFont>
+#include <QMetaObject>
+#include <QMetaProperty>
+#include <QObject>
+#include <QPointF>
+#include <QRectF>
+#include <QSizeF>
+#include <QUrl>
+#include <QVariant>
+
+namespace injectlib {
+
+PropertyReader::ClassIndices& PropertyReader::indicesFor(const QMetaObject* mo) {
+    const char* cls = mo->className();
+    auto it = m_indices.find(QByteArray::fromRawData(cls, int(qstrlen(cls))));
+    if (it == m_indices.end())
+        it = m_indices.insert(QByteArray(cls), ClassIndices());
+    return it.value();
+}
+
+int PropertyReader::indexOf(const QObject* obj, const QByteArray& name) {
+    const QMetaObject* mo = obj->metaObject();
+    ClassIndices& indices = indicesFor(mo);
+    auto it = indices.constFind(name);
+    if (it != indices.constEnd())
+        return it.value();
+    const int index = mo->indexOfProperty(name.constData());
+    indices.insert(name, index);
+    return index;
+}
+
+QJsonObject PropertyReader::read(const QObject* obj, const QList<QByteArray>& names, QJsonArray* missing,
+                                 const ObjectIdFn& idFor) {
+    QJsonObject values;
+    const QMetaObject* mo = obj->metaObject();
+    ClassIndices& indices = indicesFor(mo);
+
+    for (const QByteArray& name : names) {
+        auto it = indices.constFind(name);
+        if (it == indices.constEnd())
+            it = indices.insert(name, mo->indexOfProperty(name.constData()));
+
+        const QString key = QString::fromUtf8(name);
+        if (it.value() >= 0) {
+            values[key] = variant_to_json(mo->property(it.value()).read(obj), idFor);
+            continue;
+        }
+        // Dynamic properties (setProperty() with an undeclared name) belong to the object.
+        const QVariant dynamic = obj->property(name.constData());
+        if (dynamic.isValid())
+            values[key] = variant_to_json(dynamic, idFor);
+        else if (missing)
+            missing->push_back(key);
+    }
+    return values;
+}
+
+QJsonValue variant_to_json(const QVariant& v, const ObjectIdFn& idFor) {
+    if (!v.isValid() || v.isNull())
+        return QJsonValue();
+
+    const int type = v.userType();
+    if (QMetaType::typeFlags(type) & QMetaType::PointerToQObject) {
+        QObject* o = v.value<QObject*>();
+        return (o && idFor) ? QJsonValue(idFor(o)) : QJsonValue();
+    }
+
+    switch (type) {
+    case QMetaType::QColor:
+        return v.value<QColor>().name(QColor::HexArgb);
+    case QMetaType::QFont:
+        return v.value<QFont>().toString();
+    case QMetaType::QUrl:
+        return v.toUrl().toString();
+    case QMetaType::QPoint:
+    case QMetaType::QPointF: {
+        const QPointF p = v.toPointF();
+        return QJsonArray{ p.x(), p.y() };
+    }
+    case QMetaType::QSize:
+    case QMetaType::QSizeF: {
+        const QSizeF s = v.toSizeF();
+        return QJsonArray{ s.width(), s.height() };
+    }
+    case QMetaType::QRect:
+    case QMetaType::QRectF: {
+        const QRectF r = v.toRectF();
+        return QJsonArray{ r.x(), r.y(), r.width(), r.height() };
+    }
+    case QMetaType::QVariantList:
+    case QMetaType::QStringList: {
+        QJsonArray out;
+        const QVariantList list = v.toList();
+        for (const QVariant& item : list)
+            out.push_back(variant_to_json(item, idFor));
+        return out;
+    }
+    case QMetaType::QVariantMap: {
+        QJsonObject out;
+        const QVariantMap map = v.toMap();
+        for (auto it = map.constBegin(); it != map.constEnd(); ++it)
+            out[it.key()] = variant_to_json(it.value(), idFor);
+        return out;
+    }
+    default:
+        break;
+    }
+
+    const QJsonValue j = QJsonValue::fromVariant(v);
+    if (!j.isNull())
+        return j;
+    // Registered enums convert to their key; other custom types at least to a number.
+    if (v.canConvert<QString>()) {
+        const QString s = v.toString();
+        if (!s.isEmpty()) return s;
+    }
+    if (v.canConvert<int>())
+        return v.toInt();
+    return QJsonValue();
+}
+
+} // namespace injectlib
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonValue>
+#include <QList>
+
+#include <functional>
+
+class QObject;
+class QMetaObject;
+class QVariant;
+
+// Batched property reads (elements.properties, Qt Quick summaries). A lookup by name walks
+// the whole meta-object chain with string compares; the reader resolves every
+// (class, property name) pair once and reads later objects of that class by index.
+namespace injectlib {
+
+/// Element id for an object-valued property, 0 if none.
+using ObjectIdFn = std::function<int(QObject*)>;
+
+class PropertyReader {
+public:
+    /// Index of property name in obj's class, -1 if the class has none.
+    int indexOf(const QObject* obj, const QByteArray& name);
+
+    /// Reads names from obj. Names that are neither declared nor dynamic properties are
+    /// left out of the result and appended to missing (if given).
+    QJsonObject read(const QObject* obj, const QList<QByteArray>& names, QJsonArray* missing,
+                     const ObjectIdFn& idFor = ObjectIdFn());
+
+    /// Number of cached classes.
+    int cachedClasses() const noexcept { return m_indices.size(); }
+
+private:
+    using ClassIndices = QHash<QByteArray, int>;
+    ClassIndices& indicesFor(const QMetaObject* mo);
+
+    // Keyed by class name rather than QMetaObject*: QML objects carry per-instance dynamic
+    // meta-objects, and the address of a dead one can be reused by a different class.
+    QHash<QByteArray, ClassIndices> m_indices;
+};
+
+/// JSON form of a property value: numbers, strings and bools as is, geometry as arrays,
+/// colors as "#aarrggbb", enums as their key, objects as element ids (via idFor),
+/// lists and maps recursively; null if there is no sensible form.
+QJsonValue variant_to_json(const QVariant& v, const ObjectIdFn& idFor = ObjectIdFn());
+
+} // namespace injectlib
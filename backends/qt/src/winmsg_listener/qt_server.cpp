@@ -1,7 +1,9 @@
 #include "qt_server.h"
+#include "qt_net_worker.h"
+#include "qt_util.h"
+#include "qt_stats.h"
+#include "qt_model_pager.h"
 
-#include <QTcpServer>
-#include <QTcpSocket>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonArray>
@@ -16,7 +18,6 @@
 #include <QApplication>
 #include <QWidget>
 #include <QWindow>
-#include <windows.h>
 #include <QAbstractButton>
 #include <QLineEdit>
 #include <QComboBox>
@@ -24,13 +25,19 @@
 #include <QRadioButton>
 #include <QLabel>
 #include <QTabWidget>
+#include <QTabBar>
 #include <QListView>
 #include <QTreeView>
 #include <QTableView>
+#include <QAbstractItemView>
 #include <QFrame>
 #include <QGraphicsView>
 #include <QGraphicsScene>
 #include <QGraphicsItem>
+#include <QScrollBar>
+#include <QTransform>
+#include <QAccessible>
+#include <QMetaEnum>
 #include <QPointer>
 #include <QAction>
 #include <QPlainTextEdit>
@@ -39,38 +46,29 @@
 #include <QSpinBox>
 #include <QDoubleSpinBox>
 #include <QDateTimeEdit>
-
+#include <QEvent>
+#include <QChildEvent>
+#include <QQueue>
+#include <QRegularExpression>
+#include <QVector>
+#include <QMetaMethod>
+#include <QMetaProperty>
+#ifdef INJECTLIB_HAVE_QUICK
+#include <QQuickItem>
+#include <QQuickWindow>
+#endif
+
+#include <memory>
 #include <thread>
 #include <chrono>
 
+using injectlib::dbg;
+using injectlib::read_env_int;
+using injectlib::clamp_int;
+
 // helpers
 namespace {
 
-void dbg(const QString& s) {
-    OutputDebugStringW(reinterpret_cast<const wchar_t*>(s.utf16()));
-}
-
-int read_env_int(const wchar_t* name, int def_val) {
-    wchar_t buf[64];
-    DWORD n = GetEnvironmentVariableW(name, buf, (DWORD)(sizeof(buf) / sizeof(buf[0])));
-    if (n == 0 || n >= (DWORD)(sizeof(buf) / sizeof(buf[0])))
-        return def_val;
-    return _wtoi(buf);
-}
-
-int clamp_int(int v, int lo, int hi) {
-    if (v < lo) return lo;
-    if (v > hi) return hi;
-    return v;
-}
-
-void send_json(QTcpSocket* sock, const QJsonObject& obj) {
-    QByteArray payload = QJsonDocument(obj).toJson(QJsonDocument::Compact);
-    QByteArray frame = QByteArray::number(payload.size()) + "\n" + payload;
-    sock->write(frame);
-    sock->flush();
-}
-
 bool wait_for_gui_loop(int total_ms, int poll_ms) {
     const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(total_ms);
     while (std::chrono::steady_clock::now() < deadline) {
@@ -88,6 +86,19 @@ QJsonArray rect_to_array(const QRect& r) {
     return QJsonArray{ r.x(), r.y(), r.width(), r.height() };
 }
 
+QGraphicsView* first_view(const QGraphicsScene* sc) {
+    if (!sc) return nullptr;
+    const QList<QGraphicsView*> views = sc->views();
+    return views.isEmpty() ? nullptr : views.first();
+}
+
+// Scene -> global screen coordinates through view. Computed once per batch of items
+// instead of mapping every item through the view and its viewport separately.
+QTransform scene_to_global(const QGraphicsView* v) {
+    const QPoint origin = v->viewport()->mapToGlobal(QPoint(0, 0));
+    return v->viewportTransform() * QTransform::fromTranslate(origin.x(), origin.y());
+}
+
 QString control_type_for(QObject* obj) {
     if (!obj) return QStringLiteral("Object");
 
@@ -106,76 +117,303 @@ QString control_type_for(QObject* obj) {
     }
     if (qobject_cast<QWindow*>(obj))
         return QStringLiteral("Window");
+#ifdef INJECTLIB_HAVE_QUICK
+    if (qobject_cast<QQuickItem*>(obj))
+        return QStringLiteral("QuickItem");
+#endif
 
     return QStringLiteral("Object");
 }
 
-bool setQObjectTextOrValue(QObject* obj, const QString& text) {
-    if (!obj) return false;
+struct ChangeEventName {
+    quint32 bit;
+    const char* name;
+};
+
+const ChangeEventName kChangeEventNames[] = {
+    { QtHelloServer::ChangeShow,      "show" },
+    { QtHelloServer::ChangeHide,      "hide" },
+    { QtHelloServer::ChangeEnabled,   "enabled" },
+    { QtHelloServer::ChangeTitle,     "title" },
+    { QtHelloServer::ChangeMove,      "move" },
+    { QtHelloServer::ChangeResize,    "resize" },
+    { QtHelloServer::ChangeChildren,  "children" },
+    { QtHelloServer::ChangeDestroyed, "destroyed" },
+};
+
+quint32 parse_change_events(const QJsonValue& v, quint32 all) {
+    const QJsonArray names = v.toArray();
+    if (names.isEmpty())
+        return all;
+
+    quint32 mask = 0;
+    for (const QJsonValue& n : names) {
+        for (const ChangeEventName& e : kChangeEventNames) {
+            if (n.toString() == QLatin1String(e.name))
+                mask |= e.bit;
+        }
+    }
+    return mask;
+}
+
+QJsonArray change_events_to_array(quint32 mask) {
+    QJsonArray arr;
+    for (const ChangeEventName& e : kChangeEventNames) {
+        if (mask & e.bit)
+            arr.push_back(QLatin1String(e.name));
+    }
+    return arr;
+}
+
+// Methods that only look at a single element; they may overtake queued subtree walks.
+bool is_cheap_method(const QString& method) {
+    return method == QLatin1String("ping") ||
+           method == QLatin1String("app.info") ||
+           method == QLatin1String("elements.info") ||
+           method == QLatin1String("elements.click") ||
+           method == QLatin1String("elements.setText") ||
+           method == QLatin1String("actions.batch") ||   // validation only, actions are applied later
+           method == QLatin1String("model.info") ||
+           method == QLatin1String("model.rows") ||       // bounded by QT_INJECTED_MAX_MODEL_PAGE/_CELLS
+           method == QLatin1String("scene.itemAt") ||
+           method == QLatin1String("elements.fromPoint") ||
+           method == QLatin1String("elements.properties") || // bounded by QT_INJECTED_MAX_PROPERTY_READS
+           method == QLatin1String("session.setLimits");
+}
 
-    if (auto le = qobject_cast<QLineEdit*>(obj)) {
-        if (le->isReadOnly()) return false;
-        QMetaObject::invokeMethod(le, [le, text]() { le->setText(text); }, Qt::QueuedConnection);
+// "tree_mode": "objects" (default) or "accessible".
+QtHelloServer::TreeMode parse_tree_mode(const QJsonValue& v) {
+    return v.toString() == QLatin1String("accessible") ? QtHelloServer::TreeAccessible
+                                                        : QtHelloServer::TreeObjects;
+}
+
+// One frame of a streamed reply: the next part of the result array under key. Chunks of a
+// request go out in order, before its final response.
+QJsonObject chunk_frame(int requestId, int seq, const QString& key, const QJsonArray& items) {
+    QJsonObject result;
+    result[key] = items;
+    QJsonObject frame;
+    frame["id"] = requestId;
+    frame["chunk"] = seq;
+    frame["result"] = result;
+    return frame;
+}
+
+// Translates a "fields" request parameter into a summary field mask.
+// Absent/empty means everything, unknown names are ignored; "id" is always reported.
+quint32 parse_fields(const QJsonValue& v) {
+    const QJsonArray names = v.toArray();
+    if (names.isEmpty())
+        return QtHelloServer::FieldsAll;
+
+    quint32 mask = QtHelloServer::FieldId;
+    for (const QJsonValue& n : names) {
+        const QString f = n.toString();
+        if (f == QLatin1String("name"))              mask |= QtHelloServer::FieldName;
+        else if (f == QLatin1String("class"))        mask |= QtHelloServer::FieldClass;
+        else if (f == QLatin1String("control_type")) mask |= QtHelloServer::FieldControlType;
+        else if (f == QLatin1String("rect"))         mask |= QtHelloServer::FieldRect;
+        else if (f == QLatin1String("visible"))      mask |= QtHelloServer::FieldVisible;
+        else if (f == QLatin1String("enabled"))      mask |= QtHelloServer::FieldEnabled;
+        else if (f == QLatin1String("auto_id"))      mask |= QtHelloServer::FieldAutoId;
+        else if (f == QLatin1String("pid"))          mask |= QtHelloServer::FieldPid;
+        else if (f == QLatin1String("role"))         mask |= QtHelloServer::FieldRole;
+        else if (f == QLatin1String("value"))        mask |= QtHelloServer::FieldValue;
+        else if (f == QLatin1String("state"))        mask |= QtHelloServer::FieldState;
+    }
+    return mask;
+}
+
+// Predicates of elements.find, evaluated against (projected) element summaries.
+struct FindQuery {
+    struct Pattern {
+        QString key;               // summary key
+        bool hasExact = false;
+        QString exact;
+        bool hasRegex = false;
+        QRegularExpression regex;
+    };
+    QVector<Pattern> patterns;
+    int visible = -1;              // -1: don't care, 0/1: required state
+    int enabled = -1;
+    quint32 fields = QtHelloServer::FieldId;
+
+    bool parse(const QJsonObject& params, QString* error) {
+        static const struct { const char* key; quint32 field; } kKeys[] = {
+            { "name",         QtHelloServer::FieldName },
+            { "class",        QtHelloServer::FieldClass },
+            { "auto_id",      QtHelloServer::FieldAutoId },
+            { "control_type", QtHelloServer::FieldControlType },
+        };
+        for (const auto& k : kKeys) {
+            const QString key = QLatin1String(k.key);
+            const QJsonValue exact = params.value(key);
+            const QJsonValue re    = params.value(key + QLatin1String("_re"));
+            if (exact.isUndefined() && re.isUndefined())
+                continue;
+
+            Pattern p;
+            p.key = key;
+            if (!exact.isUndefined()) {
+                p.hasExact = true;
+                p.exact = exact.toString();
+            }
+            if (!re.isUndefined()) {
+                p.hasRegex = true;
+                p.regex = QRegularExpression(re.toString());
+                if (!p.regex.isValid()) {
+                    *error = QStringLiteral("bad %1_re: %2").arg(key, p.regex.errorString());
+                    return false;
+                }
+                p.regex.optimize();
+            }
+            patterns.push_back(p);
+            fields |= k.field;
+        }
+
+        if (params.value("visible").isBool()) {
+            visible = params.value("visible").toBool() ? 1 : 0;
+            fields |= QtHelloServer::FieldVisible;
+        }
+        if (params.value("enabled").isBool()) {
+            enabled = params.value("enabled").toBool() ? 1 : 0;
+            fields |= QtHelloServer::FieldEnabled;
+        }
         return true;
     }
 
-    if (auto pe = qobject_cast<QPlainTextEdit*>(obj)) {
-        if (pe->isReadOnly()) return false;
-        QMetaObject::invokeMethod(pe, [pe, text]() { pe->setPlainText(text); }, Qt::QueuedConnection);
+    bool matches(const QJsonObject& node) const {
+        if (visible >= 0 && node.value("visible").toBool() != (visible == 1)) return false;
+        if (enabled >= 0 && node.value("enabled").toBool() != (enabled == 1)) return false;
+        for (const Pattern& p : patterns) {
+            const QString v = node.value(p.key).toString();
+            if (p.hasExact && v != p.exact) return false;
+            if (p.hasRegex && !p.regex.match(v).hasMatch()) return false;
+        }
         return true;
     }
+};
+
+// Builds the action that writes text/value into obj, or an empty function if obj has no
+// writable text. Validation happens now; the returned action is run later on the GUI thread
+// and does nothing if obj is gone by then.
+std::function<void()> text_setter_for(QObject* obj, const QString& text) {
+    if (!obj) return {};
+
+    if (auto le = qobject_cast<QLineEdit*>(obj)) {
+        if (le->isReadOnly()) return {};
+        QPointer<QLineEdit> p(le);
+        return [p, text]() { if (p) p->setText(text); };
+    }
+
+    if (auto pe = qobject_cast<QPlainTextEdit*>(obj)) {
+        if (pe->isReadOnly()) return {};
+        QPointer<QPlainTextEdit> p(pe);
+        return [p, text]() { if (p) p->setPlainText(text); };
+    }
 
     if (auto te = qobject_cast<QTextEdit*>(obj)) {
-        if (te->isReadOnly()) return false;
-        QMetaObject::invokeMethod(te, [te, text]() { te->setPlainText(text); }, Qt::QueuedConnection);
-        return true;
+        if (te->isReadOnly()) return {};
+        QPointer<QTextEdit> p(te);
+        return [p, text]() { if (p) p->setPlainText(text); };
     }
 
     if (auto cb = qobject_cast<QComboBox*>(obj)) {
-        if (cb->isEditable())
-            QMetaObject::invokeMethod(cb, [cb, text]() { cb->setEditText(text); }, Qt::QueuedConnection);
-            return true;
+        // Editable: replaces the edit text; otherwise selects the item with that text.
+        if (!cb->isEditable() && cb->findText(text) < 0) return {};
+        QPointer<QComboBox> p(cb);
+        return [p, text]() { if (p) p->setCurrentText(text); };
     }
 
     if (auto sp = qobject_cast<QSpinBox*>(obj)) {
         bool ok = false; int v = text.toInt(&ok);
-        if (!ok) return false;
-        QMetaObject::invokeMethod(sp, [sp, v]() { sp->setValue(v); }, Qt::QueuedConnection);
-        return true;
+        if (!ok) return {};
+        QPointer<QSpinBox> p(sp);
+        return [p, v]() { if (p) p->setValue(v); };
     }
     if (auto dsp = qobject_cast<QDoubleSpinBox*>(obj)) {
         bool ok = false; double v = text.toDouble(&ok);
-        if (!ok) return false;
-        QMetaObject::invokeMethod(dsp, [dsp, v]() { dsp->setValue(v); }, Qt::QueuedConnection);
-        return true;
+        if (!ok) return {};
+        QPointer<QDoubleSpinBox> p(dsp);
+        return [p, v]() { if (p) p->setValue(v); };
     }
 
-    if (auto dt = qobject_cast<QDateTimeEdit*>(obj)) {
-        QDateTime dtv = QDateTime::fromString(text, Qt::ISODate);
-        if (!dtv.isValid()) return false;
-        QMetaObject::invokeMethod(dt, [dt, dtv]() { dt->setDateTime(dtv); }, Qt::QueuedConnection);
-        return true;
-    }
+    // QDateEdit/QTimeEdit derive from QDateTimeEdit, so they have to be checked first.
     if (auto de = qobject_cast<QDateEdit*>(obj)) {
         QDate dv = QDate::fromString(text, Qt::ISODate);
         if (!dv.isValid()) dv = QDate::fromString(text, de->displayFormat());
-        if (!dv.isValid()) return false;
-        QMetaObject::invokeMethod(de, [de, dv]() { de->setDate(dv); }, Qt::QueuedConnection);
-        return true;
+        if (!dv.isValid()) return {};
+        QPointer<QDateEdit> p(de);
+        return [p, dv]() { if (p) p->setDate(dv); };
     }
     if (auto te2 = qobject_cast<QTimeEdit*>(obj)) {
         QTime tv = QTime::fromString(text, Qt::ISODate);
         if (!tv.isValid()) tv = QTime::fromString(text, te2->displayFormat());
-        if (!tv.isValid()) return false;
-        QMetaObject::invokeMethod(te2, [te2, tv]() { te2->setTime(tv); }, Qt::QueuedConnection);
-        return true;
+        if (!tv.isValid()) return {};
+        QPointer<QTimeEdit> p(te2);
+        return [p, tv]() { if (p) p->setTime(tv); };
+    }
+    if (auto dt = qobject_cast<QDateTimeEdit*>(obj)) {
+        QDateTime dtv = QDateTime::fromString(text, Qt::ISODate);
+        if (!dtv.isValid()) return {};
+        QPointer<QDateTimeEdit> p(dt);
+        return [p, dtv]() { if (p) p->setDateTime(dtv); };
     }
+
     // Try common methods
-    if (QMetaObject::invokeMethod(obj, "setText", Qt::QueuedConnection, Q_ARG(QString, text))) return true;
+    const int idx = obj->metaObject()->indexOfMethod("setText(QString)");
+    if (idx >= 0) {
+        const QMetaMethod m = obj->metaObject()->method(idx);
+        QPointer<QObject> p(obj);
+        return [p, m, text]() { if (p) m.invoke(p.data(), Qt::DirectConnection, Q_ARG(QString, text)); };
+    }
 
-    return false;
+    return {};
+}
+
+// First of the usual "click" slots/signals of obj (click(), trigger(), clicked()), -1 if none.
+int click_method_index(QObject* obj) {
+    static const char* const kNames[] = { "click()", "trigger()", "clicked()" };
+    const QMetaObject* mo = obj->metaObject();
+    for (const char* name : kNames) {
+        const int idx = mo->indexOfMethod(name);
+        if (idx >= 0) return idx;
+    }
+    return -1;
+}
+
+// Every element id is taken: elements that still needed one were reported with id 0.
+QJsonObject table_full_error(int requestId) {
+    QJsonObject err;
+    err["code"] = -32031;
+    err["message"] = QStringLiteral("Element id table full");
+    QJsonObject resp;
+    resp["id"] = requestId;
+    resp["error"] = err;
+    return resp;
 }
 
+// Runs the prepared actions of one actions.batch in order. Normally everything happens in a
+// single pass. If an action enters a nested event loop (e.g. a click opening a modal dialog),
+// the guard posted before each pass continues with the remaining actions inside that loop
+// instead of holding them back until the dialog closes. Ids are resolved when the batch is
+// validated, so a batch can only target elements that exist at that point, not the
+// controls of a dialog it opens.
+struct BatchRun : std::enable_shared_from_this<BatchRun> {
+    QVector<std::function<void()>> actions;
+    int next = 0;
+
+    void run(QObject* context) {
+        if (next >= actions.size()) return;
+        std::shared_ptr<BatchRun> self = shared_from_this();
+        QTimer::singleShot(0, context, [self, context]() { self->run(context); });
+        while (next < actions.size()) {
+            const std::function<void()> action = actions[next++];
+            action();
+        }
+    }
+};
+
 } // namespace
 
 // ----------------- QtHelloServer -----------------
@@ -191,19 +429,20 @@ QtHelloServer* QtHelloServer::instance() {
 
 QtHelloServer::QtHelloServer(QObject* parent)
     : QObject(parent),
-      m_server(nullptr),
       m_bindAddr(QHostAddress::LocalHost),
       m_port(0)
 {
-    // QTcpServer is created in start() on the GUI thread.
+    // The network thread and its worker are created in start() on the GUI thread.
 }
 
 bool QtHelloServer::isRunning() const noexcept {
-    return (m_server && m_server->isListening());
+    return m_port != 0 || !m_localName.isEmpty();
 }
 
 quint16 QtHelloServer::port() const noexcept { return m_port; }
+QString QtHelloServer::localServerName() const noexcept { return m_localName; }
 QHostAddress QtHelloServer::bindAddress() const noexcept { return m_bindAddr; }
+QtNetWorker* QtHelloServer::netWorker() const noexcept { return m_net; }
 
 bool QtHelloServer::waitForQCoreApp(int totalMs, int pollMs) {
     // Keep this for compatibility, but bootstrap() uses wait_for_gui_loop() below.
@@ -216,8 +455,8 @@ bool QtHelloServer::waitForQCoreApp(int totalMs, int pollMs) {
 }
 
 void QtHelloServer::bootstrap() {
-    const int totalMs = read_env_int(L"QT_INJECTED_WAIT_MS", 30000); // 30s default
-    const int pollMs  = read_env_int(L"QT_INJECTED_POLL_MS", 100);   // 100ms default
+    const int totalMs = read_env_int("QT_INJECTED_WAIT_MS", 30000); // 30s default
+    const int pollMs  = read_env_int("QT_INJECTED_POLL_MS", 100);   // 100ms default
 
     if (!wait_for_gui_loop(totalMs, pollMs)) {
         dbg(QString::fromLatin1("[injectlib] GUI event loop not ready — not starting server (waited %1 ms)\n")
@@ -245,152 +484,458 @@ void QtHelloServer::shutdown() {
     }
 }
 
-// Create and start the TCP server on the GUI thread
+// Spin up the network thread and start listening there
 void QtHelloServer::start() {
     dbg(QString::fromLatin1("[injectlib] start() entered on thread %1\n")
         .arg(reinterpret_cast<qulonglong>(QThread::currentThreadId())));
 
-    if (isRunning()) {
-        dbg(QString::fromLatin1("[injectlib] Already running on %1:%2\n")
-                .arg(m_bindAddr.toString()).arg(m_port));
+    if (isRunning() || m_netThread) {
+        dbg(QString::fromLatin1("[injectlib] Already running on %1\n")
+                .arg(m_localName.isEmpty() ? QString::fromLatin1("%1:%2").arg(m_bindAddr.toString()).arg(m_port)
+                                           : m_localName));
         return;
     }
 
-    if (!m_server) {
-        m_server = new QTcpServer(this);
-        connect(m_server, &QTcpServer::newConnection,
-                this, &QtHelloServer::onNewConnection);
+    int raw = read_env_int("QT_INJECTED_SERVER_PORT", 5555);
+    quint16 requestedPort = static_cast<quint16>(clamp_int(raw, 1, 65535));
+    // "local" listens on a Unix domain socket / named pipe instead of TCP; the default
+    // name includes the PID so several injected processes don't collide.
+    const bool useLocal = qEnvironmentVariable("QT_INJECTED_TRANSPORT").compare(
+            QLatin1String("local"), Qt::CaseInsensitive) == 0;
+    QString localName = qEnvironmentVariable("QT_INJECTED_LOCAL_NAME");
+    if (localName.isEmpty())
+        localName = QString::fromLatin1("injectlib-qt-%1").arg(QCoreApplication::applicationPid());
+    m_maxBatchActions = clamp_int(read_env_int("QT_INJECTED_MAX_BATCH_ACTIONS", 1000), 1, 100000);
+    m_maxModelPage    = clamp_int(read_env_int("QT_INJECTED_MAX_MODEL_PAGE", 1000), 1, 100000);
+    m_maxModelCells   = clamp_int(read_env_int("QT_INJECTED_MAX_MODEL_CELLS", 20000), 1, 10000000);
+    m_maxScenePage    = clamp_int(read_env_int("QT_INJECTED_MAX_SCENE_PAGE", 1000), 1, 100000);
+    m_maxPropertyReads = clamp_int(read_env_int("QT_INJECTED_MAX_PROPERTY_READS", 10000), 1, 10000000);
+    m_sliceNs         = qint64(clamp_int(read_env_int("QT_INJECTED_SLICE_MS", 10), 1, 1000)) * 1000 * 1000;
+    m_sessionMaxNodes = clamp_int(read_env_int("QT_INJECTED_SESSION_MAX_NODES", 0), 0, 100000000);
+
+    m_netThread = new QThread(this);
+    m_netThread->setObjectName(QStringLiteral("injectlib-net"));
+    m_net = new QtNetWorker(this);
+    m_net->moveToThread(m_netThread);
+
+    connect(m_net, &QtNetWorker::listening, this, [this](quint16 port) {
+        m_port = port;
+        dbg(QString::fromLatin1("[injectlib] Server started on %1:%2\n")
+                .arg(m_bindAddr.toString()).arg(m_port));
+        emit started(m_port);
+    });
+    connect(m_net, &QtNetWorker::listeningLocal, this, [this](const QString& fullName) {
+        m_localName = fullName;
+        dbg(QString::fromLatin1("[injectlib] Server started on local socket %1\n").arg(m_localName));
+        emit startedLocal(m_localName);
+    });
+    connect(m_net, &QtNetWorker::listenFailed, this,
+            [this, requestedPort, useLocal, localName](const QString& err) {
+        const QString where = useLocal ? localName
+                                       : QString::fromLatin1("%1:%2").arg(m_bindAddr.toString()).arg(requestedPort);
+        INJECTLIB_LOG(injectlib::LogError, QString::fromLatin1("[injectlib] listen(%1) FAILED: %2\n")
+                .arg(where, err));
+        stopNetThread();
+    });
+
+    m_netThread->start();
+
+    QtNetWorker* net = m_net;
+    if (useLocal) {
+        QMetaObject::invokeMethod(net, [net, localName]() { net->listenLocal(localName); },
+                                  Qt::QueuedConnection);
+    } else {
+        const QHostAddress addr = m_bindAddr;
+        QMetaObject::invokeMethod(net, [net, addr, requestedPort]() { net->listen(addr, requestedPort); },
+                                  Qt::QueuedConnection);
     }
+}
 
-    int raw = read_env_int(L"QT_INJECTED_SERVER_PORT", 5555);
-    quint16 requestedPort = static_cast<quint16>(clamp_int(raw, 1, 65535));
+void QtHelloServer::stop() {
+    if (!m_netThread)
+        return;
+
+    stopNetThread();
+    dbg(QString::fromLatin1("[injectlib] Server stopped.\n"));
+    emit stopped();
+}
 
-    if (!m_server->listen(m_bindAddr, requestedPort)) {
-        const QString err = m_server->errorString();
-        dbg(QString::fromLatin1("[injectlib] listen(%1:%2) FAILED: %3\n")
-                .arg(m_bindAddr.toString()).arg(requestedPort).arg(err));
-        m_port = 0;
+void QtHelloServer::stopNetThread() {
+    if (!m_netThread)
         return;
+
+    // Close the sockets on their own thread, then let that thread's event loop exit.
+    QtNetWorker* net = m_net;
+    QMetaObject::invokeMethod(net, [net]() {
+        net->close();
+        QThread::currentThread()->quit();
+    }, Qt::QueuedConnection);
+    m_netThread->wait();
+
+    delete m_net;
+    m_net = nullptr;
+    delete m_netThread;
+    m_netThread = nullptr;
+    m_port = 0;
+    m_localName.clear();
+
+    // No connection survives the network thread.
+    for (auto it = m_subs.constBegin(); it != m_subs.constEnd(); ++it)
+        unwatchAll(it.key());
+    m_subs.clear();
+    const QList<quint64> shadowed = m_shadows.keys();
+    for (quint64 conn : shadowed)
+        dropShadow(conn);
+    const QList<quint64> sessions = m_sessions.keys();
+    for (quint64 conn : sessions)
+        dropSession(conn);
+}
+
+// ----------------- request scheduling -----------------
+
+/// Per-connection state on the GUI thread.
+struct QtHelloServer::Session {
+    QList<PendingRequest> fast;
+    QList<PendingRequest> bulk;
+
+    // bulk request being handled in slices (see makeJob)
+    PendingRequest jobRequest;
+    RequestJob job;
+    qint64 jobWaitNs = 0;
+    qint64 jobBusyNs = 0;
+    int jobSlices = 0;
+
+    int maxNodes = 0; // session.setLimits; caps elements.tree/find walks, 0 = unlimited
+
+    // Parsed elements.find queries by their parameters, so a client polling with the same
+    // regexes doesn't recompile them on every call.
+    QHash<QString, std::shared_ptr<const FindQuery>> queries;
+};
+
+QtHelloServer::Session& QtHelloServer::session(quint64 conn) {
+    std::shared_ptr<Session>& s = m_sessions[conn];
+    if (!s) {
+        s = std::make_shared<Session>();
+        s->maxNodes = m_sessionMaxNodes;
     }
+    return *s;
+}
 
-    m_port = m_server->serverPort();
-    dbg(QString::fromLatin1("[injectlib] Server started on %1:%2 (thread %3)\n")
-            .arg(m_bindAddr.toString()).arg(m_port)
-            .arg(reinterpret_cast<qulonglong>(QThread::currentThreadId())));
-    emit started(m_port);
+void QtHelloServer::submit(const PendingRequest& pending) {
+    injectlib::server_stats().guiQueued.fetch_add(1, std::memory_order_relaxed);
+    Session& s = session(pending.conn);
+    const QString method = pending.req.value("method").toString();
+    if (is_cheap_method(method)) {
+        if (s.fast.isEmpty())
+            m_fastTurn.push_back(pending.conn);
+        s.fast.push_back(pending);
+    } else {
+        if (s.bulk.isEmpty() && !s.job)
+            m_bulkTurn.push_back(pending.conn);
+        s.bulk.push_back(pending);
+    }
+    scheduleDrain();
 }
 
-void QtHelloServer::stop() {
-    if (!m_server || !m_server->isListening())
+void QtHelloServer::scheduleDrain() {
+    if (m_drainScheduled) return;
+    m_drainScheduled = true;
+    QMetaObject::invokeMethod(this, [this]() { drainRequests(); }, Qt::QueuedConnection);
+}
+
+void QtHelloServer::drainRequests() {
+    m_drainScheduled = false;
+
+    // Cheap requests: one per session per round until every fast queue is empty.
+    while (!m_fastTurn.isEmpty()) {
+        const quint64 conn = m_fastTurn.takeFirst();
+        const auto it = m_sessions.constFind(conn);
+        if (it == m_sessions.constEnd() || (*it)->fast.isEmpty()) continue;
+        const PendingRequest pending = (*it)->fast.takeFirst();
+        if (!(*it)->fast.isEmpty())
+            m_fastTurn.push_back(conn);
+        runRequest(pending);
+    }
+
+    // At most one bulk slice per pass, then back to the event loop so that requests
+    // which arrived meanwhile get in before the next one.
+    if (!m_bulkTurn.isEmpty())
+        runBulkSlice(m_bulkTurn.takeFirst());
+
+    if (!m_fastTurn.isEmpty() || !m_bulkTurn.isEmpty())
+        scheduleDrain();
+}
+
+void QtHelloServer::runBulkSlice(quint64 conn) {
+    const std::shared_ptr<Session> s = m_sessions.value(conn);
+    if (!s) return;
+
+    if (!s->job) {
+        if (s->bulk.isEmpty()) return;
+        const PendingRequest pending = s->bulk.takeFirst();
+        RequestJob job = makeJob(pending);
+        if (!job) {
+            if (!s->bulk.isEmpty())
+                m_bulkTurn.push_back(conn);
+            runRequest(pending);
+            return;
+        }
+        injectlib::server_stats().guiQueued.fetch_sub(1, std::memory_order_relaxed);
+        s->jobRequest = pending;
+        s->job = std::move(job);
+        s->jobWaitNs = pending.queued.nsecsElapsed();
+        s->jobBusyNs = 0;
+        s->jobSlices = 0;
+    }
+
+    QElapsedTimer busy;
+    busy.start();
+    QJsonObject resp;
+    // The application ran since the previous slice.
+    m_ids.newPass();
+    m_ids.takeOverflow();
+    bool done = s->job(m_sliceNs, resp);
+    if (m_ids.takeOverflow()) {
+        resp = table_full_error(s->jobRequest.req.value("id").toInt(-1));
+        done = true;
+    }
+    s->jobBusyNs += busy.nsecsElapsed();
+    ++s->jobSlices;
+
+    if (!done) {
+        m_bulkTurn.push_back(conn);
         return;
+    }
 
-    m_server->close();
-    m_port = 0;
-    dbg(QString::fromLatin1("[injectlib] Server stopped.\n"));
-    emit stopped();
+    const PendingRequest pending = s->jobRequest;
+    s->job = RequestJob();
+    s->jobRequest = PendingRequest();
+    if (!s->bulk.isEmpty())
+        m_bulkTurn.push_back(conn);
+    completeRequest(pending, resp, s->jobWaitNs, s->jobBusyNs, s->jobSlices);
 }
 
-void QtHelloServer::onNewConnection() {
-    while (m_server->hasPendingConnections()) {
-        QTcpSocket* c = m_server->nextPendingConnection();
+void QtHelloServer::runRequest(const PendingRequest& pending) {
+    const qint64 waitNs = pending.queued.nsecsElapsed();
+    QElapsedTimer busy;
+    busy.start();
 
-        dbg(QString::fromLatin1("[injectlib] New connection (sock=%1)\n")
-                .arg(reinterpret_cast<qulonglong>(c)));
+    injectlib::server_stats().guiQueued.fetch_sub(1, std::memory_order_relaxed);
 
-        connect(c, &QTcpSocket::disconnected, c, &QObject::deleteLater);
+    QJsonObject resp = handleRequest(pending);
+    completeRequest(pending, resp, waitNs, busy.nsecsElapsed(), 1);
+}
 
-        // Reply when data arrives
-        connect(c, &QTcpSocket::readyRead, this, [this, c]() {
-            while (c->canReadLine()) {
-                // Read length prefix line
-                QByteArray lenLine = c->readLine().trimmed();
-                bool ok = false;
-                int length = lenLine.toInt(&ok);
-                if (!ok || length <= 0) {
-                    dbg(QString::fromLatin1("[injectlib] Invalid frame length: '%1'\n").arg(QString::fromLatin1(lenLine)));
-                    c->disconnectFromHost();
-                    return;
-                }
+void QtHelloServer::completeRequest(const PendingRequest& pending, QJsonObject& resp,
+                                    qint64 waitNs, qint64 busyNs, int slices) {
+    injectlib::ServerStats& stats = injectlib::server_stats();
+    stats.record(pending.statSlot, injectlib::ServerStats::StageQueue, waitNs);
+    stats.record(pending.statSlot, injectlib::ServerStats::StageHandle, busyNs);
+
+    if (pending.req.value("timing").toBool(false)) {
+        QJsonObject t;
+        t["queue_us"] = static_cast<qint64>(waitNs / 1000);
+        t["gui_us"]   = static_cast<qint64>(busyNs / 1000);
+        t["slices"]   = slices;
+        resp["timing"] = t;
+    }
 
-                // Read payload of declared length
-                QByteArray payload = c->read(length);
+    pending.reply(resp);
+}
 
-                // Parse JSON
-                QJsonParseError parseError;
-                QJsonDocument doc = QJsonDocument::fromJson(payload, &parseError);
-                if (parseError.error != QJsonParseError::NoError || !doc.isObject()) {
-                    dbg(QString::fromLatin1("[injectlib] Invalid JSON: %1\n").arg(parseError.errorString()));
-                    c->disconnectFromHost();
-                    return;
-                }
+QtHelloServer::RequestJob QtHelloServer::makeJob(const PendingRequest& pending) {
+    const QString method = pending.req.value("method").toString();
+    const QJsonObject params = pending.req.value("params").toObject();
+    const int reqId = pending.req.value("id").toInt(-1);
+    Session& s = session(pending.conn);
 
-                QJsonObject req = doc.object();
-                int reqId = req.value("id").toInt(-1);
-                QString method = req.value("method").toString();
-
-                dbg(QString::fromLatin1("[injectlib] Request: id=%1, method=%2\n").arg(reqId).arg(method));
-
-                if (method == "ping") {
-                    handlePing(c, reqId);
-                } else if (method == "app.info") {
-                    handleAppInfo(c, reqId);
-                } else if (method == "elements.roots") {
-                    handleElementsRoots(c, reqId);
-                } else if (method == "elements.children") {
-                    // Expect: { "id": X, "method": "elements.children", "params": { "id": <parentId> } }
-                    const QJsonObject params = req.value("params").toObject();
-                    const int parentId = params.value("id").toInt(0);
-                    handleElementsChildren(c, reqId, parentId);
-                } else if (method == "elements.info") {
-                    // Expect: { "id": X, "method": "elements.info", "params": { "id": <int> } }
-                    const QJsonObject params = req.value("params").toObject();
-                    const int targetId = params.value("id").toInt(0);
-                    handleElementInfo(c, reqId, targetId);
-                } else if (method == "elements.click") {
-                    // Expect: { "id": X, "method": "elements.click", "params": { "id": <int> } }
-                    const QJsonObject params = req.value("params").toObject();
-                    const int targetId = params.value("id").toInt(0);
-                    handleElementClick(c, reqId, targetId);
-                } else if (method == "elements.setText") {
-                    // Expect: { "id": X, "method": "elements.setText", "params": { "id": <int>, "text": "string" } }
-                    const QJsonObject params = req.value("params").toObject();
-                    const int targetId = params.value("id").toInt(0);
-                    const QString text  = params.value("text").toString();
-                    handleElementSetText(c, reqId, targetId, text);
-                } else {
-                    QJsonObject error;
-                    error["error"] = QStringLiteral("Unknown method");
-                    QJsonObject resp;
-                    resp["id"] = reqId;
-                    resp["result"] = error;
-                    send_json(c, resp);
-                }
-            }
-        });
+    StreamSink stream;
+    if (pending.req.value("stream").toBool(false)) {
+        stream.push = pending.push;
+        stream.chunkSize = clamp_int(params.value("chunk_size").toInt(500), 1, 100000);
     }
+
+    if (method == QLatin1String("elements.tree")) {
+        TreeOptions opts = parseTreeOptions(params);
+        if (s.maxNodes > 0 && (opts.maxNodes <= 0 || opts.maxNodes > s.maxNodes))
+            opts.maxNodes = s.maxNodes;
+        return treeJob(reqId, opts, stream);
+    }
+    if (method == QLatin1String("elements.find"))
+        return findJob(reqId, params, &s, s.maxNodes, stream);
+    if (method == QLatin1String("elements.roots") || method == QLatin1String("elements.children")) {
+        const bool roots = method == QLatin1String("elements.roots");
+        return childrenJob(reqId, roots ? 0 : params.value("id").toInt(0), roots,
+                           parse_fields(params.value("fields")), parse_tree_mode(params.value("tree_mode")));
+    }
+    if (method == QLatin1String("elements.treeDelta"))
+        return treeDeltaJob(pending.conn, reqId, params);
+    if (method == QLatin1String("scene.items"))
+        return sceneItemsJob(reqId, params);
+    return RequestJob();
+}
+
+QJsonObject QtHelloServer::runToEnd(const PendingRequest& pending) {
+    // submit() slices these; called directly, the same job just runs in one go.
+    QJsonObject resp;
+    makeJob(pending)(0, resp);
+    return resp;
+}
+
+void QtHelloServer::dropSession(quint64 conn) {
+    const std::shared_ptr<Session> s = m_sessions.take(conn);
+    if (!s) return;
+    // Nobody is left to answer; a job in progress was already taken off the queue count.
+    injectlib::server_stats().guiQueued.fetch_sub(s->fast.size() + s->bulk.size(), std::memory_order_relaxed);
+    m_fastTurn.removeAll(conn);
+    m_bulkTurn.removeAll(conn);
+}
+
+QJsonObject QtHelloServer::handleSessionLimits(const PendingRequest& pending, int requestId, const QJsonObject& params) {
+    Session& s = session(pending.conn);
+    if (params.contains("max_nodes"))
+        s.maxNodes = qMax(0, params.value("max_nodes").toInt(0));
+
+    QJsonObject result;
+    result["max_nodes"] = s.maxNodes;
+    QJsonObject resp;
+    resp["id"] = requestId;
+    resp["result"] = result;
+    return resp;
+}
+
+QJsonObject QtHelloServer::handleRequest(const PendingRequest& pending) {
+    // Ids of plain graphics items are checked against their scene again, once per request.
+    m_ids.newPass();
+    m_ids.takeOverflow();
+    QJsonObject resp = dispatchRequest(pending);
+    if (m_ids.takeOverflow())
+        resp = table_full_error(pending.req.value("id").toInt(-1));
+    return resp;
 }
 
-void QtHelloServer::sendJson(QTcpSocket* sock, const QJsonObject& obj) {
-    QByteArray payload = QJsonDocument(obj).toJson(QJsonDocument::Compact);
-    QByteArray frame = QByteArray::number(payload.size()) + "\n" + payload;
-    sock->write(frame);
-    sock->flush();
+QJsonObject QtHelloServer::dispatchRequest(const PendingRequest& pending) {
+    const QJsonObject& req = pending.req;
+    const int reqId = req.value("id").toInt(-1);
+    const QString method = req.value("method").toString();
+    const QJsonObject params = req.value("params").toObject();
+
+    if (method == "ping") {
+        return handlePing(reqId);
+    } else if (method == "app.info") {
+        return handleAppInfo(reqId);
+    } else if (method == "elements.roots") {
+        // Expect: { "id": X, "method": "elements.roots",
+        //           "params": { "fields": [...], "tree_mode": "objects" | "accessible" } }
+        // ("tree_mode" is accepted by elements.roots/children/tree/find/info)
+        return runToEnd(pending);
+    } else if (method == "elements.children") {
+        // Expect: { "id": X, "method": "elements.children", "params": { "id": <parentId>, "fields": [...] } }
+        return runToEnd(pending);
+    } else if (method == "elements.tree") {
+        // Expect: { "id": X, "method": "elements.tree",
+        //           "params": { "id": <rootId, 0 = all roots>, "max_depth": <int>,
+        //                       "max_nodes": <int>, "fields": ["name", "class", ...] } }
+        // With "stream": true next to "params" (and "chunk_size" in params), nodes arrive in
+        // { "id": X, "chunk": <seq>, "result": { "nodes": [...] } } frames before the final
+        // response, which holds the remaining nodes and "chunks". Same for elements.find "matches".
+        return runToEnd(pending);
+    } else if (method == "elements.treeDelta") {
+        // Expect: { "id": X, "method": "elements.treeDelta",
+        //           "params": { "id": <rootId, 0 = all roots>, "since": <version from the last delta>,
+        //                       "max_depth": <int>, "fields": [...] } }
+        return runToEnd(pending);
+    } else if (method == "elements.find") {
+        // Expect: { "id": X, "method": "elements.find",
+        //           "params": { "id": <rootId, 0 = all roots>, "name" | "name_re": <string>,
+        //                       "class" | "class_re", "auto_id" | "auto_id_re",
+        //                       "control_type" | "control_type_re", "visible": <bool>,
+        //                       "enabled": <bool>, "max_depth": <int>, "max_results": <int>,
+        //                       "fields": [...] } }
+        return runToEnd(pending);
+    } else if (method == "elements.info") {
+        // Expect: { "id": X, "method": "elements.info", "params": { "id": <int>, "fields": [...] } }
+        const int targetId = params.value("id").toInt(0);
+        return handleElementInfo(reqId, targetId, parse_fields(params.value("fields")),
+                                 parse_tree_mode(params.value("tree_mode")));
+    } else if (method == "elements.fromPoint") {
+        // Expect: { "id": X, "method": "elements.fromPoint", "params": { "point": [x, y], "fields": [...] } }
+        return handleElementFromPoint(reqId, params);
+    } else if (method == "elements.properties") {
+        // Expect: { "id": X, "method": "elements.properties",
+        //           "params": { "ids": [<int>, ...], "properties": ["text", "x", "color", ...] } }
+        return handleElementProperties(reqId, params);
+    } else if (method == "elements.click") {
+        // Expect: { "id": X, "method": "elements.click", "params": { "id": <int> } }
+        const int targetId = params.value("id").toInt(0);
+        return handleElementClick(reqId, targetId);
+    } else if (method == "elements.setText") {
+        // Expect: { "id": X, "method": "elements.setText", "params": { "id": <int>, "text": "string" } }
+        const int targetId = params.value("id").toInt(0);
+        const QString text  = params.value("text").toString();
+        return handleElementSetText(reqId, targetId, text);
+    } else if (method == "actions.batch") {
+        // Expect: { "id": X, "method": "actions.batch",
+        //           "params": { "actions": [ { "action": "click", "id": <int> },
+        //                                    { "action": "setText", "id": <int>, "text": "string" }, ... ],
+        //                       "stop_on_error": <bool> } }
+        return handleActionsBatch(reqId, params);
+    } else if (method == "model.info") {
+        // Expect: { "id": X, "method": "model.info",
+        //           "params": { "id": <item view id>, "parent": [<row>, ...] } }
+        return handleModelInfo(reqId, params);
+    } else if (method == "model.rows") {
+        // Expect: { "id": X, "method": "model.rows",
+        //           "params": { "id": <item view id>, "parent": [<row>, ...], "row": <int>, "count": <int>,
+        //                       "column": <int>, "columns": <int>, "fields": ["text", "selected", "rect", "checked"] } }
+        return handleModelRows(reqId, params);
+    } else if (method == "scene.items") {
+        // Expect: { "id": X, "method": "scene.items",
+        //           "params": { "id": <graphics view id>, "rect": [x, y, w, h] | "point": [x, y],
+        //                       "coords": "screen" | "scene", "mode": "intersects" | "contains",
+        //                       "top_level": <bool>, "offset": <int>, "limit": <int>, "fields": [...] } }
+        return runToEnd(pending);
+    } else if (method == "scene.itemAt") {
+        // Expect: { "id": X, "method": "scene.itemAt",
+        //           "params": { "id": <graphics view id>, "point": [x, y], "coords": "screen" | "scene",
+        //                       "fields": [...] } }
+        return handleSceneItemAt(reqId, params);
+    } else if (method == "elements.subscribe") {
+        // Expect: { "id": X, "method": "elements.subscribe",
+        //           "params": { "ids": [<int>, ...], "subtree": <bool>,
+        //                       "events": ["show", "hide", ...], "fields": [...] } }
+        return handleSubscribe(pending, reqId, params);
+    } else if (method == "elements.unsubscribe") {
+        // Expect: { "id": X, "method": "elements.unsubscribe", "params": { "subscription": <int> } }
+        return handleUnsubscribe(pending, reqId, params.value("subscription").toInt(0));
+    } else if (method == "session.setLimits") {
+        // Expect: { "id": X, "method": "session.setLimits", "params": { "max_nodes": <int, 0 = unlimited> } }
+        return handleSessionLimits(pending, reqId, params);
+    }
+
+    QJsonObject error;
+    error["error"] = QStringLiteral("Unknown method");
+    QJsonObject resp;
+    resp["id"] = reqId;
+    resp["result"] = error;
+    return resp;
 }
 
-void QtHelloServer::handlePing(QTcpSocket* sock, int requestId) {
+QJsonObject QtHelloServer::handlePing(int requestId) {
     QJsonObject result;
     result["ok"] = true;
     result["pid"] = QCoreApplication::applicationPid();
     result["qt_version"] = QString::fromLatin1(qVersion());
+    // Wire formats accepted by session.setEncoding
+    result["encodings"] = QJsonArray{ QStringLiteral("json"), QStringLiteral("cbor") };
 
     QJsonObject response;
     response["id"] = requestId;
     response["result"] = result;
-
-    send_json(sock, response);
+    return response;
 }
 
-void QtHelloServer::handleAppInfo(QTcpSocket* sock, int requestId) {
+QJsonObject QtHelloServer::handleAppInfo(int requestId) {
     QJsonObject result;
 
     // Basic app/process info
@@ -425,191 +970,227 @@ void QtHelloServer::handleAppInfo(QTcpSocket* sock, int requestId) {
     QJsonObject resp;
     resp["id"]     = requestId;
     resp["result"] = result;
-
-    sendJson(sock, resp);
+    return resp;
 }
 
 int QtHelloServer::ensureIdFor(QObject* obj) {
-    if (!obj) return 0;
-    if (m_obj2id.contains(obj)) return m_obj2id.value(obj);
-
-    const int id = m_nextId++;
-    m_obj2id.insert(obj, id);
-    m_id2obj.insert(id, QPointer<QObject>(obj));
-
-    // Auto-drop when the QObject is destroyed
-    connect(obj, &QObject::destroyed, this, [this, obj]() { dropIdFor(obj); });
-    return id;
+    // Unwatched objects are not connected to: their slots are reclaimed lazily by the table.
+    return m_ids.idForObject(obj);
 }
 
-void QtHelloServer::dropIdFor(QObject* obj) {
-    if (!obj) return;
-    auto it = m_obj2id.find(obj);
-    if (it == m_obj2id.end()) return;
-    const int id = it.value();
-    m_obj2id.erase(it);
-    m_id2obj.remove(id);
+void QtHelloServer::dropIdFor(QObject* obj, int id) {
+    // Called from QObject::destroyed of watched objects. The table's QPointer is already
+    // cleared at that point, so the id is captured by the caller when it starts watching.
+    if (m_watched.contains(obj))
+        noteChange(obj, id, ChangeDestroyed);
+    m_ids.release(id);
 }
 
-QJsonObject QtHelloServer::summarizeTopLevel(QObject* obj) {
+QJsonObject QtHelloServer::summarizeTopLevel(QObject* obj, quint32 fields) {
     QJsonObject j;
     if (!obj) return j;
 
     if (QWidget* w = qobject_cast<QWidget*>(obj)) {
-        const int id = ensureIdFor(w);
-        const QRect fr = w->frameGeometry();
-        j["id"]           = id;
-        j["name"]         = w->windowTitle();
-        j["class"]        = w->metaObject()->className();
-        j["control_type"] = control_type_for(w);
-        j["rect"]         = rect_to_array(fr);
-        j["visible"]      = w->isVisible();
-        j["enabled"]      = w->isEnabled();
-        j["auto_id"] = w->objectName(); 
-        j["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+        j["id"] = ensureIdFor(w);
+        if (fields & FieldName)        j["name"]         = w->windowTitle();
+        if (fields & FieldClass)       j["class"]        = w->metaObject()->className();
+        if (fields & FieldControlType) j["control_type"] = control_type_for(w);
+        if (fields & FieldRect)        j["rect"]         = rect_to_array(w->frameGeometry());
+        if (fields & FieldVisible)     j["visible"]      = w->isVisible();
+        if (fields & FieldEnabled)     j["enabled"]      = w->isEnabled();
+        if (fields & FieldAutoId)      j["auto_id"]      = w->objectName();
+        if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
         return j;
     }
 
     if (QWindow* win = qobject_cast<QWindow*>(obj)) {
-        const int id = ensureIdFor(win);
-        const QRect fr = win->frameGeometry();
-        j["id"]           = id;
-        j["name"]         = win->title();
-        j["class"]        = win->metaObject()->className();
-        j["control_type"] = control_type_for(win);
-        j["rect"]         = rect_to_array(fr);
-        j["visible"]      = win->isVisible();
-        j["enabled"]      = true; // QWindow has no enabled; treat as always enabled
-        j["auto_id"] = win->objectName();
-        j["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+        j["id"] = ensureIdFor(win);
+        if (fields & FieldName)        j["name"]         = win->title();
+        if (fields & FieldClass)       j["class"]        = win->metaObject()->className();
+        if (fields & FieldControlType) j["control_type"] = control_type_for(win);
+        if (fields & FieldRect)        j["rect"]         = rect_to_array(win->frameGeometry());
+        if (fields & FieldVisible)     j["visible"]      = win->isVisible();
+        if (fields & FieldEnabled)     j["enabled"]      = true; // QWindow has no enabled; treat as always enabled
+        if (fields & FieldAutoId)      j["auto_id"]      = win->objectName();
+        if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
         return j;
     }
 
     // Fallback (unknown top-level type)
-    const int id = ensureIdFor(obj);
-    j["id"]           = id;
-    j["name"]         = QString(); // unknown
-    j["class"]        = obj->metaObject()->className();
-    j["control_type"] = control_type_for(obj);
-    j["rect"]         = rect_to_array(QRect());
-    j["visible"]      = true;
-    j["enabled"]      = true;
-    j["auto_id"] = obj->objectName();
-    j["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+    j["id"] = ensureIdFor(obj);
+    if (fields & FieldName)        j["name"]         = QString(); // unknown
+    if (fields & FieldClass)       j["class"]        = obj->metaObject()->className();
+    if (fields & FieldControlType) j["control_type"] = control_type_for(obj);
+    if (fields & FieldRect)        j["rect"]         = rect_to_array(QRect());
+    if (fields & FieldVisible)     j["visible"]      = true;
+    if (fields & FieldEnabled)     j["enabled"]      = true;
+    if (fields & FieldAutoId)      j["auto_id"]      = obj->objectName();
+    if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
     return j;
 }
 
-void QtHelloServer::handleElementsRoots(QTcpSocket* sock, int requestId) {
-    QJsonArray arr;
+void QtHelloServer::collectRootIds(QVector<int>& out, TreeMode mode) {
+    if (mode == TreeAccessible) {
+        // The application's interface has the top-level windows as children.
+        QAccessibleInterface* app = QAccessible::queryAccessibleInterface(QCoreApplication::instance());
+        if (!app) return;
+        const int n = app->childCount();
+        for (int i = 0; i < n; ++i) {
+            QAccessibleInterface* ch = app->child(i);
+            if (ch && ch->isValid())
+                out.push_back(ensureIdForAccessible(ch));
+        }
+        return;
+    }
 
     // QWidget top-levels
     const auto widgetRoots = QApplication::topLevelWidgets();
     for (QWidget* w : widgetRoots) {
         if (!w) continue;
-        arr.push_back(summarizeTopLevel(w));
+        out.push_back(ensureIdFor(w));
     }
 
     // QWindow top-levels
     const auto windowRoots = QGuiApplication::topLevelWindows();
     for (QWindow* win : windowRoots) {
         if (!win) continue;
-        arr.push_back(summarizeTopLevel(win));
+        out.push_back(ensureIdFor(win));
     }
-
-    QJsonObject resp;
-    resp["id"]     = requestId;
-    resp["result"] = arr;
-    sendJson(sock, resp);
 }
 
-QObject* QtHelloServer::objectForId(int id) const {
-    if (id <= 0) return NULL;
-    QPointer<QObject> ptr = m_id2obj.value(id);
-    return ptr ? ptr.data() : NULL;
+QObject* QtHelloServer::objectForId(int id) {
+    return m_ids.object(id);
 }
 
-QJsonObject QtHelloServer::summarizeObject(QObject* obj) {
+QJsonObject QtHelloServer::summarizeObject(QObject* obj, quint32 fields) {
     QJsonObject j;
     if (!obj) return j;
 
     if (QWidget* w = qobject_cast<QWidget*>(obj)) {
-        const int id = ensureIdFor(static_cast<QObject*>(w));
-
-        // Global rectangle
-        const QPoint topLeft = w->mapToGlobal(QPoint(0, 0));
-        const QSize  sz      = w->size();
-        const QRect  gr(topLeft, sz);
-
-        // title/text
-        QString name = w->windowTitle();
-        if (name.isEmpty()) {
-            // If don't have windowTitle, use accessibleName or objectName as a fallback
-            name = w->accessibleName();
-            if (name.isEmpty())
-                name = w->objectName();
-        }
-
-        j["id"]           = id;
-        j["name"]         = name;
-        j["class"]        = w->metaObject()->className();
-        j["control_type"] = control_type_for(w);
-        j["rect"]         = rect_to_array(gr);
-        j["visible"]      = w->isVisible();
-        j["enabled"]      = w->isEnabled();
-        j["auto_id"] = w->objectName();
-        j["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+        j["id"] = ensureIdFor(static_cast<QObject*>(w));
+
+        if (fields & FieldName) {
+            // title/text
+            QString name = w->windowTitle();
+            if (name.isEmpty()) {
+                // If don't have windowTitle, use accessibleName or objectName as a fallback
+                name = w->accessibleName();
+                if (name.isEmpty())
+                    name = w->objectName();
+            }
+            j["name"] = name;
+        }
+        if (fields & FieldClass)       j["class"]        = w->metaObject()->className();
+        if (fields & FieldControlType) j["control_type"] = control_type_for(w);
+        if (fields & FieldRect) {
+            // Global rectangle
+            const QPoint topLeft = w->mapToGlobal(QPoint(0, 0));
+            j["rect"] = rect_to_array(QRect(topLeft, w->size()));
+        }
+        if (fields & FieldVisible)     j["visible"]      = w->isVisible();
+        if (fields & FieldEnabled)     j["enabled"]      = w->isEnabled();
+        if (fields & FieldAutoId)      j["auto_id"]      = w->objectName();
+        if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
         return j;
     }
 
     if (QWindow* win = qobject_cast<QWindow*>(obj)) {
-        const int id = ensureIdFor(static_cast<QObject*>(win));
-        const QRect fr = win->frameGeometry();
-        j["id"] = id;
-        j["name"] = win->title();
-        j["class"] = win->metaObject()->className();
-        j["control_type"] = control_type_for(win); 
-        j["rect"] = rect_to_array(fr);
-        j["visible"] = win->isVisible();
-        j["enabled"] = true;
-        j["auto_id"] = win->objectName();
-        j["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+        j["id"] = ensureIdFor(static_cast<QObject*>(win));
+        if (fields & FieldName)        j["name"]         = win->title();
+        if (fields & FieldClass)       j["class"]        = win->metaObject()->className();
+        if (fields & FieldControlType) j["control_type"] = control_type_for(win);
+        if (fields & FieldRect)        j["rect"]         = rect_to_array(win->frameGeometry());
+        if (fields & FieldVisible)     j["visible"]      = win->isVisible();
+        if (fields & FieldEnabled)     j["enabled"]      = true;
+        if (fields & FieldAutoId)      j["auto_id"]      = win->objectName();
+        if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
         return j;
     }
 
+#ifdef INJECTLIB_HAVE_QUICK
+    if (QQuickItem* qi = qobject_cast<QQuickItem*>(obj))
+        return summarizeQuickItem(qi, fields);
+#endif
+
     // Fallback for unknown object types
-    const int id = ensureIdFor(obj);
-    j["id"]           = id;
-    j["name"]         = obj->objectName();
-    j["class"]        = obj->metaObject()->className();
-    j["control_type"] = control_type_for(obj);
-    j["rect"]         = rect_to_array(QRect());
-    j["visible"]      = true;
-    j["enabled"]      = true;
-    j["pid"] = static_cast<qint64>(QCoreApplication::applicationPid());
+    j["id"] = ensureIdFor(obj);
+    if (fields & FieldName)        j["name"]         = obj->objectName();
+    if (fields & FieldClass)       j["class"]        = obj->metaObject()->className();
+    if (fields & FieldControlType) j["control_type"] = control_type_for(obj);
+    if (fields & FieldRect)        j["rect"]         = rect_to_array(QRect());
+    if (fields & FieldVisible)     j["visible"]      = true;
+    if (fields & FieldEnabled)     j["enabled"]      = true;
+    if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
     return j;
 }
 
-void QtHelloServer::handleElementsChildren(QTcpSocket* sock, int requestId, int parentId) {
-    QJsonArray out;
+#ifdef INJECTLIB_HAVE_QUICK
+QJsonObject QtHelloServer::summarizeQuickItem(QQuickItem* qi, quint32 fields) {
+    QJsonObject j;
+    if (!qi) return j;
+
+    j["id"] = ensureIdFor(static_cast<QObject*>(qi));
+    if (fields & FieldName) {
+        // Text, Button, Label, ... expose a "text" property; resolved once per QML type.
+        QString name;
+        const int textIndex = m_props.indexOf(qi, QByteArrayLiteral("text"));
+        if (textIndex >= 0)
+            name = qi->metaObject()->property(textIndex).read(qi).toString();
+        if (name.isEmpty())
+            name = qi->objectName();
+        j["name"] = name;
+    }
+    if (fields & FieldClass)       j["class"]        = qi->metaObject()->className();
+    if (fields & FieldControlType) j["control_type"] = control_type_for(qi);
+    if (fields & FieldRect) {
+        // Scene (window) coordinates, then through the window to the screen.
+        QRectF r = qi->mapRectToScene(QRectF(0, 0, qi->width(), qi->height()));
+        if (QQuickWindow* win = qi->window())
+            r.translate(win->mapToGlobal(QPoint(0, 0)));
+        j["rect"] = rect_to_array(r.toAlignedRect());
+    }
+    if (fields & FieldVisible)     j["visible"]      = qi->isVisible();
+    if (fields & FieldEnabled)     j["enabled"]      = qi->isEnabled();
+    if (fields & FieldAutoId)      j["auto_id"]      = qi->objectName();
+    if (fields & FieldPid)         j["pid"]          = static_cast<qint64>(QCoreApplication::applicationPid());
+    return j;
+}
+#endif
+
+QtHelloServer::TreeMode QtHelloServer::childMode(int parentId, TreeMode mode) {
+    // Object-less accessible elements (cells, ...) only have accessible children.
+    return m_ids.accessibleId(parentId) ? TreeAccessible : mode;
+}
+
+bool QtHelloServer::collectChildIds(int parentId, QVector<int>& out, TreeMode mode) {
+    if (childMode(parentId, mode) == TreeAccessible) {
+        QAccessibleInterface* parent = accessibleForId(parentId);
+        if (!parent) return false;
+
+        const int n = parent->childCount();
+        for (int i = 0; i < n; ++i) {
+            QAccessibleInterface* ch = parent->child(i);
+            if (ch && ch->isValid())
+                out.push_back(ensureIdForAccessible(ch));
+        }
+        return true;
+    }
 
     // 1) QGraphicsItem
     if (QGraphicsItem* parentGI = gitemForId(parentId)) {
-        dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QGraphicsItem branch\n")
+        INJECTLIB_LOG(injectlib::LogTrace, QString::fromLatin1("[injectlib] collectChildIds parentId %1 - QGraphicsItem branch\n")
                 .arg(parentId));
         const auto kids = parentGI->childItems();
         for (QGraphicsItem* ch : kids) {
             if (!ch) continue;
-            dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QGraphicsItem branch add child\n")
-                .arg(parentId));
-            out.push_back(summarizeGraphicsItem(ch));
+            out.push_back(ensureIdForGItem(ch));
         }
-        QJsonObject resp; resp["id"] = requestId; resp["result"] = out; sendJson(sock, resp);
-        return;
+        return true;
     }
 
     // 2) QObject
     if (QObject* parent = objectForId(parentId)) {
-        dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QObject branch\n")
+        INJECTLIB_LOG(injectlib::LogTrace, QString::fromLatin1("[injectlib] collectChildIds parentId %1 - QObject branch\n")
                 .arg(parentId));
         QSet<QObject*> seen; // avoid duplicates when an object appears through multiple paths
 
@@ -617,27 +1198,22 @@ void QtHelloServer::handleElementsChildren(QTcpSocket* sock, int requestId, int
         if (QWidget* pw = qobject_cast<QWidget*>(parent)) {
             const auto kids = pw->findChildren<QWidget*>(QString(), Qt::FindDirectChildrenOnly);
             for (QWidget* w : kids) {
-                dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QGraphicsItem branch add QWidget child\n")
-                    .arg(parentId));
-                if (!w) continue;
-                out.push_back(summarizeObject(w));
+                if (!w || seen.contains(w)) continue;
+                out.push_back(ensureIdFor(w));
                 seen.insert(w);
             }
 
             // QWidget might be a QGraphicsView
             if (QGraphicsView* view = qobject_cast<QGraphicsView*>(pw)) {
-                dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QGraphicsItem branch can cast to QGraphicsView\n")
-                    .arg(parentId));
                 if (QGraphicsScene* sc = view->scene()) {
-                    dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QGraphicsItem branch can cast to QGraphicsView has scene\n")
-                    .arg(parentId));
+                    INJECTLIB_LOG(injectlib::LogTrace, QString::fromLatin1("[injectlib] collectChildIds parentId %1 - QGraphicsView with scene\n")
+                        .arg(parentId));
                     // Only top-level items (no parentItem)
+                    // (large scenes are better paged with scene.items)
                     const auto items = sc->items(Qt::SortOrder::AscendingOrder);
                     for (QGraphicsItem* gi : items) {
-                        dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QGraphicsItem branch can cast to QGraphicsView has scene add child\n")
-                    .arg(parentId));
                         if (!gi || gi->parentItem()) continue;
-                        out.push_back(summarizeGraphicsItem(gi));
+                        out.push_back(ensureIdForGItem(gi));
                     }
                 }
             }
@@ -645,216 +1221,1650 @@ void QtHelloServer::handleElementsChildren(QTcpSocket* sock, int requestId, int
 
         // 2.b) QWindow
         if (QWindow* pwin = qobject_cast<QWindow*>(parent)) {
-            dbg(QString::fromLatin1("[injectlib] handleElementsChildren parentId %1 - QWindow branch\n")
-                .arg(parentId));
             const QObjectList kids = pwin->children();
             for (QObject* ch : kids) {
-                if (QWindow* cw = qobject_cast<QWindow*>(ch)) {
-                    out.push_back(summarizeObject(cw));
-                    seen.insert(cw);
+                QWindow* cw = qobject_cast<QWindow*>(ch);
+                if (!cw || seen.contains(cw)) continue;
+                out.push_back(ensureIdFor(cw));
+                seen.insert(cw);
+            }
+#ifdef INJECTLIB_HAVE_QUICK
+            // The scene's items hang off the window's (unnamed) content item.
+            if (QQuickWindow* qw = qobject_cast<QQuickWindow*>(pwin)) {
+                if (QQuickItem* content = qw->contentItem()) {
+                    const auto items = content->childItems();
+                    for (QQuickItem* qi : items) {
+                        if (!qi || seen.contains(qi)) continue;
+                        out.push_back(ensureIdFor(qi));
+                        seen.insert(qi);
+                    }
                 }
             }
+#endif
         }
 
-        QJsonObject resp; resp["id"] = requestId; resp["result"] = out; sendJson(sock, resp);
-        return;
+#ifdef INJECTLIB_HAVE_QUICK
+        // 2.c) QQuickItem: visual children, in stacking order
+        if (QQuickItem* pqi = qobject_cast<QQuickItem*>(parent)) {
+            const auto items = pqi->childItems();
+            for (QQuickItem* qi : items) {
+                if (!qi || seen.contains(qi)) continue;
+                out.push_back(ensureIdFor(qi));
+                seen.insert(qi);
+            }
+        }
+#endif
+        return true;
     }
 
-    // Unknown id error
-    QJsonObject resp; resp["id"] = requestId;
-    QJsonObject err;  err["code"] = -32602; err["message"] = "Invalid params: unknown id";
-    resp["error"] = err;
-    sendJson(sock, resp);
+    return false;
 }
 
-void QtHelloServer::handleElementInfo(QTcpSocket* sock, int requestId, int id) {
-    QJsonObject resp;
-    resp["id"] = requestId;
-
-    // 1) QGraphicsView
-    if (QGraphicsItem* gi = gitemForId(id)) {
-        dbg(QString::fromLatin1("[injectlib] handleElementInfo id %1 - summarizeGraphicsItem branch\n")
-                .arg(id));
-        resp["result"] = summarizeGraphicsItem(gi);
-        sendJson(sock, resp);
-        return;
+bool QtHelloServer::startWalk(TreeWalk& walk, int rootId, int maxDepth, quint32 fields, TreeMode mode) {
+    // Breadth-first, so a truncated walk still covers the upper levels of the UI.
+    walk.maxDepth = maxDepth;
+    walk.fields = fields;
+
+    if (rootId == 0) {
+        QVector<int> roots;
+        collectRootIds(roots, mode);
+        for (int id : roots)
+            walk.queue.enqueue({ id, 0, 0, mode, mode != TreeAccessible });
+    } else if (!summarizeId(rootId, FieldId, mode).isEmpty()) {
+        walk.queue.enqueue({ rootId, 0, 0, mode, false });
+    } else {
+        return false;
     }
+    return true;
+}
 
-    // 2) QObject
-    if (QObject* obj = objectForId(id)) {
-        dbg(QString::fromLatin1("[injectlib] handleElementInfo id %1 - summarizeObject branch\n")
-                .arg(id));
-        resp["result"] = summarizeObject(obj);
-        sendJson(sock, resp);
-        return;
-    }
+bool QtHelloServer::stepWalk(TreeWalk& walk, const WalkVisitor& visit, qint64 budgetNs) {
+    QElapsedTimer slice;
+    slice.start();
+    SceneTransformCache scenes; // views may move between slices
 
-    QJsonObject err;
-    err["code"] = -32602;
-    err["message"] = QStringLiteral("Invalid params: unknown id");
-    resp["error"] = err;
-    sendJson(sock, resp);
-    return;
-}
+    while (!walk.stopped && !walk.queue.isEmpty()) {
+        if (budgetNs > 0 && slice.nsecsElapsed() >= budgetNs)
+            return false;
 
-int QtHelloServer::ensureIdForGItem(QGraphicsItem* it) {
-    if (!it) return 0;
-    auto itId = gmaps.gitem2id.find(it);
-    if (itId != gmaps.gitem2id.end())
-        return *itId;
-    // start graphics ids far from QObject ids
-    const int id = gmaps.nextId++;
-    gmaps.gitem2id.insert(it, id);
-    gmaps.id2gitem.insert(id, it);
-    return id;
-}
+        const TreeWalk::Pending cur = walk.queue.dequeue();
+        if (cur.id <= 0 || walk.seen.contains(cur.id)) continue;
+        walk.seen.insert(cur.id);
 
-QGraphicsItem* QtHelloServer::gitemForId(int id) {
-    auto it = gmaps.id2gitem.find(id);
-    return (it == gmaps.id2gitem.end()) ? nullptr : it.value();
-}
+        // Gone since it was queued (the walk spans several slices): skip it and its subtree.
+        QJsonObject node = summarizeId(cur.id, walk.fields, cur.mode, cur.topLevel, &scenes);
+        if (node.isEmpty()) continue;
 
-QJsonObject QtHelloServer::summarizeGraphicsItem(QGraphicsItem* gi) {
-    QJsonObject j;
-    if (!gi) return j;
+        if (!visit(node, cur.parent, cur.depth)) {
+            walk.stopped = true;
+            break;
+        }
 
-    const int id = ensureIdForGItem(gi);
-    j["id"] = id;
-    j["name"] = QString(); // QGraphicsItem has no name
-    j["class"] = QStringLiteral("QGraphicsItem");
-    j["control_type"] = QStringLiteral("Pane");
-
-    // Compute a best-effort screen rect using the first view of the item's scene (if any)
-    QRect rScreen;
-    if (QGraphicsScene* sc = gi->scene()) {
-        const QList<QGraphicsView*> views = sc->views();
-        if (!views.isEmpty()) {
-            QGraphicsView* v = views.first();
-            const QRectF sceneRect = gi->sceneBoundingRect();
-            const QPolygon viewPoly = v->mapFromScene(sceneRect);
-            const QRect viewRect = viewPoly.boundingRect();
-            const QPoint globalTL = v->viewport()->mapToGlobal(viewRect.topLeft());
-            rScreen = QRect(globalTL, viewRect.size());
-        }
-    }
-    j["rect"] = rect_to_array(rScreen);
-    j["visible"] = gi->isVisible();
-    j["enabled"] = true; // no enabled state for plain QGraphicsItem
-    return j;
+        if (walk.maxDepth < 0 || cur.depth < walk.maxDepth) {
+            QVector<int> kids;
+            collectChildIds(cur.id, kids, cur.mode);
+            const TreeMode kidsMode = childMode(cur.id, cur.mode);
+            for (int id : kids)
+                walk.queue.enqueue({ id, cur.id, cur.depth + 1, kidsMode, false });
+        }
+    }
+    return true;
 }
 
-void QtHelloServer::handleElementClick(QTcpSocket* sock, int requestId, int id) {
-    QJsonObject resp; resp["id"] = requestId;
-
-    dbg(QString::fromLatin1("[injectlib] handleElementClick id %1\n")
-                .arg(id));
+QtHelloServer::TreeOptions QtHelloServer::parseTreeOptions(const QJsonObject& params) {
+    TreeOptions opts;
+    opts.rootId   = params.value("id").toInt(0);
+    opts.maxDepth = params.value("max_depth").toInt(-1);
+    opts.maxNodes = params.value("max_nodes").toInt(0);
+    opts.fields   = parse_fields(params.value("fields"));
+    opts.mode     = parse_tree_mode(params.value("tree_mode"));
+    return opts;
+}
 
-    auto ok = [&]() {
-        QJsonObject r; r["ok"] = true;
-        resp["result"] = r;
-        sendJson(sock, resp);
+QtHelloServer::RequestJob QtHelloServer::treeJob(int requestId, const TreeOptions& opts, const StreamSink& stream) {
+    struct State {
+        TreeWalk walk;
+        bool started = false;
+        QJsonArray nodes; // not yet sent
+        int count = 0;
+        int chunks = 0;
+        bool truncated = false;
     };
-    auto err = [&](int code, const QString& msg) {
-        QJsonObject e; e["code"] = code; e["message"] = msg;
-        resp["error"] = e;
-        sendJson(sock, resp);
+    auto st = std::make_shared<State>();
+
+    return [this, st, requestId, opts, stream](qint64 budgetNs, QJsonObject& resp) {
+        resp["id"] = requestId;
+        if (!st->started) {
+            st->started = true;
+            if (!startWalk(st->walk, opts.rootId, opts.maxDepth, opts.fields, opts.mode)) {
+                QJsonObject err;
+                err["code"] = -32602;
+                err["message"] = QStringLiteral("Invalid params: unknown id");
+                resp["error"] = err;
+                return true;
+            }
+        }
+
+        const bool done = stepWalk(st->walk, [&](QJsonObject& node, int parent, int depth) {
+            if (opts.maxNodes > 0 && st->count >= opts.maxNodes) {
+                st->truncated = true;
+                return false;
+            }
+            node["parent"] = parent;
+            node["depth"]  = depth;
+            st->nodes.push_back(node);
+            ++st->count;
+            if (stream.chunkSize > 0 && st->nodes.size() >= stream.chunkSize) {
+                stream.push(chunk_frame(requestId, st->chunks++, QStringLiteral("nodes"), st->nodes));
+                st->nodes = QJsonArray();
+            }
+            return true;
+        }, budgetNs);
+        if (!done)
+            return false;
+
+        QJsonObject result;
+        result["root"]      = opts.rootId;
+        result["nodes"]     = st->nodes;
+        result["truncated"] = st->truncated;
+        if (stream.chunkSize > 0)
+            result["chunks"] = st->chunks;
+        resp["result"] = result;
+        return true;
     };
+}
 
-    // 1) QGraphicsItem
-    if (QGraphicsItem* gi = gitemForId(id)) {
-        // Only QGraphicsObject supports signals/slots; plain QGraphicsItem has no semantic click
-        if (QGraphicsObject* go = gi->toGraphicsObject()) {
-            // Try common names
-            bool invoked =
-                QMetaObject::invokeMethod(go, "click", Qt::QueuedConnection) ||
-                QMetaObject::invokeMethod(go, "trigger", Qt::QueuedConnection) ||
-                QMetaObject::invokeMethod(go, "clicked", Qt::QueuedConnection);
-            if (invoked) return ok();
-            return err(-32001, "GraphicsObject has no invokable click/trigger/clicked");
+QtHelloServer::RequestJob QtHelloServer::findJob(int requestId, const QJsonObject& params, Session* s, int maxVisited,
+                                                 const StreamSink& stream) {
+    struct State {
+        std::shared_ptr<const FindQuery> query;
+        QString error;
+        TreeWalk walk;
+        bool started = false;
+        QJsonArray matches; // not yet sent
+        int found = 0;
+        int chunks = 0;
+        int visited = 0;
+        bool complete = true;
+        bool truncated = false;
+    };
+    auto st = std::make_shared<State>();
+
+    const QString key = QString::fromUtf8(QJsonDocument(params).toJson(QJsonDocument::Compact));
+    if (s)
+        st->query = s->queries.value(key);
+    if (!st->query) {
+        auto query = std::make_shared<FindQuery>();
+        if (query->parse(params, &st->error)) {
+            st->query = query;
+            if (s) {
+                if (s->queries.size() >= 32) s->queries.clear();
+                s->queries.insert(key, st->query);
+            }
         }
-        return err(-32000, "GraphicsItem is not a QObject; semantic click unsupported");
     }
 
-    // 2) QObject
-    if (QObject* obj = objectForId(id)) {
-        // QAction: trigger
-        if (QAction* act = qobject_cast<QAction*>(obj)) {
-            QTimer::singleShot(0, act, &QAction::trigger);
-            return ok();
-        }
-        // QAbstractButton: click
-        if (QAbstractButton* btn = qobject_cast<QAbstractButton*>(obj)) {
-            QTimer::singleShot(0, btn, &QAbstractButton::click);
-            return ok();
-        }
-        // QComboBox: open popup as semantic "click"
-        if (QComboBox* cb = qobject_cast<QComboBox*>(obj)) {
-            QTimer::singleShot(0, cb, &QComboBox::showPopup);
-            return ok();
+    const int rootId     = params.value("id").toInt(0);
+    const int maxDepth   = params.value("max_depth").toInt(-1);
+    const int maxResults = params.value("max_results").toInt(1); // <= 0 means all matches
+    const quint32 fields = parse_fields(params.value("fields"));
+    const TreeMode mode  = parse_tree_mode(params.value("tree_mode"));
+
+    return [this, st, requestId, rootId, maxDepth, maxResults, fields, mode, maxVisited, stream](qint64 budgetNs, QJsonObject& resp) {
+        resp["id"] = requestId;
+        auto err = [&](int code, const QString& msg) {
+            QJsonObject e; e["code"] = code; e["message"] = msg;
+            resp["error"] = e;
+            return true;
+        };
+
+        if (!st->started) {
+            st->started = true;
+            if (!st->query)
+                return err(-32602, QStringLiteral("Invalid params: %1").arg(st->error));
+            // Walk with only the fields the predicates look at; full summaries are built for matches only.
+            if (!startWalk(st->walk, rootId, maxDepth, st->query->fields, mode))
+                return err(-32602, QStringLiteral("Invalid params: unknown id"));
         }
-        // QTabBar: switch to current tab
-        if (QTabBar* tb = qobject_cast<QTabBar*>(obj)) {
-            int idx = tb->currentIndex();
-            if (idx >= 0) {
-                QTimer::singleShot(0, [tb, idx]() { tb->setCurrentIndex(idx); emit tb->tabBarClicked(idx); });
-                return ok();
+
+        const FindQuery& query = *st->query;
+        const bool done = stepWalk(st->walk, [&](QJsonObject& node, int parent, int depth) {
+            if (maxVisited > 0 && st->visited >= maxVisited) {
+                st->complete = false;
+                st->truncated = true;
+                return false;
+            }
+            ++st->visited;
+            if (!query.matches(node))
+                return true;
+
+            const int id = node.value("id").toInt(0);
+            QJsonObject match = summarizeId(id, fields, mode, rootId == 0 && depth == 0);
+            if (match.isEmpty())
+                return true;
+            match["parent"] = parent;
+            match["depth"]  = depth;
+            st->matches.push_back(match);
+            ++st->found;
+            if (stream.chunkSize > 0 && st->matches.size() >= stream.chunkSize) {
+                stream.push(chunk_frame(requestId, st->chunks++, QStringLiteral("matches"), st->matches));
+                st->matches = QJsonArray();
             }
-            return err(-32006, "TabBar has no current index");
-        }
 
-        // Try common names
-        bool invoked =
-            QMetaObject::invokeMethod(obj, "click",   Qt::QueuedConnection) ||
-            QMetaObject::invokeMethod(obj, "trigger", Qt::QueuedConnection) ||
-            QMetaObject::invokeMethod(obj, "clicked", Qt::QueuedConnection);
-        if (invoked) return ok();
+            if (maxResults > 0 && st->found >= maxResults) {
+                st->complete = false;
+                return false;
+            }
+            return true;
+        }, budgetNs);
+        if (!done)
+            return false;
+
+        QJsonObject result;
+        result["matches"]  = st->matches;
+        result["visited"]  = st->visited;
+        result["complete"] = st->complete;   // false if the walk stopped at max_results or the session limit
+        if (st->truncated)
+            result["truncated"] = true;      // stopped by session.setLimits max_nodes
+        if (stream.chunkSize > 0)
+            result["chunks"] = st->chunks;
+        resp["result"] = result;
+        return true;
+    };
+}
 
-        return err(-32008, "Unsupported object type for semantic click");
+QtHelloServer::RequestJob QtHelloServer::childrenJob(int requestId, int parentId, bool roots, quint32 fields, TreeMode mode) {
+    struct State {
+        bool started = false;
+        QVector<int> ids;   // enumerated in the first slice, summarized from there on
+        int next = 0;
+        TreeMode mode = TreeObjects;
+        QJsonArray out;
+    };
+    auto st = std::make_shared<State>();
+
+    return [this, st, requestId, parentId, roots, fields, mode](qint64 budgetNs, QJsonObject& resp) {
+        resp["id"] = requestId;
+        if (!st->started) {
+            st->started = true;
+            if (roots) {
+                collectRootIds(st->ids, mode);
+                st->mode = mode;
+            } else if (collectChildIds(parentId, st->ids, mode)) {
+                st->mode = childMode(parentId, mode);
+            } else {
+                QJsonObject err;
+                err["code"] = -32602;
+                err["message"] = QStringLiteral("Invalid params: unknown id");
+                resp["error"] = err;
+                return true;
+            }
+        }
+
+        QElapsedTimer slice;
+        slice.start();
+        SceneTransformCache scenes; // siblings share a scene, so the view is mapped once per slice
+        const bool topLevel = roots && mode != TreeAccessible;
+        while (st->next < st->ids.size()) {
+            if (budgetNs > 0 && slice.nsecsElapsed() >= budgetNs)
+                return false;
+            // Gone since the first slice: left out, the way a walk drops it.
+            const QJsonObject j = summarizeId(st->ids.at(st->next++), fields, st->mode, topLevel, &scenes);
+            if (!j.isEmpty())
+                st->out.push_back(j);
+        }
+        resp["result"] = st->out;
+        return true;
+    };
+}
+
+QJsonObject QtHelloServer::handleElementInfo(int requestId, int id, quint32 fields, TreeMode mode) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    const QJsonObject summary = summarizeId(id, fields, mode);
+    if (!summary.isEmpty()) {
+        resp["result"] = summary;
+        return resp;
     }
 
-    // 3) Unknown id
-    return err(-32602, "Invalid params: unknown id");
+    QJsonObject err;
+    err["code"] = -32602;
+    err["message"] = QStringLiteral("Invalid params: unknown id");
+    resp["error"] = err;
+    return resp;
 }
 
-void QtHelloServer::handleElementSetText(QTcpSocket* sock, int requestId, int id, const QString& text) {
-    QJsonObject resp; resp["id"] = requestId;
+QJsonObject QtHelloServer::summarizeId(int id, quint32 fields, TreeMode mode, bool topLevel,
+                                       SceneTransformCache* scenes) {
+    if (mode == TreeAccessible || m_ids.accessibleId(id)) {
+        if (QAccessibleInterface* iface = accessibleForId(id))
+            return summarizeAccessible(iface, fields);
+    }
 
-    auto ok = [&]() {
-        QJsonObject r; r["ok"] = true;
-        resp["result"] = r;
-        sendJson(sock, resp);
-    };
-    auto err = [&](int code, const QString& msg) {
-        QJsonObject e; e["code"] = code; e["message"] = msg;
-        resp["error"] = e;
-        sendJson(sock, resp);
+    // 1) QGraphicsItem
+    if (QGraphicsItem* gi = gitemForId(id)) {
+        INJECTLIB_LOG(injectlib::LogTrace, QString::fromLatin1("[injectlib] summarizeId id %1 - summarizeGraphicsItem branch\n")
+                .arg(id));
+        if (!scenes || !(fields & FieldRect))
+            return summarizeGraphicsItem(gi, fields);
+        if (scenes->scene != gi->scene()) {
+            const QGraphicsView* view = first_view(gi->scene());
+            scenes->scene    = gi->scene();
+            scenes->hasView  = view != nullptr;
+            scenes->toGlobal = view ? scene_to_global(view) : QTransform();
+        }
+        return summarizeGraphicsItem(gi, fields, scenes->hasView ? &scenes->toGlobal : nullptr);
+    }
+
+    // 2) QObject
+    if (QObject* obj = objectForId(id)) {
+        INJECTLIB_LOG(injectlib::LogTrace, QString::fromLatin1("[injectlib] summarizeId id %1 - summarizeObject branch\n")
+                .arg(id));
+        return topLevel ? summarizeTopLevel(obj, fields) : summarizeObject(obj, fields);
+    }
+
+    return QJsonObject();
+}
+
+QJsonObject QtHelloServer::handleElementProperties(int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    const QJsonArray ids = params.value("ids").toArray();
+    const QJsonArray props = params.value("properties").toArray();
+    if (ids.isEmpty() || props.isEmpty() || qint64(ids.size()) * props.size() > m_maxPropertyReads) {
+        QJsonObject err;
+        err["code"] = -32602;
+        err["message"] = QStringLiteral("Invalid params: need 1..%1 ids x properties").arg(m_maxPropertyReads);
+        resp["error"] = err;
+        return resp;
+    }
+
+    QList<QByteArray> names;
+    names.reserve(props.size());
+    for (const QJsonValue& p : props)
+        names.push_back(p.toString().toUtf8());
+
+    const injectlib::ObjectIdFn idFor = [this](QObject* o) { return ensureIdFor(o); };
+    QJsonArray items;
+    for (const QJsonValue& v : ids) {
+        const int id = v.toInt(0);
+        QObject* obj = objectForId(id);
+        if (!obj) {
+            if (QGraphicsItem* gi = gitemForId(id))
+                obj = gi->toGraphicsObject();
+        }
+
+        QJsonObject item;
+        item["id"] = id;
+        if (!obj) {
+            QJsonObject err;
+            err["code"] = -32602;
+            err["message"] = QStringLiteral("unknown id or element without properties");
+            item["error"] = err;
+            items.push_back(item);
+            continue;
+        }
+        QJsonArray missing;
+        item["values"] = m_props.read(obj, names, &missing, idFor);
+        if (!missing.isEmpty())
+            item["missing"] = missing;
+        items.push_back(item);
+    }
+
+    QJsonObject result;
+    result["items"] = items;
+    resp["result"] = result;
+    return resp;
+}
+
+int QtHelloServer::ensureIdForGItem(QGraphicsItem* it) {
+    return m_ids.idForItem(it);
+}
+
+QGraphicsItem* QtHelloServer::gitemForId(int id) {
+    return m_ids.graphicsItem(id);
+}
+
+QJsonObject QtHelloServer::summarizeGraphicsItem(QGraphicsItem* gi, quint32 fields, const QTransform* toGlobal) {
+    QJsonObject j;
+    if (!gi) return j;
+
+    j["id"] = ensureIdForGItem(gi);
+    if (fields & FieldName)        j["name"]         = QString(); // QGraphicsItem has no name
+    if (fields & FieldClass)       j["class"]        = QStringLiteral("QGraphicsItem");
+    if (fields & FieldControlType) j["control_type"] = QStringLiteral("Pane");
+
+    if (fields & FieldRect) {
+        // Best-effort screen rect: callers summarizing many items pass the view transform,
+        // otherwise the first view of the item's scene (if any) is used.
+        QRect rScreen;
+        if (toGlobal) {
+            rScreen = toGlobal->mapRect(gi->sceneBoundingRect()).toAlignedRect();
+        } else if (const QGraphicsView* v = first_view(gi->scene())) {
+            rScreen = scene_to_global(v).mapRect(gi->sceneBoundingRect()).toAlignedRect();
+        }
+        j["rect"] = rect_to_array(rScreen);
+    }
+    if (fields & FieldVisible)     j["visible"]      = gi->isVisible();
+    if (fields & FieldEnabled)     j["enabled"]      = true; // no enabled state for plain QGraphicsItem
+    return j;
+}
+
+// ----------------- accessibility -----------------
+
+namespace {
+
+QString accessible_role_name(QAccessible::Role role) {
+    static const QMetaEnum roles = QAccessible::staticMetaObject.enumerator(
+            QAccessible::staticMetaObject.indexOfEnumerator("Role"));
+    const char* key = roles.valueToKey(role);
+    return key ? QString::fromLatin1(key) : QString::number(role);
+}
+
+QJsonArray accessible_state_names(const QAccessible::State& s) {
+    QJsonArray out;
+    auto add = [&out](bool on, const char* name) {
+        if (on) out.push_back(QLatin1String(name));
     };
+    add(s.disabled,        "disabled");
+    add(s.invisible,       "invisible");
+    add(s.offscreen,       "offscreen");
+    add(s.focusable,       "focusable");
+    add(s.focused,         "focused");
+    add(s.selectable,      "selectable");
+    add(s.selected,        "selected");
+    add(s.pressed,         "pressed");
+    add(s.checkable,       "checkable");
+    add(s.checked,         "checked");
+    add(s.checkStateMixed, "mixed");
+    add(s.expandable,      "expandable");
+    add(s.expanded,        "expanded");
+    add(s.collapsed,       "collapsed");
+    add(s.readOnly,        "read_only");
+    add(s.editable,        "editable");
+    add(s.multiLine,       "multi_line");
+    add(s.passwordEdit,    "password");
+    add(s.hasPopup,        "has_popup");
+    add(s.modal,           "modal");
+    add(s.active,          "active");
+    add(s.defaultButton,   "default");
+    add(s.busy,            "busy");
+    return out;
+}
 
+} // namespace
+
+int QtHelloServer::ensureIdForAccessible(QAccessibleInterface* iface) {
+    if (!iface || !iface->isValid()) return 0;
+
+    QObject* obj = iface->object();
+    if (obj && QAccessible::queryAccessibleInterface(obj) == iface)
+        return ensureIdFor(obj);
+
+    // Tie object-less interfaces to the nearest object above them (the item view of a cell).
+    QObject* owner = nullptr;
+    QAccessibleInterface* p = iface->parent();
+    for (int depth = 0; p && !owner && depth < 64; ++depth, p = p->parent())
+        owner = p->object();
+    if (!owner)
+        owner = QCoreApplication::instance();
+    return m_ids.idForAccessible(QAccessible::uniqueId(iface), owner);
+}
+
+QAccessibleInterface* QtHelloServer::accessibleForId(int id) {
+    if (QObject* obj = objectForId(id))
+        return QAccessible::queryAccessibleInterface(obj);
+
+    const quint32 accId = m_ids.accessibleId(id);
+    if (!accId) return nullptr;
+    QAccessibleInterface* iface = QAccessible::accessibleInterface(accId);
+    if (!iface || !iface->isValid()) {
+        // Qt deleted the interface (e.g. the cell's model row went away).
+        m_ids.release(id);
+        return nullptr;
+    }
+    return iface;
+}
+
+QJsonObject QtHelloServer::summarizeAccessible(QAccessibleInterface* iface, quint32 fields) {
+    QJsonObject j;
+    if (!iface || !iface->isValid()) return j;
+
+    QObject* obj = iface->object();
+    j["id"] = ensureIdForAccessible(iface);
+
+    if (fields & FieldName) j["name"] = iface->text(QAccessible::Name);
+    if (fields & FieldClass)
+        j["class"] = obj ? QString::fromLatin1(obj->metaObject()->className()) : QStringLiteral("QAccessibleInterface");
+    if (fields & (FieldControlType | FieldRole)) {
+        const QString role = accessible_role_name(iface->role());
+        // Same control types as the object tree where there is an object, so finds carry over.
+        if (fields & FieldControlType) j["control_type"] = obj ? control_type_for(obj) : role;
+        if (fields & FieldRole)        j["role"]         = role;
+    }
+    if (fields & FieldRect) j["rect"] = rect_to_array(iface->rect());
+    if (fields & (FieldVisible | FieldEnabled | FieldState)) {
+        const QAccessible::State state = iface->state();
+        if (fields & FieldVisible) j["visible"] = !state.invisible;
+        if (fields & FieldEnabled) j["enabled"] = !state.disabled;
+        if (fields & FieldState)   j["state"]   = accessible_state_names(state);
+    }
+    if (fields & FieldAutoId) j["auto_id"] = obj ? obj->objectName() : QString();
+    if (fields & FieldPid)    j["pid"]     = static_cast<qint64>(QCoreApplication::applicationPid());
+    if (fields & FieldValue) {
+        if (QAccessibleValueInterface* v = iface->valueInterface())
+            j["value"] = QJsonValue::fromVariant(v->currentValue());
+        else
+            j["value"] = iface->text(QAccessible::Value);
+    }
+    return j;
+}
+
+// ----------------- actions -----------------
+
+namespace {
+
+QJsonObject action_error(int code, const QString& msg) {
+    QJsonObject e; e["code"] = code; e["message"] = msg;
+    return e;
+}
+
+} // namespace
+
+bool QtHelloServer::prepareClick(int id, DeferredAction& action, QJsonObject& error) {
     // 1) QGraphicsItem
     if (QGraphicsItem* gi = gitemForId(id)) {
-        // Prefer QGraphicsObject path
+        // Only QGraphicsObject supports signals/slots; plain QGraphicsItem has no semantic click
         if (QGraphicsObject* go = gi->toGraphicsObject()) {
-            if (setQObjectTextOrValue(go, text)) return ok();
-            return err(-32021, "GraphicsObject has no writable text/value");
+            // Try common names
+            const int idx = click_method_index(go);
+            if (idx >= 0) {
+                const QMetaMethod m = go->metaObject()->method(idx);
+                QPointer<QGraphicsObject> p(go);
+                action = [p, m]() { if (p) m.invoke(p.data(), Qt::DirectConnection); };
+                return true;
+            }
+            error = action_error(-32001, "GraphicsObject has no invokable click/trigger/clicked");
+            return false;
+        }
+        error = action_error(-32000, "GraphicsItem is not a QObject; semantic click unsupported");
+        return false;
+    }
+
+    // 2) QObject
+    if (QObject* obj = objectForId(id)) {
+        // QAction: trigger
+        if (QAction* act = qobject_cast<QAction*>(obj)) {
+            QPointer<QAction> p(act);
+            action = [p]() { if (p) p->trigger(); };
+            return true;
+        }
+        // QAbstractButton: click
+        if (QAbstractButton* btn = qobject_cast<QAbstractButton*>(obj)) {
+            QPointer<QAbstractButton> p(btn);
+            action = [p]() { if (p) p->click(); };
+            return true;
+        }
+        // QComboBox: open popup as semantic "click"
+        if (QComboBox* cb = qobject_cast<QComboBox*>(obj)) {
+            QPointer<QComboBox> p(cb);
+            action = [p]() { if (p) p->showPopup(); };
+            return true;
+        }
+        // QTabBar: switch to current tab
+        if (QTabBar* tb = qobject_cast<QTabBar*>(obj)) {
+            int idx = tb->currentIndex();
+            if (idx >= 0) {
+                QPointer<QTabBar> p(tb);
+                action = [p, idx]() { if (p) { p->setCurrentIndex(idx); emit p->tabBarClicked(idx); } };
+                return true;
+            }
+            error = action_error(-32006, "TabBar has no current index");
+            return false;
         }
-        // Non-QObject items with text APIs
-        if (auto gti = dynamic_cast<QGraphicsTextItem*>(gi)) {
-            QTimer::singleShot(0, [gti, text]() { gti->setPlainText(text); });
-            return ok();
+
+        // Try common names
+        const int idx = click_method_index(obj);
+        if (idx >= 0) {
+            const QMetaMethod m = obj->metaObject()->method(idx);
+            QPointer<QObject> p(obj);
+            action = [p, m]() { if (p) m.invoke(p.data(), Qt::DirectConnection); };
+            return true;
         }
-        if (auto sti = dynamic_cast<QGraphicsSimpleTextItem*>(gi)) {
-            QTimer::singleShot(0, [sti, text]() { sti->setText(text); });
-            return ok();
+
+        error = action_error(-32008, "Unsupported object type for semantic click");
+        return false;
+    }
+
+    // 3) Unknown id
+    error = action_error(-32602, "Invalid params: unknown id");
+    return false;
+}
+
+bool QtHelloServer::prepareSetText(int id, const QString& text, DeferredAction& action, QJsonObject& error) {
+    // 1) QGraphicsItem
+    if (QGraphicsItem* gi = gitemForId(id)) {
+        if (QGraphicsTextItem* gti = dynamic_cast<QGraphicsTextItem*>(gi)) {
+            QPointer<QGraphicsTextItem> p(gti);
+            action = [p, text]() { if (p) p->setPlainText(text); };
+            return true;
+        }
+        // Prefer QGraphicsObject path
+        if (QGraphicsObject* go = gi->toGraphicsObject()) {
+            action = text_setter_for(go, text);
+            if (action) return true;
+            error = action_error(-32021, "GraphicsObject has no writable text/value");
+            return false;
         }
-        return err(-32020, "GraphicsItem not text-editable");
+        // Non-QObject items with text APIs; resolved again when applied since they can't be guarded
+        if (dynamic_cast<QGraphicsSimpleTextItem*>(gi)) {
+            action = [this, id, text]() {
+                m_ids.newPass(); // the item may have been deleted since the request
+                if (auto sti = dynamic_cast<QGraphicsSimpleTextItem*>(gitemForId(id)))
+                    sti->setText(text);
+            };
+            return true;
+        }
+        error = action_error(-32020, "GraphicsItem not text-editable");
+        return false;
     }
 
     // 2) QObject
     if (QObject* obj = objectForId(id)) {
-        if (setQObjectTextOrValue(obj, text)) return ok();
-        return err(-32010, "Unsupported object type or read-only");
+        action = text_setter_for(obj, text);
+        if (action) return true;
+        error = action_error(-32010, "Unsupported object type or read-only");
+        return false;
     }
 
     // 3) Unknown id
-    return err(-32602, "Invalid params: unknown id");
+    error = action_error(-32602, "Invalid params: unknown id");
+    return false;
+}
+
+QJsonObject QtHelloServer::handleElementClick(int requestId, int id) {
+    INJECTLIB_LOG(injectlib::LogDebug, QString::fromLatin1("[injectlib] handleElementClick id %1\n")
+                .arg(id));
+
+    QJsonObject resp; resp["id"] = requestId;
+    DeferredAction action;
+    QJsonObject error;
+    if (!prepareClick(id, action, error)) {
+        resp["error"] = error;
+        return resp;
+    }
+
+    // Applied after the reply is queued, so a click that opens a modal dialog can't block it.
+    QTimer::singleShot(0, this, action);
+    QJsonObject r; r["ok"] = true;
+    resp["result"] = r;
+    return resp;
+}
+
+QJsonObject QtHelloServer::handleElementSetText(int requestId, int id, const QString& text) {
+    QJsonObject resp; resp["id"] = requestId;
+    DeferredAction action;
+    QJsonObject error;
+    if (!prepareSetText(id, text, action, error)) {
+        resp["error"] = error;
+        return resp;
+    }
+
+    QTimer::singleShot(0, this, action);
+    QJsonObject r; r["ok"] = true;
+    resp["result"] = r;
+    return resp;
+}
+
+QJsonObject QtHelloServer::handleActionsBatch(int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    const QJsonArray list = params.value("actions").toArray();
+    const bool stopOnError = params.value("stop_on_error").toBool(false);
+    if (list.size() > m_maxBatchActions) {
+        resp["error"] = action_error(-32602, QStringLiteral("Invalid params: more than %1 actions")
+                                                 .arg(m_maxBatchActions));
+        return resp;
+    }
+
+    // Everything is validated up front; the accepted actions are then applied in order by a
+    // single queued invocation instead of one per action.
+    auto run = std::make_shared<BatchRun>();
+    QJsonArray results;
+    int failed = 0;
+    for (const QJsonValue& v : list) {
+        QJsonObject r;
+        if (stopOnError && failed) {
+            r["skipped"] = true;
+            results.push_back(r);
+            continue;
+        }
+
+        const QJsonObject a = v.toObject();
+        const QString kind = a.value("action").toString();
+        const int id = a.value("id").toInt(0);
+        DeferredAction action;
+        QJsonObject error;
+        bool ok = false;
+        if (kind == QLatin1String("click"))
+            ok = prepareClick(id, action, error);
+        else if (kind == QLatin1String("setText"))
+            ok = prepareSetText(id, a.value("text").toString(), action, error);
+        else
+            error = action_error(-32602, QStringLiteral("Invalid params: unknown action \"%1\"").arg(kind));
+
+        if (ok) {
+            run->actions.push_back(action);
+            r["ok"] = true;
+        } else {
+            r["error"] = error;
+            ++failed;
+        }
+        results.push_back(r);
+    }
+
+    if (!run->actions.isEmpty())
+        QTimer::singleShot(0, this, [this, run]() { run->run(this); });
+
+    QJsonObject result;
+    result["ok"]      = failed == 0;
+    result["applied"] = run->actions.size();
+    result["results"] = results;
+    resp["result"] = result;
+    return resp;
+}
+
+// ----------------- item view models -----------------
+
+bool QtHelloServer::resolveModelTarget(const QJsonObject& params, QAbstractItemView*& view,
+                                       QModelIndex& parent, QJsonObject& error) {
+    view = qobject_cast<QAbstractItemView*>(objectForId(params.value("id").toInt(0)));
+    if (!view) {
+        error = action_error(-32602, "Invalid params: id is not an item view");
+        return false;
+    }
+    if (!view->model()) {
+        error = action_error(-32030, "Item view has no model");
+        return false;
+    }
+
+    QString why;
+    if (!injectlib::resolve_model_path(view, params.value("parent").toArray(), parent, &why)) {
+        error = action_error(-32602, QStringLiteral("Invalid params: %1").arg(why));
+        return false;
+    }
+    return true;
+}
+
+QJsonObject QtHelloServer::handleModelInfo(int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    QAbstractItemView* view = nullptr;
+    QModelIndex parent;
+    QJsonObject error;
+    if (!resolveModelTarget(params, view, parent, error)) {
+        resp["error"] = error;
+        return resp;
+    }
+    resp["result"] = injectlib::model_info(view, parent);
+    return resp;
+}
+
+QJsonObject QtHelloServer::handleModelRows(int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    QAbstractItemView* view = nullptr;
+    injectlib::ModelPage page;
+    QJsonObject error;
+    if (!resolveModelTarget(params, view, page.parent, error)) {
+        resp["error"] = error;
+        return resp;
+    }
+
+    page.row     = params.value("row").toInt(0);
+    page.count   = clamp_int(params.value("count").toInt(100), 0, m_maxModelPage);
+    page.column  = params.value("column").toInt(0);
+    page.columns = params.value("columns").toInt(-1);
+    page.fields  = injectlib::parse_model_fields(params.value("fields"));
+    page.maxCells = m_maxModelCells;
+    resp["result"] = injectlib::model_page(view, page);
+    return resp;
+}
+
+// ----------------- graphics scenes -----------------
+
+namespace {
+
+bool json_point(const QJsonValue& v, QPointF& out) {
+    const QJsonArray a = v.toArray();
+    if (a.size() != 2) return false;
+    out = QPointF(a.at(0).toDouble(), a.at(1).toDouble());
+    return true;
+}
+
+bool json_rect(const QJsonValue& v, QRectF& out) {
+    const QJsonArray a = v.toArray();
+    if (a.size() != 4) return false;
+    out = QRectF(a.at(0).toDouble(), a.at(1).toDouble(), a.at(2).toDouble(), a.at(3).toDouble());
+    return true;
+}
+
+} // namespace
+
+QtHelloServer::RequestJob QtHelloServer::sceneItemsJob(int requestId, const QJsonObject& params) {
+    struct State {
+        bool started = false;
+        int total = 0;
+        int taken = 0;      // items of the page, including ones deleted before their summary
+        QVector<int> rest;  // page items not summarized in the first slice, by id
+        int next = 0;
+        QJsonArray page;
+    };
+    auto st = std::make_shared<State>();
+
+    const int viewId     = params.value("id").toInt(0);
+    const int offset     = qMax(0, params.value("offset").toInt(0));
+    const int limit      = clamp_int(params.value("limit").toInt(m_maxScenePage), 0, m_maxScenePage);
+    const quint32 fields = parse_fields(params.value("fields"));
+
+    return [this, st, requestId, params, viewId, offset, limit, fields](qint64 budgetNs, QJsonObject& resp) {
+        resp["id"] = requestId;
+        QElapsedTimer slice;
+        slice.start();
+
+        QGraphicsView* view = qobject_cast<QGraphicsView*>(objectForId(viewId));
+        if (!view || !view->scene()) {
+            resp["error"] = action_error(-32602, "Invalid params: id is not a graphics view with a scene");
+            return true;
+        }
+        // One transform per slice, both for the query and for the item rects.
+        const QTransform toGlobal = scene_to_global(view);
+
+        if (!st->started) {
+            st->started = true;
+            QGraphicsScene* sc = view->scene();
+            const bool sceneCoords = params.value("coords").toString() == QLatin1String("scene");
+            const QTransform fromGlobal = sceneCoords ? QTransform() : toGlobal.inverted();
+            const Qt::ItemSelectionMode mode = params.value("mode").toString() == QLatin1String("contains")
+                                                   ? Qt::ContainsItemBoundingRect
+                                                   : Qt::IntersectsItemBoundingRect;
+
+            // Region and point queries go through the scene's index; without either the whole
+            // scene is listed (top-level items by default) and paged.
+            QList<QGraphicsItem*> items;
+            bool topLevel = false;
+            QRectF rect;
+            QPointF point;
+            if (json_rect(params.value("rect"), rect)) {
+                items = sc->items(fromGlobal.mapRect(rect), mode, Qt::DescendingOrder);
+            } else if (json_point(params.value("point"), point)) {
+                items = sc->items(fromGlobal.map(point), mode, Qt::DescendingOrder);
+            } else if (params.contains("rect") || params.contains("point")) {
+                resp["error"] = action_error(-32602, "Invalid params: rect must be [x, y, w, h], point [x, y]");
+                return true;
+            } else {
+                items = sc->items(Qt::AscendingOrder);
+                topLevel = true;
+            }
+            topLevel = params.value("top_level").toBool(topLevel);
+
+            // The query itself is one call into the scene; the summaries are what gets sliced.
+            // Item pointers are only good within this slice, so what is left over keeps its id.
+            for (QGraphicsItem* gi : qAsConst(items)) {
+                if (!gi || (topLevel && gi->parentItem())) continue;
+                if (st->total >= offset && st->taken < limit) {
+                    ++st->taken;
+                    if (st->rest.isEmpty() && (budgetNs <= 0 || slice.nsecsElapsed() < budgetNs))
+                        st->page.push_back(summarizeGraphicsItem(gi, fields, &toGlobal));
+                    else
+                        st->rest.push_back(ensureIdForGItem(gi));
+                }
+                ++st->total;
+            }
+            if (!st->rest.isEmpty())
+                return false;
+        }
+
+        // The first lookup of a slice checks the ids against the scene once; the budget is
+        // for the summaries after that.
+        bool checked = false;
+        while (st->next < st->rest.size()) {
+            if (checked && budgetNs > 0 && slice.nsecsElapsed() >= budgetNs)
+                return false;
+            // Deleted since the query: left out of the page.
+            QGraphicsItem* gi = gitemForId(st->rest.at(st->next++));
+            if (!checked) {
+                checked = true;
+                slice.restart();
+            }
+            if (gi)
+                st->page.push_back(summarizeGraphicsItem(gi, fields, &toGlobal));
+        }
+
+        QJsonObject result;
+        result["total"]  = st->total;
+        result["offset"] = offset;
+        result["items"]  = st->page;
+        if (offset + st->taken < st->total)
+            result["next_offset"] = offset + st->taken;
+        resp["result"] = result;
+        return true;
+    };
+}
+
+QJsonObject QtHelloServer::handleSceneItemAt(int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    QGraphicsView* view = qobject_cast<QGraphicsView*>(objectForId(params.value("id").toInt(0)));
+    QPointF point;
+    if (!view || !view->scene()) {
+        resp["error"] = action_error(-32602, "Invalid params: id is not a graphics view with a scene");
+        return resp;
+    }
+    if (!json_point(params.value("point"), point)) {
+        resp["error"] = action_error(-32602, "Invalid params: point must be [x, y]");
+        return resp;
+    }
+
+    const QTransform toGlobal = scene_to_global(view);
+    QGraphicsItem* gi = nullptr;
+    if (params.value("coords").toString() == QLatin1String("scene"))
+        gi = view->scene()->itemAt(point, view->transform());
+    else
+        gi = view->itemAt(view->viewport()->mapFromGlobal(point.toPoint()));
+
+    resp["result"] = gi ? QJsonValue(summarizeGraphicsItem(gi, parse_fields(params.value("fields")), &toGlobal))
+                        : QJsonValue(QJsonValue::Null);
+    return resp;
+}
+
+// ----------------- hit testing -----------------
+
+QJsonObject QtHelloServer::handleElementFromPoint(int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    QPointF pt;
+    if (!json_point(params.value("point"), pt)) {
+        resp["error"] = action_error(-32602, "Invalid params: point must be [x, y] in screen coordinates");
+        return resp;
+    }
+    const QPoint global = pt.toPoint();
+    const quint32 fields = parse_fields(params.value("fields"));
+
+    QJsonObject element;
+    QJsonArray ancestors; // nearest first, ending with the top-level element
+
+    // widgetAt already descends to the deepest visible child widget.
+    QWidget* w = QApplication::widgetAt(global);
+    if (w) {
+        // Scene items are children of their view in the element tree; the viewport is where
+        // the hit lands.
+        QGraphicsView* view = qobject_cast<QGraphicsView*>(w);
+        if (!view && w->parentWidget()) {
+            view = qobject_cast<QGraphicsView*>(w->parentWidget());
+            if (view && view->viewport() != w) view = nullptr;
+        }
+        QGraphicsItem* gi = nullptr;
+        if (view && view->scene())
+            gi = view->itemAt(view->viewport()->mapFromGlobal(global));
+
+        if (gi) {
+            element = summarizeGraphicsItem(gi, fields);
+            for (QGraphicsItem* p = gi->parentItem(); p; p = p->parentItem())
+                ancestors.push_back(ensureIdForGItem(p));
+            w = view;
+            ancestors.push_back(ensureIdFor(w));
+        } else {
+            element = w->isWindow() ? summarizeTopLevel(w, fields) : summarizeObject(w, fields);
+        }
+        for (QWidget* p = w->parentWidget(); p; p = p->parentWidget())
+            ancestors.push_back(ensureIdFor(p));
+    } else if (QWindow* win = QGuiApplication::topLevelAt(global)) {
+        // Windows without widgets (e.g. QML)
+        element = summarizeTopLevel(win, fields);
+    }
+
+    QJsonObject result;
+    result["element"]   = element.isEmpty() ? QJsonValue(QJsonValue::Null) : QJsonValue(element);
+    result["ancestors"] = ancestors;
+    resp["result"] = result;
+    return resp;
+}
+
+// ----------------- change notifications -----------------
+
+QJsonObject QtHelloServer::handleSubscribe(const PendingRequest& pending, int requestId, const QJsonObject& params) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    Subscription sub;
+    sub.conn    = pending.conn;
+    sub.push    = pending.push;
+    sub.subtree = params.value("subtree").toBool(false);
+    sub.events  = parse_change_events(params.value("events"), ChangeAll);
+    sub.fields  = parse_fields(params.value("fields"));
+
+    const int subId = m_nextSubId++;
+    QJsonArray rejected;
+    for (const QJsonValue& v : params.value("ids").toArray()) {
+        const int id = v.toInt(0);
+        QObject* obj = watchableForId(id);
+        if (!obj) {
+            rejected.push_back(id);
+            continue;
+        }
+        sub.roots.insert(id);
+    }
+
+    if (sub.roots.isEmpty()) {
+        QJsonObject err;
+        err["code"] = -32602;
+        err["message"] = QStringLiteral("Invalid params: no watchable ids");
+        resp["error"] = err;
+        return resp;
+    }
+
+    const QSet<int> roots = sub.roots;
+    m_subs.insert(subId, sub);
+    for (int id : roots)
+        watchObject(watchableForId(id), subId, sub.subtree);
+
+    QJsonObject result;
+    result["subscription"] = subId;
+    result["rejected"] = rejected;
+    resp["result"] = result;
+    return resp;
+}
+
+QJsonObject QtHelloServer::handleUnsubscribe(const PendingRequest& pending, int requestId, int subscriptionId) {
+    QJsonObject resp;
+    resp["id"] = requestId;
+
+    auto it = m_subs.find(subscriptionId);
+    if (it == m_subs.end() || it->conn != pending.conn) {
+        QJsonObject err;
+        err["code"] = -32602;
+        err["message"] = QStringLiteral("Invalid params: unknown subscription");
+        resp["error"] = err;
+        return resp;
+    }
+
+    unwatchAll(subscriptionId);
+    m_subs.erase(it);
+
+    QJsonObject r; r["ok"] = true;
+    resp["result"] = r;
+    return resp;
+}
+
+void QtHelloServer::connectionClosed(quint64 conn) {
+    for (auto it = m_subs.begin(); it != m_subs.end();) {
+        if (it->conn == conn) {
+            unwatchAll(it.key());
+            it = m_subs.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    dropShadow(conn);
+    dropSession(conn);
+}
+
+QObject* QtHelloServer::watchableForId(int id) {
+    // Plain QGraphicsItems are not QObjects and cannot be watched; QGraphicsObjects can.
+    if (QGraphicsItem* gi = gitemForId(id))
+        return gi->toGraphicsObject();
+    return objectForId(id);
+}
+
+void QtHelloServer::watchObject(QObject* obj, int subId, bool subtree) {
+    if (!obj) return;
+    QGraphicsObject* go = qobject_cast<QGraphicsObject*>(obj);
+
+    Watch& w = m_watched[obj];
+    if (w.subs.isEmpty()) {
+        obj->installEventFilter(this);
+        // Only watched objects get a destroyed connection; the id must be captured now
+        // because the object can no longer be looked up once destruction has started.
+        const int id = ensureIdFor(obj);
+        w.destroyed = connect(obj, &QObject::destroyed, this, [this, obj, id]() { dropIdFor(obj, id); });
+        if (go)
+            watchGraphicsObject(go, id, w);
+    }
+    w.subs.insert(subId);
+
+    if (subtree) {
+        if (go) {
+            const QList<QGraphicsItem*> kids = go->childItems();
+            for (QGraphicsItem* ch : kids)
+                watchObject(ch->toGraphicsObject(), subId, true);
+        } else {
+            const QObjectList kids = obj->children();
+            for (QObject* ch : kids)
+                watchObject(ch, subId, true);
+        }
+    }
+}
+
+void QtHelloServer::watchGraphicsObject(QGraphicsObject* go, int id, Watch& w) {
+    // Graphics items get no QWidget-style events; QGraphicsObject reports the same changes
+    // through signals.
+    auto note = [this, go, id](quint32 change) { noteChange(go, id, change); };
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::visibleChanged, this,
+                                    [go, note]() { note(go->isVisible() ? ChangeShow : ChangeHide); }));
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::enabledChanged, this, [note]() { note(ChangeEnabled); }));
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::xChanged, this, [note]() { note(ChangeMove); }));
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::yChanged, this, [note]() { note(ChangeMove); }));
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::widthChanged, this, [note]() { note(ChangeResize); }));
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::heightChanged, this, [note]() { note(ChangeResize); }));
+    w.itemSignals.push_back(connect(go, &QGraphicsObject::childrenChanged, this, [this, go, note]() {
+        // Extend subtree subscriptions to child items added after subscribing.
+        const QSet<int> subs = m_watched.value(go).subs;
+        const QList<QGraphicsItem*> kids = go->childItems();
+        for (int subId : subs) {
+            auto it = m_subs.constFind(subId);
+            if (it == m_subs.constEnd() || !it->subtree) continue;
+            for (QGraphicsItem* ch : kids) {
+                QGraphicsObject* cgo = ch->toGraphicsObject();
+                if (cgo && !m_watched.value(cgo).subs.contains(subId))
+                    watchObject(cgo, subId, true);
+            }
+        }
+        note(ChangeChildren);
+    }));
+}
+
+void QtHelloServer::unwatchAll(int subId) {
+    for (auto it = m_watched.begin(); it != m_watched.end();) {
+        it->subs.remove(subId);
+        if (it->subs.isEmpty()) {
+            if (!m_shadowed.contains(m_ids.find(it.key())))
+                it.key()->removeEventFilter(this);
+            disconnect(it->destroyed);
+            for (const QMetaObject::Connection& c : qAsConst(it->itemSignals))
+                disconnect(c);
+            it = m_watched.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+bool QtHelloServer::eventFilter(QObject* watched, QEvent* event) {
+    quint32 change = 0;
+    switch (event->type()) {
+    case QEvent::Show:              change = ChangeShow; break;
+    case QEvent::Hide:              change = ChangeHide; break;
+    case QEvent::EnabledChange:     change = ChangeEnabled; break;
+    case QEvent::WindowTitleChange: change = ChangeTitle; break;
+    case QEvent::Move:              change = ChangeMove; break;
+    case QEvent::Resize:            change = ChangeResize; break;
+    case QEvent::ChildAdded:
+    case QEvent::ChildRemoved:      change = ChangeChildren; break;
+    default: break;
+    }
+
+    if (change && m_watched.contains(watched)) {
+        // Extend subtree subscriptions to children added after subscribing.
+        if (event->type() == QEvent::ChildAdded) {
+            QObject* child = static_cast<QChildEvent*>(event)->child();
+            const QSet<int> subs = m_watched.value(watched).subs;
+            for (int subId : subs) {
+                auto it = m_subs.constFind(subId);
+                if (it != m_subs.constEnd() && it->subtree)
+                    watchObject(child, subId, true);
+            }
+        }
+        noteChange(watched, ensureIdFor(watched), change);
+    }
+
+    if (!m_shadows.isEmpty()) {
+        // Geometry, visibility, state and children; repaints say nothing about the summary.
+        // Graphics views report scene changes separately (watchShadowedView).
+        quint8 dirty = 0;
+        switch (event->type()) {
+        case QEvent::ChildAdded:
+        case QEvent::ChildRemoved:          dirty = DirtyChildren; break;
+        case QEvent::Move:                  dirty = DirtySelf | DirtyDeep; break; // global rects of descendants
+        case QEvent::Show:
+        case QEvent::Hide:
+        case QEvent::EnabledChange:
+        case QEvent::WindowTitleChange:
+        case QEvent::FontChange:
+        case QEvent::DynamicPropertyChange: dirty = DirtySelf; break;
+        case QEvent::Resize:
+            // A resized view may show its scene at another place (alignment).
+            dirty = qobject_cast<QGraphicsView*>(watched) ? DirtySelf | DirtyDeep : DirtySelf;
+            break;
+        default: break;
+        }
+        if (dirty)
+            markShadowDirty(m_ids.find(watched), dirty);
+    }
+    return QObject::eventFilter(watched, event);
+}
+
+void QtHelloServer::noteChange(QObject* obj, int id, quint32 event) {
+    const QSet<int> subs = m_watched.value(obj).subs;
+    bool any = false;
+    for (int subId : subs) {
+        auto it = m_subs.find(subId);
+        if (it == m_subs.end() || !(it->events & event)) continue;
+        it->pending[id] |= event;
+        any = true;
+    }
+
+    if (event == ChangeDestroyed) {
+        for (int subId : subs) {
+            auto it = m_subs.find(subId);
+            if (it != m_subs.end()) it->roots.remove(id);
+        }
+        m_watched.remove(obj);
+    }
+
+    // Coalesce everything that happens within one event-loop pass into one frame per subscription.
+    if (any && !m_flushScheduled) {
+        m_flushScheduled = true;
+        QMetaObject::invokeMethod(this, [this]() { flushChanges(); }, Qt::QueuedConnection);
+    }
+}
+
+void QtHelloServer::flushChanges() {
+    m_flushScheduled = false;
+
+    for (auto it = m_subs.begin(); it != m_subs.end(); ++it) {
+        Subscription& sub = it.value();
+        if (sub.pending.isEmpty()) continue;
+
+        QJsonArray changes;
+        for (auto p = sub.pending.constBegin(); p != sub.pending.constEnd(); ++p) {
+            QJsonObject change;
+            change["id"]     = p.key();
+            change["events"] = change_events_to_array(p.value());
+            if (!(p.value() & ChangeDestroyed)) {
+                if (QGraphicsItem* gi = gitemForId(p.key()))
+                    change["element"] = summarizeGraphicsItem(gi, sub.fields);
+                else if (QObject* obj = objectForId(p.key()))
+                    change["element"] = summarizeObject(obj, sub.fields);
+            }
+            changes.push_back(change);
+        }
+        sub.pending.clear();
+
+        QJsonObject params;
+        params["subscription"] = it.key();
+        params["changes"]      = changes;
+        QJsonObject frame;
+        frame["method"] = QStringLiteral("elements.changed");
+        frame["params"] = params;
+        sub.push(frame);
+    }
+}
+
+// ----------------- incremental tree snapshots -----------------
+
+QtHelloServer::RequestJob QtHelloServer::treeDeltaJob(quint64 conn, int requestId, const QJsonObject& params) {
+    struct State {
+        bool started = false;
+        bool full = false;
+        TreeWalk walk;          // the whole tree, or subtrees that appeared since the last delta
+        ShadowRescans rescans;  // incremental: nodes to compare with the UI again
+        ShadowDelta out;
+    };
+    auto st = std::make_shared<State>();
+
+    const int rootId     = params.value("id").toInt(0);
+    const int maxDepth   = params.value("max_depth").toInt(-1);
+    const quint32 fields = parse_fields(params.value("fields"));
+    const quint64 since  = static_cast<quint64>(params.value("since").toDouble(0));
+
+    return [this, st, conn, requestId, rootId, maxDepth, fields, since](qint64 budgetNs, QJsonObject& resp) {
+        resp["id"] = requestId;
+        QElapsedTimer slice;
+        slice.start();
+
+        if (!st->started) {
+            st->started = true;
+            auto it = m_shadows.find(conn);
+            st->full = it == m_shadows.end() || since == 0 || it->version != since ||
+                       it->rootId != rootId || it->maxDepth != maxDepth || it->fields != fields;
+
+            if (st->full) {
+                // Unknown or outdated base: start over and report the whole tree as added.
+                dropShadow(conn);
+                TreeShadow& sh = m_shadows[conn];
+                sh.rootId   = rootId;
+                sh.maxDepth = maxDepth;
+                sh.fields   = fields;
+                if (rootId == 0) {
+                    ShadowNode top;
+                    top.parent = -1;
+                    top.depth  = -1;
+                    sh.nodes.insert(0, top);
+                }
+                if (!startWalk(st->walk, rootId, maxDepth, fields)) {
+                    dropShadow(conn);
+                    QJsonObject err;
+                    err["code"] = -32602;
+                    err["message"] = QStringLiteral("Invalid params: unknown id");
+                    resp["error"] = err;
+                    return true;
+                }
+            } else {
+                applySceneChanges(*it);
+                QHash<int, quint8> dirty;
+                dirty.swap(it->dirty);
+                // Appearing/disappearing top-levels send no event to anything we track.
+                if (it->rootId == 0)
+                    dirty[0] |= DirtyChildren;
+                for (auto d = dirty.constBegin(); d != dirty.constEnd(); ++d)
+                    st->rescans.enqueue(qMakePair(d.key(), d.value()));
+                st->walk.maxDepth = maxDepth;
+                st->walk.fields   = fields;
+            }
+        }
+
+        // The shadow goes away together with the session, and with it this job. Changes seen
+        // between slices land in sh.dirty and are picked up by the next delta.
+        TreeShadow& sh = m_shadows[conn];
+        while (!st->rescans.isEmpty()) {
+            if (budgetNs > 0 && slice.nsecsElapsed() >= budgetNs)
+                return false;
+            const QPair<int, quint8> r = st->rescans.dequeue();
+            shadowRescan(sh, r.first, r.second, st->out, st->rescans, st->walk);
+        }
+        const qint64 left = budgetNs > 0 ? qMax<qint64>(1, budgetNs - slice.nsecsElapsed()) : 0;
+        const bool done = stepWalk(st->walk, [&](QJsonObject& node, int parent, int depth) {
+            shadowInsert(sh, node, parent, depth, st->out);
+            return true;
+        }, left);
+        if (!done)
+            return false;
+
+        const ShadowDelta& out = st->out;
+        if (st->full || !out.added.isEmpty() || !out.modified.isEmpty() || !out.removed.isEmpty())
+            sh.version = m_nextShadowVersion++;
+
+        auto node = [&sh](int id) {
+            const ShadowNode& n = sh.nodes[id];
+            QJsonObject o = n.summary;
+            o["parent"] = n.parent;
+            o["depth"]  = n.depth;
+            return o;
+        };
+        QJsonArray added, modified, removed;
+        QSet<int> addedLeft = out.addedSet;
+        for (int id : out.added) {
+            if (addedLeft.remove(id) && sh.nodes.contains(id))
+                added.push_back(node(id));
+        }
+        for (int id : out.modified) {
+            if (out.modifiedSet.contains(id) && sh.nodes.contains(id))
+                modified.push_back(node(id));
+        }
+        for (int id : out.removed)
+            removed.push_back(id);
+
+        // Clients apply "removed", then "added", then "modified".
+        QJsonObject result;
+        result["version"]  = static_cast<double>(sh.version);
+        result["full"]     = st->full;
+        result["added"]    = added;
+        result["modified"] = modified;
+        result["removed"]  = removed;
+        resp["result"] = result;
+        return true;
+    };
+}
+
+void QtHelloServer::shadowInsert(TreeShadow& sh, const QJsonObject& node, int parent, int depth, ShadowDelta& out) {
+    const int id = node.value("id").toInt(0);
+    if (id <= 0 || sh.nodes.contains(id)) return; // reachable through another parent
+    // Queued under a parent that has been removed since (the delta spans several slices).
+    if (depth > 0 && !sh.nodes.contains(parent)) return;
+
+    ShadowNode n;
+    n.parent  = parent;
+    n.depth   = depth;
+    n.summary = node;
+    auto p = sh.nodes.find(parent);
+    if (QGraphicsItem* gi = gitemForId(id)) {
+        // Below a view, or below another item of the same view.
+        n.view = (p != sh.nodes.end() && p->view) ? p->view : parent;
+        n.sceneRect = gi->sceneBoundingRect();
+    } else if (QObject* obj = objectForId(id)) {
+        n.tracked = true;
+        if (m_shadowed[id]++ == 0) {
+            obj->installEventFilter(this);
+            if (auto view = qobject_cast<QGraphicsView*>(obj))
+                watchShadowedView(view, id);
+        }
+    }
+    if (p != sh.nodes.end())
+        p->children.push_back(id);
+    sh.nodes.insert(id, n);
+
+    out.added.push_back(id);
+    out.addedSet.insert(id);
+}
+
+void QtHelloServer::shadowAddSubtree(TreeShadow& sh, const QJsonObject& first, int parent, int depth, ShadowDelta& out,
+                                     TreeWalk& added) {
+    const int id = first.value("id").toInt(0);
+    // Keep the summary the parent's enumeration produced (top-levels are summarized differently).
+    shadowInsert(sh, first, parent, depth, out);
+    if (!sh.nodes.contains(id) || (sh.maxDepth >= 0 && depth >= sh.maxDepth)) return;
+
+    // The rest of the subtree is walked by the delta job, with depths counted from the shadow's root.
+    QVector<int> kids;
+    collectChildIds(id, kids);
+    for (int kid : kids)
+        added.queue.enqueue({ kid, id, depth + 1, TreeObjects, false });
+}
+
+void QtHelloServer::shadowRemove(TreeShadow& sh, int id, ShadowDelta& out) {
+    auto it = sh.nodes.find(id);
+    if (it == sh.nodes.end()) return;
+    const ShadowNode n = it.value();
+
+    for (int c : n.children) {
+        auto k = sh.nodes.constFind(c);
+        if (k != sh.nodes.constEnd() && k->parent == id)
+            shadowRemove(sh, c, out);
+    }
+    if (n.tracked)
+        untrackShadowed(id);
+
+    sh.nodes.remove(id);
+    sh.dirty.remove(id);
+    out.modifiedSet.remove(id);
+    // Something added within this delta just disappears from it again.
+    if (id != 0 && !out.addedSet.remove(id))
+        out.removed.push_back(id);
+}
+
+void QtHelloServer::noteShadowModified(int id, ShadowDelta& out) {
+    if (out.addedSet.contains(id) || out.modifiedSet.contains(id)) return;
+    out.modified.push_back(id);
+    out.modifiedSet.insert(id);
+}
+
+void QtHelloServer::shadowRescan(TreeShadow& sh, int id, quint8 dirty, ShadowDelta& out, ShadowRescans& rescans,
+                                 TreeWalk& added) {
+    auto it = sh.nodes.find(id);
+    if (it == sh.nodes.end()) return; // removed together with an ancestor
+    const int parent = it->parent;
+    const int depth  = it->depth;
+
+    if (id != 0) {
+        const QJsonObject s = summarizeId(id, sh.fields, TreeObjects, parent == 0 && sh.rootId == 0);
+        if (s.isEmpty()) {
+            shadowRemove(sh, id, out);
+            return;
+        }
+        if (s != it->summary) {
+            it->summary = s;
+            noteShadowModified(id, out);
+        }
+        if (it->view) {
+            if (QGraphicsItem* gi = gitemForId(id))
+                it->sceneRect = gi->sceneBoundingRect();
+        }
+    }
+
+    if (!(dirty & (DirtyChildren | DirtyDeep))) return;
+    if (sh.maxDepth >= 0 && depth >= sh.maxDepth) return;
+
+    QVector<int> ids;
+    if (id == 0)
+        collectRootIds(ids);
+    else
+        collectChildIds(id, ids);
+
+    // Children already in the shadow are compared by id only: changes to them are reported
+    // on their own (events, scene changes), so a view with many items is not summarized
+    // again just because one item appeared.
+    SceneTransformCache scenes;
+    QVector<int> now;
+    now.reserve(ids.size());
+    for (int kidId : qAsConst(ids)) {
+        if (kidId <= 0) continue;
+        auto k = sh.nodes.find(kidId);
+        if (k != sh.nodes.end() && k->parent != id) {
+            // Reparented: report it as removed from the old place and added here.
+            shadowRemove(sh, kidId, out);
+            k = sh.nodes.end();
+        }
+
+        if (k == sh.nodes.end()) {
+            const QJsonObject kid = summarizeId(kidId, sh.fields, TreeObjects, id == 0, &scenes);
+            if (kid.isEmpty()) continue;
+            shadowAddSubtree(sh, kid, id, depth + 1, out, added);
+        } else if (dirty & DirtyDeep) {
+            rescans.enqueue(qMakePair(kidId, quint8(DirtyDeep)));
+        }
+        now.push_back(kidId);
+    }
+
+    // The hash may have grown meanwhile, so look the node up again.
+    it = sh.nodes.find(id);
+    if (it == sh.nodes.end()) return;
+    const QVector<int> before = it->children;
+    const QSet<int> present(now.cbegin(), now.cend());
+    for (int c : before) {
+        if (present.contains(c)) continue;
+        auto k = sh.nodes.constFind(c);
+        if (k != sh.nodes.constEnd() && k->parent == id)
+            shadowRemove(sh, c, out);
+    }
+
+    it = sh.nodes.find(id);
+    if (it != sh.nodes.end())
+        it->children = now;
+}
+
+void QtHelloServer::markShadowDirty(int id, quint8 dirty) {
+    if (!id || !m_shadowed.contains(id)) return;
+    for (auto it = m_shadows.begin(); it != m_shadows.end(); ++it) {
+        if (it->nodes.contains(id))
+            it->dirty[id] |= dirty;
+    }
+}
+
+void QtHelloServer::watchShadowedView(QGraphicsView* view, int id) {
+    QVector<QMetaObject::Connection>& c = m_shadowedViews[id];
+    if (QGraphicsScene* sc = view->scene()) {
+        c.push_back(connect(sc, &QGraphicsScene::changed, this, [this, id](const QList<QRectF>& rects) {
+            noteSceneChanged(id, rects);
+        }));
+    }
+    // Scrolling (and zooming, which rescales the scroll bars) moves every item on screen.
+    const auto scrolled = [this, id]() { markShadowDirty(id, DirtyDeep); };
+    c.push_back(connect(view->horizontalScrollBar(), &QAbstractSlider::valueChanged, this, scrolled));
+    c.push_back(connect(view->verticalScrollBar(), &QAbstractSlider::valueChanged, this, scrolled));
+}
+
+void QtHelloServer::noteSceneChanged(int viewId, const QList<QRectF>& rects) {
+    for (auto it = m_shadows.begin(); it != m_shadows.end(); ++it) {
+        if (!it->nodes.contains(viewId)) continue;
+        QVector<QRectF>& pending = it->sceneChanges[viewId];
+        for (const QRectF& r : rects)
+            pending.push_back(r);
+        // Past a few dozen regions, one index lookup for all of them is cheaper.
+        if (pending.size() > 32) {
+            QRectF all;
+            for (const QRectF& r : qAsConst(pending))
+                all |= r;
+            pending = { all };
+        }
+    }
+}
+
+void QtHelloServer::applySceneChanges(TreeShadow& sh) {
+    QHash<int, QVector<QRectF>> changes;
+    changes.swap(sh.sceneChanges);
+    for (auto c = changes.constBegin(); c != changes.constEnd(); ++c) {
+        const int viewId = c.key();
+        const QVector<QRectF>& rects = c.value();
+        auto view = qobject_cast<QGraphicsView*>(objectForId(viewId));
+        if (!view || !view->scene() || !sh.nodes.contains(viewId)) continue;
+
+        // Items in a changed region now: the item itself if the shadow has it, otherwise
+        // its nearest ancestor there (or the view) got a new child.
+        for (const QRectF& r : rects) {
+            const auto items = view->scene()->items(r);
+            for (QGraphicsItem* gi : items) {
+                QGraphicsItem* p = gi;
+                int known = 0;
+                for (; p; p = p->parentItem()) {
+                    known = m_ids.findItem(p);
+                    if (known && sh.nodes.contains(known)) break;
+                }
+                if (!p)
+                    sh.dirty[viewId] |= DirtyChildren;
+                else
+                    sh.dirty[known] |= p == gi ? DirtySelf | DirtyChildren : DirtyChildren;
+            }
+        }
+
+        // Items that were in a changed region: moved, resized or gone.
+        for (auto n = sh.nodes.constBegin(); n != sh.nodes.constEnd(); ++n) {
+            if (n->view != viewId) continue;
+            for (const QRectF& r : rects) {
+                if (r.intersects(n->sceneRect)) {
+                    sh.dirty[n.key()] |= DirtySelf | DirtyChildren;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+void QtHelloServer::untrackShadowed(int id) {
+    auto it = m_shadowed.find(id);
+    if (it == m_shadowed.end() || --it.value() > 0) return;
+    m_shadowed.erase(it);
+    for (const QMetaObject::Connection& c : m_shadowedViews.take(id))
+        disconnect(c);
+    // A dead object's id no longer resolves; its filter went with it.
+    QObject* obj = objectForId(id);
+    if (obj && !m_watched.contains(obj))
+        obj->removeEventFilter(this);
+}
+
+void QtHelloServer::dropShadow(quint64 conn) {
+    auto it = m_shadows.find(conn);
+    if (it == m_shadows.end()) return;
+    for (auto n = it->nodes.constBegin(); n != it->nodes.constEnd(); ++n) {
+        if (n->tracked)
+            untrackShadowed(n.key());
+    }
+    m_shadows.erase(it);
 }
@@ -2,18 +2,37 @@
 
 #include <QObject>
 #include <QHostAddress>
-#include <QTcpSocket>
 #include <QJsonDocument>
 #include <QJsonObject>
+#include <QJsonArray>
 #include <QHash>
 #include <QPointer>
 #include <QAccessible>
 #include <QSet>
 #include <QGraphicsItem>
-// #include <QQuickItem>
+#include <QElapsedTimer>
+#include <QModelIndex>
+#include <QList>
+#include <QVector>
+#include <QQueue>
+#include <QPair>
+#include <QTransform>
+
+#include <functional>
+#include <memory>
+
+#include "qt_id_table.h"
+#include "qt_property_reader.h"
+
+#ifdef INJECTLIB_HAVE_QUICK
+class QQuickItem;
+#endif
 
 // Forward declarations to keep the header lightweight.
-class QTcpServer;
+class QThread;
+class QtNetWorker;
+class QAbstractItemView;
+class QGraphicsView;
 
 class QtHelloServer : public QObject {
     Q_OBJECT
@@ -32,75 +51,351 @@ public:
     /// Whether the server is currently listening.
     bool isRunning() const noexcept;
 
-    /// The bound port (0 if not running).
+    /// The bound port (0 if not running or listening on a local socket).
     quint16 port() const noexcept;
 
+    /// Full name of the local socket (socket path / pipe name) with QT_INJECTED_TRANSPORT=local,
+    /// empty otherwise.
+    QString localServerName() const noexcept;
+
     /// The address we bind to (defaults to QHostAddress::LocalHost).
     QHostAddress bindAddress() const noexcept;
 
+    /// The worker owning the sockets on the network thread (nullptr if not running).
+    QtNetWorker* netWorker() const noexcept;
+
+    /// A parsed request handed over from the network thread.
+    struct PendingRequest {
+        QJsonObject req;
+        std::function<void(const QJsonObject&)> reply; // invoked on the GUI thread with the response
+        std::function<void(const QJsonObject&)> push;  // unsolicited frames to the same connection
+        quint64 conn = 0;                              // connection the request came from
+        QElapsedTimer queued;                          // started when the frame was parsed
+        int statSlot = 0;                              // ServerStats::methodIndex of the method
+    };
+
+    /// Queues a request for the GUI thread. Connections are served round-robin; cheap methods
+    /// (elements.info, click, ...) overtake queued bulk work, and subtree walks run in slices
+    /// so other connections get in between. GUI thread only.
+    void submit(const PendingRequest& pending);
+
+    /// Dispatches one parsed request and returns the full response object.
+    /// GUI thread only: this is the part the network thread marshals over.
+    QJsonObject handleRequest(const PendingRequest& pending);
+
+    /// Drops per-connection state (queued requests, subscriptions, snapshots). GUI thread only.
+    void connectionClosed(quint64 conn);
+
+    /// Answers a ping; touches no widgets, so it is safe on any thread.
+    static QJsonObject handlePing(int requestId);
+
+    /// Summary fields that can be requested via the "fields" parameter.
+    /// Summarizers only compute what is set in the mask; the id is always reported.
+    enum SummaryField : quint32 {
+        FieldId          = 1u << 0,
+        FieldName        = 1u << 1,
+        FieldClass       = 1u << 2,
+        FieldControlType = 1u << 3,
+        FieldRect        = 1u << 4,
+        FieldVisible     = 1u << 5,
+        FieldEnabled     = 1u << 6,
+        FieldAutoId      = 1u << 7,
+        FieldPid         = 1u << 8,
+        FieldRole        = 1u << 9,  // accessible tree only
+        FieldValue       = 1u << 10, // accessible tree only
+        FieldState       = 1u << 11, // accessible tree only
+        FieldsAll        = (1u << 12) - 1
+    };
+
+    /// Traversal engine for elements.roots/children/tree/find/info ("tree_mode" parameter).
+    /// Objects walks QWidget/QWindow/QGraphicsItem children; Accessible walks QAccessible
+    /// interfaces, which also reaches item view cells and custom-painted controls that
+    /// implement an accessible interface, at a higher cost per node. Elements backed by an
+    /// object have the same id in both trees.
+    enum TreeMode {
+        TreeObjects,
+        TreeAccessible
+    };
+
+    /// Change kinds reported by elements.subscribe notifications.
+    enum ChangeEvent : quint32 {
+        ChangeShow      = 1u << 0,
+        ChangeHide      = 1u << 1,
+        ChangeEnabled   = 1u << 2,
+        ChangeTitle     = 1u << 3,
+        ChangeMove      = 1u << 4,
+        ChangeResize    = 1u << 5,
+        ChangeChildren  = 1u << 6,
+        ChangeDestroyed = 1u << 7,
+        ChangeAll       = (1u << 8) - 1
+    };
+
 public slots:
-    /// Create and start the QTcpServer on the Qt thread.
-    /// Binds to bindAddress():ephemeral_port (port 0). Emits started(port) on success.
+    /// Start the network thread and listen there on bindAddress():QT_INJECTED_SERVER_PORT, or on
+    /// the local socket QT_INJECTED_LOCAL_NAME (default "injectlib-qt-<pid>") with
+    /// QT_INJECTED_TRANSPORT=local. Must be called on the Qt (GUI) thread.
+    /// Emits started(port) or startedLocal(name) on success.
     void start();
 
-    /// Stop listening and close all client sockets. Emits stopped() when done.
+    /// Stop listening, close all client sockets and join the network thread. Emits stopped() when done.
     void stop();
 
 signals:
     void started(quint16 port);
+    void startedLocal(const QString& fullServerName);
     void stopped();
 
+protected:
+    bool eventFilter(QObject* watched, QEvent* event) override;
+
 private:
     explicit QtHelloServer(QObject* parent = nullptr);
     Q_DISABLE_COPY(QtHelloServer)
 
     
-    // handlers for requests
-    void handlePing(QTcpSocket* sock, int requestId);
-    void handleAppInfo(QTcpSocket* sock, int requestId);
-    void handleElementsRoots(QTcpSocket* sock, int requestId);
-    void handleElementsChildren(QTcpSocket* sock, int requestId, int parentId);
-    void handleElementInfo(QTcpSocket* sock, int requestId, int id);
-    void handleElementClick(QTcpSocket* sock, int requestId, int id);
-    void handleElementSetText(QTcpSocket* sock, int requestId, int id, const QString& text);
+    // options of the batched subtree walk ("elements.tree")
+    struct TreeOptions {
+        int rootId = 0;       // 0 means "all top-level elements"
+        int maxDepth = -1;    // < 0 means unlimited
+        int maxNodes = 0;     // <= 0 means unlimited
+        quint32 fields = FieldsAll;
+        TreeMode mode = TreeObjects;
+    };
+
+    // handlers for requests (GUI thread), each returns the complete response
+    QJsonObject dispatchRequest(const PendingRequest& pending);
+    QJsonObject handleAppInfo(int requestId);
+    QJsonObject handleSessionLimits(const PendingRequest& pending, int requestId, const QJsonObject& params);
+    QJsonObject handleElementInfo(int requestId, int id, quint32 fields, TreeMode mode);
+    QJsonObject handleElementClick(int requestId, int id);
+    QJsonObject handleElementSetText(int requestId, int id, const QString& text);
+    QJsonObject handleActionsBatch(int requestId, const QJsonObject& params);
+    QJsonObject handleModelInfo(int requestId, const QJsonObject& params);
+    QJsonObject handleModelRows(int requestId, const QJsonObject& params);
+    QJsonObject handleSceneItemAt(int requestId, const QJsonObject& params);
+    QJsonObject handleElementFromPoint(int requestId, const QJsonObject& params);
+    QJsonObject handleElementProperties(int requestId, const QJsonObject& params);
+    QJsonObject handleSubscribe(const PendingRequest& pending, int requestId, const QJsonObject& params);
+    QJsonObject handleUnsubscribe(const PendingRequest& pending, int requestId, int subscriptionId);
 
     // helpers
-    void sendJson(QTcpSocket* sock, const QJsonObject& obj);
     static bool waitForQCoreApp(int totalMs = 30000, int pollMs = 100);
-    // bool startImpl(const QHostAddress& addr, quint16 port0);
+    void stopNetThread();
+
+    // GUI-side request scheduling. Every connection has a session with its own fast and bulk
+    // queue; a conn id sits in m_fastTurn/m_bulkTurn while its queue has work, and each pass
+    // serves those lists round-robin: all fast requests, one per session per round, then one
+    // bulk slice of at most m_sliceNs for the next session in turn.
 
-    void onNewConnection();
+    /// Advances a request that is handled in slices. budgetNs <= 0 runs it to the end.
+    /// Returns true once resp holds the complete response.
+    using RequestJob = std::function<bool(qint64 budgetNs, QJsonObject& resp)>;
+    struct Session;                                   // defined in qt_server.cpp
+    QHash<quint64, std::shared_ptr<Session>> m_sessions;
+    QList<quint64> m_fastTurn;
+    QList<quint64> m_bulkTurn;
+    bool   m_drainScheduled = false;
+    qint64 m_sliceNs = 10 * 1000 * 1000;              // QT_INJECTED_SLICE_MS
+    int    m_sessionMaxNodes = 0;                     // QT_INJECTED_SESSION_MAX_NODES, 0 = unlimited
+
+    Session& session(quint64 conn);
+    void dropSession(quint64 conn);
+    void scheduleDrain();
+    void drainRequests();
+    void runBulkSlice(quint64 conn);
+    void runRequest(const PendingRequest& pending);
+    void completeRequest(const PendingRequest& pending, QJsonObject& resp, qint64 waitNs, qint64 busyNs, int slices);
+    RequestJob makeJob(const PendingRequest& pending);
+    QJsonObject runToEnd(const PendingRequest& pending); // a makeJob() request in one slice
+    /// Streamed replies ("stream": true on elements.tree/find): every chunkSize nodes/matches
+    /// go out right away as a chunk frame through push, the final response carries the rest.
+    struct StreamSink {
+        std::function<void(const QJsonObject&)> push;
+        int chunkSize = 0; // <= 0: no streaming
+    };
+    RequestJob treeJob(int requestId, const TreeOptions& opts, const StreamSink& stream = StreamSink());
+    RequestJob findJob(int requestId, const QJsonObject& params, Session* s, int maxVisited,
+                       const StreamSink& stream = StreamSink());
+    /// elements.roots (roots) or elements.children of parentId: ids first, then the summaries.
+    RequestJob childrenJob(int requestId, int parentId, bool roots, quint32 fields, TreeMode mode);
+    RequestJob sceneItemsJob(int requestId, const QJsonObject& params);
+    RequestJob treeDeltaJob(quint64 conn, int requestId, const QJsonObject& params);
+    static TreeOptions parseTreeOptions(const QJsonObject& params);
 
-    QTcpServer*  m_server{nullptr};
+    QThread*     m_netThread{nullptr};
+    QtNetWorker* m_net{nullptr};
     QHostAddress m_bindAddr{QHostAddress::LocalHost};
     quint16      m_port{0};
+    QString      m_localName;
 
-    // id map
-    QHash<int, QPointer<QObject>> m_id2obj;
-    QHash<QObject*, int>          m_obj2id;
-    int m_nextId = 1;
+    // UI actions (elements.click/setText, actions.batch): validated while handling the
+    // request, applied later from the event loop so the reply never waits for a modal dialog.
+    using DeferredAction = std::function<void()>;
+    int m_maxBatchActions = 1000;
 
-    int ensureIdFor(QObject* obj);
-    void dropIdFor(QObject* obj);
-    QObject* objectForId(int id) const;
+    bool prepareClick(int id, DeferredAction& action, QJsonObject& error);
+    bool prepareSetText(int id, const QString& text, DeferredAction& action, QJsonObject& error);
 
+    // item view models (model.info/model.rows)
+    int m_maxModelPage = 1000;   // rows per model.rows, QT_INJECTED_MAX_MODEL_PAGE
+    int m_maxModelCells = 20000; // rows x columns per model.rows, QT_INJECTED_MAX_MODEL_CELLS
+    bool resolveModelTarget(const QJsonObject& params, QAbstractItemView*& view, QModelIndex& parent, QJsonObject& error);
 
-    // ---------- ID space for QGraphicsItem* (not QObject) ----------
-    struct GItemMaps {
-        QHash<QGraphicsItem*, int> gitem2id;
-        QHash<int, QGraphicsItem*> id2gitem;
-        int nextId = 1000000; // will be offset below so it doesn't collide with QObject IDs
-    };
-    GItemMaps gmaps;
+    // graphics scenes (scene.items/scene.itemAt)
+    int m_maxScenePage = 1000;
+
+    // batched property reads (elements.properties), also used for Qt Quick item names
+    injectlib::PropertyReader m_props;
+    int m_maxPropertyReads = 10000; // ids x properties per request, QT_INJECTED_MAX_PROPERTY_READS
+
+    // id map (QObjects and QGraphicsItems share one id space)
+    ElementIdTable m_ids;
+
+    int ensureIdFor(QObject* obj);
+    void dropIdFor(QObject* obj, int id);
+    QObject* objectForId(int id);
 
     int ensureIdForGItem(QGraphicsItem* it);
     QGraphicsItem* gitemForId(int id);
 
+    // accessible interfaces: object-backed ones share the object's id, others (cells, ...)
+    // are registered by QAccessible::Id, which Qt keeps stable for the interface's lifetime
+    int ensureIdForAccessible(QAccessibleInterface* iface);
+    QAccessibleInterface* accessibleForId(int id);
+
+    // ---------- change notifications (elements.subscribe) ----------
+    struct Subscription {
+        quint64 conn = 0;
+        std::function<void(const QJsonObject&)> push;
+        QSet<int> roots;            // subscribed element ids
+        bool subtree = false;       // also watch all descendants (including ones added later)
+        quint32 events = ChangeAll;
+        quint32 fields = FieldsAll;
+        QHash<int, quint32> pending; // element id -> events seen since the last flush
+    };
+    struct Watch {
+        QSet<int> subs;                      // subscriptions watching the object
+        QMetaObject::Connection destroyed;   // reports ChangeDestroyed through dropIdFor()
+        QVector<QMetaObject::Connection> itemSignals; // QGraphicsObject change signals
+    };
+    QHash<int, Subscription>     m_subs;
+    QHash<QObject*, Watch>       m_watched;
+    int  m_nextSubId = 1;
+    bool m_flushScheduled = false;
+
+    QObject* watchableForId(int id);
+    void watchObject(QObject* obj, int subId, bool subtree);
+    void watchGraphicsObject(QGraphicsObject* go, int id, Watch& w);
+    void unwatchAll(int subId);
+    void noteChange(QObject* obj, int id, quint32 event);
+    void flushChanges();
+
+    // ---------- incremental tree snapshots (elements.treeDelta) ----------
+    enum ShadowDirty : quint8 {
+        DirtySelf     = 1u << 0, // summary may have changed
+        DirtyChildren = 1u << 1, // direct children may have been added/removed
+        DirtyDeep     = 1u << 2  // whole subtree (moved window, scrolled graphics view)
+    };
+    struct ShadowNode {
+        int parent = 0;
+        int depth = 0;
+        bool tracked = false;     // counted in m_shadowed (objects; graphics items get no events)
+        QJsonObject summary;      // as last reported, without parent/depth
+        QVector<int> children;
+        int view = 0;             // graphics items: the view they were reached through
+        QRectF sceneRect;         // graphics items: bounding rect when last summarized
+    };
+    /// What a client was last told about a tree; one per connection.
+    struct TreeShadow {
+        int rootId = 0;           // 0: all top-levels, kept under a virtual node 0
+        int maxDepth = -1;
+        quint32 fields = FieldsAll;
+        quint64 version = 0;      // version handed to the client with the last delta
+        QHash<int, ShadowNode> nodes;
+        QHash<int, quint8> dirty; // id -> ShadowDirty bits seen since the last delta
+        QHash<int, QVector<QRectF>> sceneChanges; // view id -> changed scene regions since the last delta
+    };
+    /// Ids touched by one delta, in discovery order (parents before children). Nodes are
+    /// reported from the final shadow state, so an element added and removed again within
+    /// one delta does not show up at all.
+    struct ShadowDelta {
+        QVector<int> added, modified, removed;
+        QSet<int> addedSet, modifiedSet;
+    };
+    QHash<quint64, TreeShadow> m_shadows;
+    QHash<int, int>            m_shadowed;  // object id -> number of shadow nodes tracking it
+    QHash<int, QVector<QMetaObject::Connection>> m_shadowedViews; // graphics views among them
+    quint64 m_nextShadowVersion = 1;
+
+    /// Nodes to compare with the UI again, in the order a delta gets to them.
+    using ShadowRescans = QQueue<QPair<int, quint8>>;
+    struct TreeWalk;
+    void shadowInsert(TreeShadow& sh, const QJsonObject& node, int parent, int depth, ShadowDelta& out);
+    void shadowAddSubtree(TreeShadow& sh, const QJsonObject& first, int parent, int depth, ShadowDelta& out,
+                          TreeWalk& added);
+    void shadowRemove(TreeShadow& sh, int id, ShadowDelta& out);
+    /// Compares one node and its direct children with the UI. Subtrees found below it go on
+    /// added, children to look at deeper (DirtyDeep) on rescans; neither is walked here.
+    void shadowRescan(TreeShadow& sh, int id, quint8 dirty, ShadowDelta& out, ShadowRescans& rescans,
+                      TreeWalk& added);
+    void markShadowDirty(int id, quint8 dirty);
+    void dropShadow(quint64 conn);
+    void untrackShadowed(int id);
+    /// Graphics items get no events: scene changes arrive through QGraphicsScene::changed
+    /// and only the items in the changed regions are looked at again.
+    void watchShadowedView(QGraphicsView* view, int id);
+    void noteSceneChanged(int viewId, const QList<QRectF>& rects);
+    void applySceneChanges(TreeShadow& sh);
+    void noteShadowModified(int id, ShadowDelta& out);
+
+    // tree enumeration shared by elements.roots/children/tree/find; the *Ids variants only
+    // assign ids, summaries are built by the callers that need them
+    void collectRootIds(QVector<int>& out, TreeMode mode = TreeObjects);
+    bool collectChildIds(int parentId, QVector<int>& out, TreeMode mode = TreeObjects);
+    TreeMode childMode(int parentId, TreeMode mode); // tree the children of parentId belong to
+
+    /// Gets every element of a walk once, with its summary, parent id and depth; returning
+    /// false stops the walk.
+    using WalkVisitor = std::function<bool(QJsonObject& node, int parent, int depth)>;
+
+    /// Scene -> screen transform of the last scene summarized (see scene_to_global), so a
+    /// run of items from one scene maps through the view once. Only valid while the GUI
+    /// doesn't change underneath, i.e. within one slice.
+    struct SceneTransformCache {
+        const QGraphicsScene* scene = nullptr;
+        bool hasView = false;
+        QTransform toGlobal;
+    };
+
+    /// Breadth-first walk from a root (0 = all top-levels), advanced in slices. The queue
+    /// holds ids only and nodes are summarized when dequeued, so elements destroyed meanwhile
+    /// simply drop out of the walk, and memory stays at a few ints per pending node plus
+    /// whatever the visitor keeps (a streamed reply keeps one chunk).
+    struct TreeWalk {
+        struct Pending { int id; int parent; int depth; TreeMode mode; bool topLevel; };
+        QQueue<Pending> queue;
+        QSet<int> seen;       // dedup across paths (e.g. a QWindow reachable from several parents)
+        int maxDepth = -1;
+        quint32 fields = FieldsAll;
+        bool stopped = false; // the visitor returned false
+    };
+    bool startWalk(TreeWalk& walk, int rootId, int maxDepth, quint32 fields, TreeMode mode = TreeObjects);
+    /// Visits nodes until the walk ends (returns true) or budgetNs has elapsed (returns false).
+    bool stepWalk(TreeWalk& walk, const WalkVisitor& visit, qint64 budgetNs);
+
     // summarizers
-    QJsonObject summarizeTopLevel(QObject* obj);
-    QJsonObject summarizeObject(QObject* obj);
-    QJsonObject summarizeGraphicsItem(QGraphicsItem* gi);
-    // QJsonObject summarizeQuickItem(QQuickItem* qi);
+    /// Summary of whatever id resolves to (accessible interface, graphics item or object),
+    /// empty if it no longer does. topLevel summarizes a window the way elements.roots does.
+    QJsonObject summarizeId(int id, quint32 fields, TreeMode mode, bool topLevel = false,
+                            SceneTransformCache* scenes = nullptr);
+    QJsonObject summarizeTopLevel(QObject* obj, quint32 fields = FieldsAll);
+    QJsonObject summarizeObject(QObject* obj, quint32 fields = FieldsAll);
+    QJsonObject summarizeGraphicsItem(QGraphicsItem* gi, quint32 fields = FieldsAll,
+                                      const QTransform* toGlobal = nullptr); // scene -> screen, see scene_to_global
+    QJsonObject summarizeAccessible(QAccessibleInterface* iface, quint32 fields = FieldsAll);
+#ifdef INJECTLIB_HAVE_QUICK
+    QJsonObject summarizeQuickItem(QQuickItem* qi, quint32 fields = FieldsAll);
+#endif
 
 };
 
@@ -0,0 +1,192 @@
+#include "qt_stats.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+namespace injectlib {
+
+namespace {
+
+// Methods with their own statistics slot; keep "other" and "(push)" last.
+const char* const kMethodNames[] = {
+    "ping", "app.info",
+    "elements.roots", "elements.children", "elements.tree", "elements.treeDelta", "elements.find",
+    "elements.info", "elements.fromPoint", "elements.properties", "elements.click", "elements.setText",
+    "elements.subscribe", "elements.unsubscribe",
+    "actions.batch", "model.info", "model.rows", "scene.items", "scene.itemAt",
+    "session.setEncoding", "session.setLimits", "server.stats", "server.setLogLevel",
+    "other", "(push)"
+};
+const int kNamedMethods = int(sizeof(kMethodNames) / sizeof(kMethodNames[0]));
+
+const char* const kStageNames[ServerStats::StageCount] = {
+    "parse", "queue", "handle", "serialize", "write"
+};
+
+void atomic_max(std::atomic<quint64>& target, quint64 v) noexcept {
+    quint64 cur = target.load(std::memory_order_relaxed);
+    while (v > cur && !target.compare_exchange_weak(cur, v, std::memory_order_relaxed)) {}
+}
+
+QElapsedTimer& uptime() {
+    static QElapsedTimer t = [] { QElapsedTimer e; e.start(); return e; }();
+    return t;
+}
+
+} // namespace
+
+// ----------------- LatencyHistogram -----------------
+
+int LatencyHistogram::bucketFor(quint64 ns) noexcept {
+    const quint64 kLinear = quint64(1) << kSubBits;
+    if (ns < kLinear) return int(ns);
+
+    const quint64 maxValue = (quint64(1) << kMaxBits) - 1;
+    if (ns > maxValue) ns = maxValue;
+    int msb = 63;
+    while (!(ns >> msb)) --msb;
+    const int shift = msb - kSubBits;
+    return ((shift + 1) << kSubBits) + int((ns >> shift) & (kLinear - 1));
+}
+
+quint64 LatencyHistogram::bucketUpperBound(int bucket) noexcept {
+    const int kLinear = 1 << kSubBits;
+    if (bucket < kLinear) return quint64(bucket);
+    const int shift = (bucket >> kSubBits) - 1;
+    const quint64 sub = quint64(bucket & (kLinear - 1)) | quint64(kLinear);
+    return ((sub + 1) << shift) - 1;
+}
+
+void LatencyHistogram::record(quint64 ns) noexcept {
+    m_buckets[bucketFor(ns)].fetch_add(1, std::memory_order_relaxed);
+    m_count.fetch_add(1, std::memory_order_relaxed);
+    m_sum.fetch_add(ns, std::memory_order_relaxed);
+    atomic_max(m_max, ns);
+}
+
+QJsonObject LatencyHistogram::toJson() const {
+    // Racy with concurrent record() calls by design: counts may be off by the requests
+    // in flight while the snapshot is taken.
+    quint32 counts[kBuckets];
+    quint64 total = 0;
+    for (int i = 0; i < kBuckets; ++i) {
+        counts[i] = m_buckets[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    QJsonObject j;
+    j["count"] = static_cast<double>(total);
+    if (!total) return j;
+
+    const double kUs = 1000.0;
+    const quint64 maxNs = m_max.load(std::memory_order_relaxed);
+    j["mean_us"] = double(m_sum.load(std::memory_order_relaxed)) / double(total) / kUs;
+    j["max_us"]  = double(maxNs) / kUs;
+
+    static const struct { const char* key; double q; } kQuantiles[] = {
+        { "p50_us", 0.50 }, { "p90_us", 0.90 }, { "p99_us", 0.99 }, { "p999_us", 0.999 }
+    };
+    for (const auto& q : kQuantiles) {
+        const quint64 rank = quint64(q.q * double(total - 1)) + 1;
+        quint64 seen = 0;
+        for (int i = 0; i < kBuckets; ++i) {
+            seen += counts[i];
+            if (seen >= rank) {
+                j[QLatin1String(q.key)] = double(std::min(bucketUpperBound(i), maxNs)) / kUs;
+                break;
+            }
+        }
+    }
+    return j;
+}
+
+void LatencyHistogram::reset() noexcept {
+    for (auto& b : m_buckets) b.store(0, std::memory_order_relaxed);
+    m_count.store(0, std::memory_order_relaxed);
+    m_sum.store(0, std::memory_order_relaxed);
+    m_max.store(0, std::memory_order_relaxed);
+}
+
+// ----------------- ServerStats -----------------
+
+int ServerStats::methodIndex(const QString& method) {
+    static_assert(sizeof(kMethodNames) / sizeof(kMethodNames[0]) <= kMethods, "grow ServerStats::kMethods");
+    for (int i = 0; i < kNamedMethods - 2; ++i) {
+        if (method == QLatin1String(kMethodNames[i]))
+            return i;
+    }
+    return kNamedMethods - 2;
+}
+
+int ServerStats::pushIndex() {
+    return kNamedMethods - 1;
+}
+
+void ServerStats::record(int method, Stage stage, qint64 ns) noexcept {
+    if (method < 0 || method >= kNamedMethods) return;
+    m_methods[method].stages[stage].record(ns > 0 ? quint64(ns) : 0);
+}
+
+void ServerStats::countCall(int method, bool error) noexcept {
+    if (method < 0 || method >= kNamedMethods) return;
+    m_methods[method].calls.fetch_add(1, std::memory_order_relaxed);
+    if (error)
+        m_methods[method].errors.fetch_add(1, std::memory_order_relaxed);
+}
+
+QJsonObject ServerStats::toJson() const {
+    auto num = [](const std::atomic<quint64>& v) { return static_cast<double>(v.load(std::memory_order_relaxed)); };
+
+    QJsonObject methods;
+    for (int i = 0; i < kNamedMethods; ++i) {
+        const MethodStats& m = m_methods[i];
+        const quint64 calls = m.calls.load(std::memory_order_relaxed);
+        bool any = calls > 0;
+        for (const LatencyHistogram& h : m.stages)
+            any = any || h.count() > 0;
+        if (!any) continue;
+
+        QJsonObject jm;
+        jm["calls"]  = static_cast<double>(calls);
+        jm["errors"] = num(m.errors);
+        for (int s = 0; s < StageCount; ++s) {
+            if (m.stages[s].count())
+                jm[QLatin1String(kStageNames[s])] = m.stages[s].toJson();
+        }
+        methods[QLatin1String(kMethodNames[i])] = jm;
+    }
+
+    QJsonObject j;
+    j["uptime_ms"]   = static_cast<double>(uptime().elapsed());
+    j["bytes_in"]    = num(bytesIn);
+    j["bytes_out"]   = num(bytesOut);
+    j["frames_in"]   = num(framesIn);
+    j["frames_out"]  = num(framesOut);
+    j["connections"] = static_cast<double>(connections.load(std::memory_order_relaxed));
+    j["inflight"]    = static_cast<double>(inflight.load(std::memory_order_relaxed));
+    j["gui_queue"]   = static_cast<double>(guiQueued.load(std::memory_order_relaxed));
+    j["methods"]     = methods;
+    return j;
+}
+
+void ServerStats::reset() noexcept {
+    bytesIn.store(0, std::memory_order_relaxed);
+    bytesOut.store(0, std::memory_order_relaxed);
+    framesIn.store(0, std::memory_order_relaxed);
+    framesOut.store(0, std::memory_order_relaxed);
+    for (MethodStats& m : m_methods) {
+        m.calls.store(0, std::memory_order_relaxed);
+        m.errors.store(0, std::memory_order_relaxed);
+        for (LatencyHistogram& h : m.stages)
+            h.reset();
+    }
+}
+
+ServerStats& server_stats() {
+    uptime(); // starts counting with the first use
+    static ServerStats stats;
+    return stats;
+}
+
+} // namespace injectlib
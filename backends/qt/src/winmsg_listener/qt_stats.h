@@ -0,0 +1,77 @@
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+
+#include <atomic>
+
+// Always-on request statistics of the injected server (server.stats). Everything is
+// recorded with relaxed atomics, so the network and GUI threads never contend on a lock
+// and a snapshot can be taken from either of them while requests are running.
+namespace injectlib {
+
+/// Log-linear latency histogram (HDR style): exact below 8 ns, then 8 sub-buckets per
+/// power of two, i.e. at most 12.5% relative error, up to ~18 minutes.
+class LatencyHistogram {
+public:
+    void record(quint64 ns) noexcept;
+    quint64 count() const noexcept { return m_count.load(std::memory_order_relaxed); }
+
+    /// {count, mean_us, p50_us, p90_us, p99_us, p999_us, max_us}
+    QJsonObject toJson() const;
+    void reset() noexcept;
+
+private:
+    static const int kSubBits = 3;
+    static const int kMaxBits = 40;
+    static const int kBuckets = (kMaxBits - kSubBits + 1) << kSubBits;
+
+    static int bucketFor(quint64 ns) noexcept;
+    static quint64 bucketUpperBound(int bucket) noexcept;
+
+    std::atomic<quint32> m_buckets[kBuckets] = {};
+    std::atomic<quint64> m_count{0};
+    std::atomic<quint64> m_sum{0};
+    std::atomic<quint64> m_max{0};
+};
+
+class ServerStats {
+public:
+    /// Where the time of a request goes, in order.
+    enum Stage { StageParse, StageQueue, StageHandle, StageSerialize, StageWrite, StageCount };
+
+    /// Slot of a method in the fixed method table; unknown names share the "other" slot.
+    static int methodIndex(const QString& method);
+    /// Slot used for unsolicited frames (notifications).
+    static int pushIndex();
+
+    void record(int method, Stage stage, qint64 ns) noexcept;
+    void countCall(int method, bool error) noexcept;
+
+    std::atomic<quint64> bytesIn{0};
+    std::atomic<quint64> bytesOut{0};
+    std::atomic<quint64> framesIn{0};
+    std::atomic<quint64> framesOut{0};
+    std::atomic<qint64>  connections{0}; // open client connections
+    std::atomic<qint64>  inflight{0};    // handed to the GUI thread, not answered yet
+    std::atomic<qint64>  guiQueued{0};   // waiting in the GUI-thread lanes
+
+    QJsonObject toJson() const;
+    /// Zeroes counters and histograms; gauges (connections, inflight, queue) are kept.
+    void reset() noexcept;
+
+private:
+    struct MethodStats {
+        std::atomic<quint64> calls{0};
+        std::atomic<quint64> errors{0};
+        LatencyHistogram stages[StageCount];
+    };
+
+    static const int kMethods = 32;
+    MethodStats m_methods[kMethods];
+};
+
+/// The process-wide instance.
+ServerStats& server_stats();
+
+} // namespace injectlib
@@ -0,0 +1,64 @@
+#include "qt_util.h"
+
+#include <QtGlobal>
+
+#include <atomic>
+
+#ifdef Q_OS_WIN
+#include <windows.h>
+#else
+#include <cstdio>
+#endif
+
+namespace injectlib {
+
+namespace {
+
+std::atomic<int> g_logLevel{-1}; // -1: not read from the environment yet
+
+void write_log(const QString& s) {
+#ifdef Q_OS_WIN
+    OutputDebugStringW(reinterpret_cast<const wchar_t*>(s.utf16()));
+#else
+    const QByteArray utf8 = s.toUtf8();
+    std::fwrite(utf8.constData(), 1, static_cast<size_t>(utf8.size()), stderr);
+#endif
+}
+
+} // namespace
+
+int log_level() noexcept {
+    int level = g_logLevel.load(std::memory_order_relaxed);
+    if (level < 0) {
+        level = clamp_int(read_env_int("QT_INJECTED_LOG_LEVEL", LogInfo), LogOff, LogTrace);
+        g_logLevel.store(level, std::memory_order_relaxed);
+    }
+    return level;
+}
+
+void set_log_level(int level) noexcept {
+    g_logLevel.store(clamp_int(level, LogOff, LogTrace), std::memory_order_relaxed);
+}
+
+void dbg(const QString& s) {
+    dbg(LogInfo, s);
+}
+
+void dbg(int level, const QString& s) {
+    if (log_enabled(level))
+        write_log(s);
+}
+
+int read_env_int(const char* name, int def_val) {
+    bool ok = false;
+    const int v = qEnvironmentVariableIntValue(name, &ok);
+    return ok ? v : def_val;
+}
+
+int clamp_int(int v, int lo, int hi) {
+    if (v < lo) return lo;
+    if (v > hi) return hi;
+    return v;
+}
+
+} // namespace injectlib
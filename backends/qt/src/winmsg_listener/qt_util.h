@@ -0,0 +1,30 @@
+#pragma once
+
+#include <QString>
+
+// Small platform helpers shared by the Qt server translation units.
+namespace injectlib {
+
+/// Verbosity of dbg(). The initial level comes from QT_INJECTED_LOG_LEVEL (default LogInfo)
+/// and can be changed at runtime with the server.setLogLevel method.
+enum LogLevel { LogOff = 0, LogError = 1, LogInfo = 2, LogDebug = 3, LogTrace = 4 };
+
+int log_level() noexcept;
+void set_log_level(int level) noexcept;
+inline bool log_enabled(int level) noexcept { return level <= log_level(); }
+
+/// Writes a debug line at LogInfo (OutputDebugString on Windows, stderr elsewhere).
+void dbg(const QString& s);
+void dbg(int level, const QString& s);
+
+/// Reads an integer environment variable, returns def_val if unset or malformed.
+int read_env_int(const char* name, int def_val);
+
+int clamp_int(int v, int lo, int hi);
+
+} // namespace injectlib
+
+// Logs msg at level; msg is not even formatted unless the level is enabled, so this is what
+// per-request and per-node logging should use.
+#define INJECTLIB_LOG(level, msg) \
+    do { if (::injectlib::log_enabled(level)) ::injectlib::dbg(level, msg); } while (0)
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+
+#include <cstdio>
+#include <cstdlib>
+
+#ifdef Q_OS_UNIX
+#include <unistd.h>
+#endif
+
+// Helpers shared by the bench_* programs. A benchmark prints its numbers and exits non-zero
+// if a run went wrong, so ctest notices a broken benchmark even with a small count.
+
+inline void bench_check(bool ok, const char* bench, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "%s: %s\n", bench, what);
+        std::exit(1);
+    }
+}
+
+// Resident set size of the process in bytes, -1 where it is not available.
+inline qint64 bench_rss_bytes() {
+#ifdef Q_OS_LINUX
+    QFile f(QStringLiteral("/proc/self/statm"));
+    if (!f.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> fields = f.readAll().split(' ');
+    if (fields.size() < 2)
+        return -1;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return -1;
+#endif
+}
+
+// Peak resident set size since the start or the last bench_reset_peak_rss(), -1 where it is
+// not available.
+inline qint64 bench_peak_rss_bytes() {
+#ifdef Q_OS_LINUX
+    QFile f(QStringLiteral("/proc/self/status"));
+    if (!f.open(QIODevice::ReadOnly))
+        return -1;
+    const QList<QByteArray> lines = f.readAll().split('\n');
+    for (const QByteArray& line : lines) {
+        if (line.startsWith("VmHWM:"))
+            return line.mid(6).trimmed().split(' ').first().toLongLong() * 1024;
+    }
+#endif
+    return -1;
+}
+
+// Starts the peak of bench_peak_rss_bytes() over from the current RSS where the kernel allows it.
+inline bool bench_reset_peak_rss() {
+#ifdef Q_OS_LINUX
+    QFile f(QStringLiteral("/proc/self/clear_refs"));
+    return f.open(QIODevice::WriteOnly) && f.write("5") == 1;
+#else
+    return false;
+#endif
+}
+
+// n per second for n operations that took ns nanoseconds.
+inline double bench_rate(qint64 n, qint64 ns) {
+    return ns > 0 ? n / (ns / 1e9) : 0.0;
+}
@@ -0,0 +1,101 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QPushButton>
+#include <QVector>
+#include <QWidget>
+
+#include <algorithm>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// Locating one button in a large widget tree over the local socket: elements.find with the
+// predicate evaluated in-process, against pulling elements.tree and filtering on the client.
+// The button is the last node of the walk, so the first-match search visits everything too.
+// Usage: bench_find [labels]
+
+namespace {
+
+const char* const kBench = "bench_find";
+
+qint64 median(QVector<qint64> us) {
+    std::sort(us.begin(), us.end());
+    return us.at(us.size() / 2);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int widgets = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int reps = 20;
+
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_find"));
+    window.resize(800, 600);
+    QWidget* group = nullptr;
+    for (int i = 0; i < widgets; ++i) {
+        if (i % 100 == 0)
+            group = new QWidget(&window);
+        (new QLabel(QString::number(i), group))->setObjectName(QStringLiteral("label%1").arg(i));
+    }
+    (new QPushButton(QStringLiteral("OK"), group))->setObjectName(QStringLiteral("okButton"));
+    window.show();
+    QTest::qWait(20);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+    const QString name = start_local_server();
+    bench_check(!name.isEmpty(), kBench, "server did not start");
+
+    const QJsonObject findOne{ { "id", 1 }, { "method", "elements.find" },
+                               { "params", QJsonObject{ { "id", rootId }, { "auto_id", "okButton" },
+                                                        { "max_results", 1 } } } };
+    const QJsonObject findMany{ { "id", 2 }, { "method", "elements.find" },
+                                { "params", QJsonObject{ { "id", rootId }, { "auto_id_re", "^label1\\d*$" },
+                                                         { "fields", QJsonArray{ "auto_id" } } } } };
+    const QJsonObject tree{ { "id", 3 }, { "method", "elements.tree" }, { "params", QJsonObject{ { "id", rootId } } } };
+    QVector<qint64> oneUs, manyUs, treeUs;
+    int manyMatches = 0;
+
+    run_client([&]() {
+        TestClient c;
+        bench_check(c.connectTo(name), kBench, "no connection");
+        for (int r = 0; r < reps; ++r) {
+            QElapsedTimer t;
+            t.start();
+            const QJsonArray one = c.call(findOne, 30000).value("result").toObject().value("matches").toArray();
+            oneUs.push_back(t.nsecsElapsed() / 1000);
+            bench_check(one.size() == 1, kBench, "elements.find missed the button");
+
+            t.restart();
+            manyMatches = c.call(findMany, 30000).value("result").toObject().value("matches").toArray().size();
+            manyUs.push_back(t.nsecsElapsed() / 1000);
+
+            // What the client did before: the whole tree, filtered on its side.
+            t.restart();
+            const QJsonArray nodes = c.call(tree, 30000).value("result").toObject().value("nodes").toArray();
+            const auto hit = std::find_if(nodes.begin(), nodes.end(), [](const QJsonValue& v) {
+                return v.toObject().value("auto_id").toString() == QLatin1String("okButton");
+            });
+            treeUs.push_back(t.nsecsElapsed() / 1000);
+            bench_check(hit != nodes.end(), kBench, "the button is not in the tree");
+        }
+    });
+    bench_check(oneUs.size() == reps, kBench, "requests failed");
+    bench_check(manyMatches > 0, kBench, "elements.find with a regex found nothing");
+
+    std::printf("%d labels and one button, median latency over a local socket:\n", widgets);
+    std::printf("  elements.find auto_id, first match     %8lld us\n", median(oneUs));
+    std::printf("  elements.find auto_id_re, %5d matches %8lld us\n", manyMatches, median(manyUs));
+    std::printf("  elements.tree + client-side filter     %8lld us\n", median(treeUs));
+    QtHelloServer::instance()->stop();
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QLocalSocket>
+
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+
+#include "qt_frame_decoder.h"
+
+// Request frames per second through FrameDecoder: from memory in TCP-segment and
+// large-read sized pieces, and over a local socket including parsing the JSON.
+// Usage: bench_frame_decoder [frames]
+
+namespace {
+
+void check(bool ok, const char* what) {
+    if (!ok) {
+        std::fprintf(stderr, "bench_frame_decoder: %s\n", what);
+        std::exit(1);
+    }
+}
+
+// A typical request, about 100 bytes.
+QByteArray request_stream(int frames) {
+    QJsonObject params;
+    params["id"] = 123456;
+    params["text"] = QStringLiteral("some text to set");
+    QJsonObject req;
+    req["id"] = 1;
+    req["method"] = QStringLiteral("elements.setText");
+    req["params"] = params;
+    const QByteArray payload = QJsonDocument(req).toJson(QJsonDocument::Compact);
+    const QByteArray frame = QByteArray::number(payload.size()) + "\n" + payload;
+
+    QByteArray stream;
+    stream.reserve(frame.size() * frames);
+    for (int i = 0; i < frames; ++i)
+        stream += frame;
+    return stream;
+}
+
+double bench_memory(const QByteArray& stream, int frames, int piece) {
+    FrameDecoder decoder;
+    QElapsedTimer t;
+    t.start();
+    int decoded = 0;
+    QByteArray payload;
+    for (int pos = 0; pos < stream.size(); pos += piece) {
+        decoder.append(stream.constData() + pos, qMin(piece, stream.size() - pos));
+        while (decoder.next(payload) == FrameDecoder::Result::Frame)
+            ++decoded;
+    }
+    check(decoded == frames, "frames lost in memory");
+    return frames / (t.nsecsElapsed() / 1e9);
+}
+
+double bench_socket(const QByteArray& stream, int frames) {
+    const QString name = QStringLiteral("injectlib-bench-%1").arg(QCoreApplication::applicationPid());
+    QLocalServer::removeServer(name);
+    QLocalServer server;
+    check(server.listen(name), "listen failed");
+
+    QElapsedTimer t;
+    t.start();
+    std::thread writer([&]() {
+        QLocalSocket s;
+        s.connectToServer(name);
+        if (!s.waitForConnected(5000))
+            return;
+        for (int pos = 0; pos < stream.size(); pos += 64 * 1024) {
+            s.write(stream.constData() + pos, qMin(64 * 1024, stream.size() - pos));
+            s.waitForBytesWritten(5000);
+        }
+        while (s.bytesToWrite() > 0 && s.waitForBytesWritten(5000)) {}
+    });
+
+    check(server.waitForNewConnection(5000), "no connection");
+    QLocalSocket* reader = server.nextPendingConnection();
+    FrameDecoder decoder;
+    int decoded = 0;
+    QByteArray payload;
+    while (decoded < frames) {
+        if (decoder.readFrom(reader) <= 0 && !reader->waitForReadyRead(5000))
+            break;
+        while (decoder.next(payload) == FrameDecoder::Result::Frame) {
+            // What the network thread does with each payload.
+            check(QJsonDocument::fromJson(payload).isObject(), "bad payload");
+            ++decoded;
+        }
+    }
+    writer.join();
+    check(decoded == frames, "frames lost on the socket");
+    return frames / (t.nsecsElapsed() / 1e9);
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QCoreApplication app(argc, argv);
+    const int frames = argc > 1 ? std::atoi(argv[1]) : 2000000;
+    const QByteArray stream = request_stream(frames);
+
+    const double segments = bench_memory(stream, frames, 1460);
+    const double reads    = bench_memory(stream, frames, 64 * 1024);
+    const double socket   = bench_socket(stream, frames);
+
+    std::printf("%d frames: memory/1460 B %.2f M frames/s, memory/64 KB %.2f M frames/s, "
+                "local socket + JSON %.2f M frames/s\n",
+                frames, segments / 1e6, reads / 1e6, socket / 1e6);
+    return 0;
+}
@@ -0,0 +1,100 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QLabel>
+#include <QVector>
+#include <QWidget>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// elements.fromPoint lookups/sec over widgets and over graphics scene items, against
+// what a recorder did before: an elements.tree with every rect for each lookup, the hit
+// test then done on its side.
+// Usage: bench_from_point [lookups]
+
+namespace {
+
+const char* const kBench = "bench_from_point";
+
+// Lookups/sec of elements.fromPoint over the given points, cycled through n times.
+double lookups_per_sec(const QVector<QPoint>& points, int n) {
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < n; ++i) {
+        const QPoint& p = points.at(i % points.size());
+        const QJsonObject resp = handle_request(QStringLiteral("elements.fromPoint"),
+                                                { { "point", QJsonArray{ p.x(), p.y() } },
+                                                  { "fields", QJsonArray{ "auto_id", "rect" } } });
+        bench_check(resp.value("result").toObject().value("element").isObject(), kBench, "nothing under a point");
+    }
+    return bench_rate(n, t.nsecsElapsed());
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    // Left: a grid of 40 x 60 labels in 20 panels. Right: a view on 10k scene items.
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_from_point"));
+    window.resize(800, 600);
+    for (int panel = 0; panel < 20; ++panel) {
+        auto* p = new QWidget(&window);
+        p->setGeometry(panel % 2 * 200, panel / 2 * 60, 200, 60);
+        for (int i = 0; i < 120; ++i) {
+            auto* label = new QLabel(p);
+            label->setObjectName(QStringLiteral("label%1.%2").arg(panel).arg(i));
+            label->setGeometry(i % 20 * 10, i / 20 * 10, 9, 9);
+        }
+    }
+    // Items tile the scene, so every point of the view is on one.
+    QGraphicsScene scene(0, 0, 1000, 1000);
+    for (int i = 0; i < 10000; ++i)
+        scene.addRect(i % 100 * 10, i / 100 * 10, 10, 10);
+    auto* view = new QGraphicsView(&scene, &window);
+    view->setGeometry(400, 0, 400, 600);
+    window.show();
+    QTest::qWait(50);
+
+    QVector<QPoint> widgetPoints;
+    for (QLabel* label : window.findChildren<QLabel*>())
+        widgetPoints.push_back(label->mapToGlobal(label->rect().center()));
+    QVector<QPoint> scenePoints;
+    for (int y = 5; y < view->viewport()->height(); y += 10) {
+        for (int x = 5; x < view->viewport()->width(); x += 10)
+            scenePoints.push_back(view->viewport()->mapToGlobal(QPoint(x, y)));
+    }
+    bench_check(!widgetPoints.isEmpty() && !scenePoints.isEmpty(), kBench, "no points to look up");
+
+    const double widgets = lookups_per_sec(widgetPoints, n);
+    const double items = lookups_per_sec(scenePoints, n);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+    const int treeReps = qMax(1, n / 1000);
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < treeReps; ++i) {
+        const QJsonArray nodes = handle_request(QStringLiteral("elements.tree"),
+                                                { { "id", rootId }, { "fields", QJsonArray{ "rect" } } })
+                                         .value("result").toObject().value("nodes").toArray();
+        bench_check(!nodes.isEmpty(), kBench, "elements.tree failed");
+    }
+    const double tree = bench_rate(treeReps, t.nsecsElapsed());
+
+    std::printf("elements.fromPoint, %d lookups each:\n", n);
+    std::printf("  over %d labels            %10.0f lookups/s\n", widgetPoints.size(), widgets);
+    std::printf("  over 10000 scene items     %10.0f lookups/s\n", items);
+    std::printf("  elements.tree with rects   %10.0f trees/s\n", tree);
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QVector>
+
+#include "bench_common.h"
+#include "qt_id_table.h"
+
+// ElementIdTable with many live elements: registration, lookup by id and lookup by
+// pointer for QObjects and plain scene items, and the memory the table takes per element.
+// Usage: bench_id_table [elements]
+
+namespace {
+
+const char* const kBench = "bench_id_table";
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n = argc > 1 ? std::atoi(argv[1]) : 100000;
+
+    QObject root;
+    QVector<QObject*> objects;
+    objects.reserve(n);
+    for (int i = 0; i < n; ++i)
+        objects.push_back(new QObject(&root));
+
+    ElementIdTable table;
+    QVector<int> ids(n);
+    const qint64 rssBefore = bench_rss_bytes();
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < n; ++i)
+        ids[i] = table.idForObject(objects[i]);
+    const qint64 registerNs = t.nsecsElapsed();
+    const qint64 rssAfter = bench_rss_bytes();
+    bench_check(table.size() == n, kBench, "not every object got an id");
+
+    t.restart();
+    for (int i = 0; i < n; ++i)
+        bench_check(table.object(ids[i]) == objects[i], kBench, "id resolved to the wrong object");
+    const qint64 resolveNs = t.nsecsElapsed();
+
+    t.restart();
+    for (int i = 0; i < n; ++i)
+        bench_check(table.idForObject(objects[i]) == ids[i], kBench, "id changed");
+    const qint64 againNs = t.nsecsElapsed();
+
+    // Plain items: resolving checks the scene once per pass; a pass per 1000 lookups is
+    // roughly what a few paged requests per second cost.
+    QGraphicsScene scene;
+    QVector<QGraphicsItem*> items;
+    items.reserve(n);
+    for (int i = 0; i < n; ++i)
+        items.push_back(scene.addRect(i % 1000, i / 1000, 1, 1));
+    QVector<int> itemIds(n);
+    t.restart();
+    for (int i = 0; i < n; ++i)
+        itemIds[i] = table.idForItem(items[i]);
+    const qint64 itemRegisterNs = t.nsecsElapsed();
+    t.restart();
+    for (int i = 0; i < n; ++i) {
+        if (i % 1000 == 0)
+            table.newPass();
+        bench_check(table.graphicsItem(itemIds[i]) == items[i], kBench, "item id resolved wrongly");
+    }
+    const qint64 itemResolveNs = t.nsecsElapsed();
+
+    std::printf("%d objects: register %.2f M/s, resolve id %.2f M/s, lookup by pointer %.2f M/s\n",
+                n, bench_rate(n, registerNs) / 1e6, bench_rate(n, resolveNs) / 1e6, bench_rate(n, againNs) / 1e6);
+    if (rssBefore >= 0 && rssAfter >= 0)
+        std::printf("  table memory: ~%lld bytes per element (RSS)\n", (rssAfter - rssBefore) / n);
+    std::printf("%d scene items: register %.2f M/s, resolve id with a scene check per 1000 %.2f M/s\n",
+                n, bench_rate(n, itemRegisterNs) / 1e6, bench_rate(n, itemResolveNs) / 1e6);
+    return 0;
+}
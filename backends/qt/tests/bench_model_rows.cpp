@@ -0,0 +1,80 @@
+#include <QAbstractTableModel>
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QTableView>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// model.info and model.rows on a large model: a page should cost the same at the top, in the
+// middle and at the end of the model, whatever its size.
+// Usage: bench_model_rows [rows]
+
+namespace {
+
+const char* const kBench = "bench_model_rows";
+
+class BigModel : public QAbstractTableModel {
+public:
+    BigModel(int rows, int columns) : m_rows(rows), m_columns(columns) {}
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : m_rows;
+    }
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : m_columns;
+    }
+    QVariant data(const QModelIndex& index, int role) const override {
+        if (role != Qt::DisplayRole)
+            return QVariant();
+        return QStringLiteral("r%1c%2").arg(index.row()).arg(index.column());
+    }
+
+private:
+    int m_rows;
+    int m_columns;
+};
+
+// Microseconds per request, over reps requests.
+double us_per_request(const QString& method, const QJsonObject& params, int reps, const char* what) {
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < reps; ++i)
+        bench_check(handle_request(method, params).contains("result"), kBench, what);
+    return t.nsecsElapsed() / 1000.0 / reps;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int rows = argc > 1 ? std::atoi(argv[1]) : 1000000;
+    const int reps = 200;
+
+    BigModel model(rows, 8);
+    QTableView view;
+    view.setWindowTitle(QStringLiteral("bench_model_rows"));
+    view.setModel(&model);
+    view.resize(800, 600);
+    view.show();
+    QTest::qWait(20);
+    const int viewId = handle_request(QStringLiteral("elements.roots")).value("result").toArray()
+                               .first().toObject().value("id").toInt();
+
+    const double info = us_per_request(QStringLiteral("model.info"), { { "id", viewId } }, reps, "model.info failed");
+    auto page = [&](int row) {
+        return us_per_request(QStringLiteral("model.rows"), { { "id", viewId }, { "row", row }, { "count", 100 } },
+                              reps, "model.rows failed");
+    };
+    const double top    = page(0);
+    const double middle = page(rows / 2);
+    const double end    = page(qMax(0, rows - 100));
+    const double full   = us_per_request(QStringLiteral("model.rows"),
+                                         { { "id", viewId }, { "row", rows / 2 }, { "count", 1000 } },
+                                         reps / 10, "model.rows failed");
+
+    std::printf("%d x 8 model: model.info %.0f us\n", rows, info);
+    std::printf("  model.rows, 100 rows: top %.0f us, middle %.0f us, end %.0f us; 1000 rows %.0f us\n",
+                top, middle, end, full);
+    return 0;
+}
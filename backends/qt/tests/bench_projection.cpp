@@ -0,0 +1,93 @@
+#include <QApplication>
+#include <QCheckBox>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QWidget>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// Cost per node of element summaries with every field and with the projections a locator
+// uses: elements.children over many widgets of mixed classes, and elements.info per widget.
+// Usage: bench_projection [widgets]
+
+namespace {
+
+const char* const kBench = "bench_projection";
+
+struct Projection {
+    const char* name;
+    QJsonValue fields;
+};
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int reps = 20;
+
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_projection"));
+    window.resize(800, 600);
+    for (int i = 0; i < n; ++i) {
+        QWidget* w = nullptr;
+        switch (i % 4) {
+        case 0: w = new QLabel(QString::number(i), &window); break;
+        case 1: w = new QPushButton(QString::number(i), &window); break;
+        case 2: w = new QLineEdit(QString::number(i), &window); break;
+        default: w = new QCheckBox(QString::number(i), &window); break;
+        }
+        w->setObjectName(QStringLiteral("w%1").arg(i));
+        w->move(i % 40 * 20, i / 40 % 30 * 20);
+    }
+    window.show();
+    QTest::qWait(20);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+    QVector<int> ids;
+    for (const QJsonValue& v : handle_request(QStringLiteral("elements.children"),
+                                              { { "id", rootId }, { "fields", QJsonArray{ "id" } } })
+                                       .value("result").toArray())
+        ids.push_back(v.toObject().value("id").toInt());
+    bench_check(ids.size() == n, kBench, "children missing");
+
+    const Projection projections[] = {
+        { "all fields", QJsonValue() },
+        { "auto_id + class", QJsonArray{ "auto_id", "class" } },
+        { "id only", QJsonArray{ "id" } },
+    };
+    std::printf("%d widgets, ns per node:\n", n);
+    for (const Projection& p : projections) {
+        QJsonObject params{ { "id", rootId } };
+        if (!p.fields.isUndefined())
+            params["fields"] = p.fields;
+        QElapsedTimer t;
+        t.start();
+        for (int r = 0; r < reps; ++r) {
+            const QJsonArray kids = handle_request(QStringLiteral("elements.children"), params)
+                                            .value("result").toArray();
+            bench_check(kids.size() == n, kBench, "elements.children failed");
+        }
+        const double childrenNs = double(t.nsecsElapsed()) / reps / n;
+
+        t.restart();
+        for (int id : qAsConst(ids)) {
+            params["id"] = id;
+            bench_check(handle_request(QStringLiteral("elements.info"), params).contains("result"), kBench,
+                        "elements.info failed");
+        }
+        const double infoNs = double(t.nsecsElapsed()) / n;
+        std::printf("  %-16s elements.children %6.0f, elements.info %6.0f\n", p.name, childrenNs, infoNs);
+    }
+    return 0;
+}
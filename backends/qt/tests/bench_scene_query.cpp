@@ -0,0 +1,90 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// Graphics scene queries on a large synthetic scene: region and point lookups through the
+// scene's index, scene.itemAt, pages of top-level items at the start and at the end, and
+// elements.children on the view for comparison, which summarizes every item.
+// Usage: bench_scene_query [items]
+
+namespace {
+
+const char* const kBench = "bench_scene_query";
+
+// Microseconds per request, over reps requests; the reply's item count in *items.
+double us_per_request(const QString& method, const QJsonObject& params, int reps, int* items = nullptr) {
+    QElapsedTimer t;
+    t.start();
+    QJsonObject resp;
+    for (int i = 0; i < reps; ++i)
+        resp = handle_request(method, params);
+    const double us = t.nsecsElapsed() / 1000.0 / reps;
+    bench_check(resp.contains("result"), kBench, qPrintable(method + QLatin1String(" failed")));
+    if (items) {
+        const QJsonValue result = resp.value("result");
+        *items = result.isArray() ? result.toArray().size() : result.toObject().value("items").toArray().size();
+    }
+    return us;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n = argc > 1 ? std::atoi(argv[1]) : 200000;
+    const int reps = 20;
+    const int columns = 500;
+
+    // A CAD-like grid: small items 10 units apart, columns wide.
+    QGraphicsScene scene;
+    for (int i = 0; i < n; ++i)
+        scene.addRect(i % columns * 10, i / columns * 10, 8, 8);
+    QGraphicsView view(&scene);
+    view.setWindowTitle(QStringLiteral("bench_scene_query"));
+    view.resize(800, 600);
+    view.show();
+    QTest::qWait(20);
+
+    int viewId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == view.windowTitle())
+            viewId = v.toObject().value("id").toInt();
+    }
+    bench_check(viewId > 0, kBench, "view not found");
+
+    const QJsonObject base{ { "id", viewId }, { "coords", "scene" } };
+    int regionItems = 0, pointItems = 0, firstItems = 0, lastItems = 0, childItems = 0;
+
+    QJsonObject params = base;
+    params["rect"] = QJsonArray{ 0, 0, 95, 25 };
+    const double region = us_per_request(QStringLiteral("scene.items"), params, reps, &regionItems);
+    params = base;
+    params["point"] = QJsonArray{ 4, 4 };
+    const double point = us_per_request(QStringLiteral("scene.items"), params, reps, &pointItems);
+    const double itemAt = us_per_request(QStringLiteral("scene.itemAt"), params, reps);
+
+    params = QJsonObject{ { "id", viewId }, { "limit", 1000 } };
+    const double firstPage = us_per_request(QStringLiteral("scene.items"), params, reps, &firstItems);
+    params["offset"] = qMax(0, n - 1000);
+    const double lastPage = us_per_request(QStringLiteral("scene.items"), params, reps, &lastItems);
+    bench_check(firstItems == qMin(n, 1000) && lastItems == qMin(n, 1000), kBench, "short page");
+
+    const double children = us_per_request(QStringLiteral("elements.children"), { { "id", viewId } }, 1, &childItems);
+    bench_check(regionItems > 0 && pointItems == 1, kBench, "region or point query found nothing");
+
+    std::printf("%d-item scene:\n", n);
+    std::printf("  scene.items, region (%d items)          %10.0f us\n", regionItems, region);
+    std::printf("  scene.items, point                     %10.0f us\n", point);
+    std::printf("  scene.itemAt                           %10.0f us\n", itemAt);
+    std::printf("  scene.items, first page of 1000        %10.0f us\n", firstPage);
+    std::printf("  scene.items, last page of 1000         %10.0f us\n", lastPage);
+    std::printf("  elements.children on the view (%d)  %10.0f us\n", childItems, children);
+    return 0;
+}
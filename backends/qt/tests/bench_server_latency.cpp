@@ -0,0 +1,88 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// Round trips over the local socket: ping (answered on the network thread) with the GUI
+// thread idle and with it blocked, and elements.info (answered on the GUI thread) for
+// comparison.
+// Usage: bench_server_latency [requests]
+
+namespace {
+
+const char* const kBench = "bench_server_latency";
+
+struct Latencies {
+    QVector<qint64> us;
+
+    void print(const char* what) {
+        std::sort(us.begin(), us.end());
+        std::printf("  %-28s p50 %6lld us, p99 %6lld us, max %6lld us\n", what, us.at(us.size() / 2),
+                    us.at(us.size() * 99 / 100), us.last());
+    }
+};
+
+// n requests one after the other, on the calling thread.
+Latencies round_trips(TestClient& c, const QJsonObject& req, int n) {
+    Latencies l;
+    l.us.reserve(n);
+    for (int i = 0; i < n; ++i) {
+        QElapsedTimer t;
+        t.start();
+        const QJsonObject reply = c.call(req, 10000);
+        l.us.push_back(t.nsecsElapsed() / 1000);
+        bench_check(reply.contains("result"), kBench, "no reply");
+    }
+    return l;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n = argc > 1 ? std::atoi(argv[1]) : 10000;
+
+    QLabel label(QStringLiteral("bench_server_latency"));
+    label.show();
+    const QString name = start_local_server();
+    bench_check(!name.isEmpty(), kBench, "server did not start");
+    const int labelId = handle_request(QStringLiteral("elements.roots")).value("result").toArray()
+                                .first().toObject().value("id").toInt();
+
+    const QJsonObject ping{ { "id", 1 }, { "method", "ping" } };
+    const QJsonObject info{ { "id", 2 }, { "method", "elements.info" }, { "params", QJsonObject{ { "id", labelId } } } };
+    Latencies idlePing, idleInfo, busyPing;
+
+    run_client([&]() {
+        TestClient c;
+        bench_check(c.connectTo(name), kBench, "no connection");
+        idlePing = round_trips(c, ping, n);
+        idleInfo = round_trips(c, info, n);
+    });
+
+    // The GUI thread blocked for the whole run: pings still have to come back.
+    std::atomic<bool> done{ false };
+    std::thread client([&]() {
+        TestClient c;
+        if (c.connectTo(name))
+            busyPing = round_trips(c, ping, n);
+        done.store(true);
+    });
+    while (!done.load())
+        QThread::msleep(1);
+    client.join();
+    bench_check(busyPing.us.size() == n, kBench, "pings lost while the GUI thread was busy");
+
+    std::printf("%d round trips over a local socket:\n", n);
+    idlePing.print("ping, GUI thread idle");
+    busyPing.print("ping, GUI thread blocked");
+    idleInfo.print("elements.info, GUI thread idle");
+    QtHelloServer::instance()->stop();
+    return 0;
+}
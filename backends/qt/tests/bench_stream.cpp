@@ -0,0 +1,110 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QWidget>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// elements.tree on a large tree over the local socket, as one reply and streamed in chunks:
+// time to the first frame, time to the last, and the peak RSS the request adds (server and
+// client share the process). The client only counts nodes, so what it keeps is one frame.
+// Usage: bench_stream [nodes] [chunk size]
+
+namespace {
+
+const char* const kBench = "bench_stream";
+
+struct Run {
+    qint64 firstUs = 0;
+    qint64 totalUs = 0;
+    qint64 peakRss = -1;
+    int frames = 0;
+    int nodes = 0;
+};
+
+Run tree(const QString& server, int rootId, int chunkSize) {
+    const bool peakReset = bench_reset_peak_rss();
+    const qint64 rssBefore = bench_rss_bytes();
+    QJsonObject req{ { "id", 1 }, { "method", "elements.tree" } };
+    QJsonObject params{ { "id", rootId } };
+    if (chunkSize > 0) {
+        req["stream"] = true;
+        params["chunk_size"] = chunkSize;
+    }
+    req["params"] = params;
+
+    Run r;
+    run_client([&]() {
+        TestClient c;
+        bench_check(c.connectTo(server), kBench, "no connection");
+        QElapsedTimer t;
+        t.start();
+        bench_check(c.send(req), kBench, "write failed");
+        for (;;) {
+            const QJsonObject frame = c.read(60000);
+            bench_check(!frame.isEmpty(), kBench, "no reply");
+            if (!r.frames++)
+                r.firstUs = t.nsecsElapsed() / 1000;
+            r.nodes += frame.value("result").toObject().value("nodes").toArray().size();
+            if (!frame.contains("chunk"))
+                break;
+        }
+        r.totalUs = t.nsecsElapsed() / 1000;
+    });
+    const qint64 peak = bench_peak_rss_bytes();
+    if (peakReset && peak >= 0 && rssBefore >= 0)
+        r.peakRss = peak - rssBefore;
+    return r;
+}
+
+void print(const char* what, const Run& r) {
+    std::printf("  %-22s first frame %8lld us, last %8lld us, %5d frames, peak RSS +", what, r.firstUs,
+                r.totalUs, r.frames);
+    if (r.peakRss >= 0)
+        std::printf("%.1f MB\n", r.peakRss / 1048576.0);
+    else
+        std::printf("n/a\n");
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int nodes     = argc > 1 ? std::atoi(argv[1]) : 50000;
+    const int chunkSize = argc > 2 ? std::atoi(argv[2]) : 500;
+
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_stream"));
+    QWidget* group = nullptr;
+    for (int i = 1; i < nodes; ++i) {
+        if (i % 100 == 1)
+            group = new QWidget(&window);
+        else
+            (new QLabel(QString::number(i), group))->setObjectName(QStringLiteral("label%1").arg(i));
+    }
+    window.show();
+    QTest::qWait(20);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+    const QString server = start_local_server();
+    bench_check(!server.isEmpty(), kBench, "server did not start");
+
+    // Streamed first: without a peak reset the peak only grows.
+    const Run streamed = tree(server, rootId, chunkSize);
+    const Run whole = tree(server, rootId, 0);
+    bench_check(streamed.nodes == nodes && whole.nodes == nodes, kBench, "nodes missing");
+
+    std::printf("elements.tree, %d nodes over a local socket:\n", nodes);
+    print("one reply", whole);
+    print(qPrintable(QStringLiteral("chunks of %1").arg(chunkSize)), streamed);
+    QtHelloServer::instance()->stop();
+    return 0;
+}
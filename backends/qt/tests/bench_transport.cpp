@@ -0,0 +1,143 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QSignalSpy>
+#include <QTcpSocket>
+#include <QVector>
+
+#include <algorithm>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// Ping round trips over TCP with TCP_NODELAY on both ends, over TCP without it, and over the
+// local socket. Besides single pings, two pings are written back to back before reading
+// both replies, which is where Nagle's algorithm holds the second one back.
+// Usage: bench_transport [round trips]
+
+namespace {
+
+const char* const kBench = "bench_transport";
+
+// Client of the text framing over TCP, like TestClient over a local socket.
+class TcpClient {
+public:
+    bool connectTo(quint16 port, bool noDelay) {
+        m_socket.connectToHost(QHostAddress::LocalHost, port);
+        if (!m_socket.waitForConnected(5000))
+            return false;
+        m_socket.setSocketOption(QAbstractSocket::LowDelayOption, noDelay ? 1 : 0);
+        return true;
+    }
+
+    bool send(const QJsonObject& req) {
+        const QByteArray payload = QJsonDocument(req).toJson(QJsonDocument::Compact);
+        const QByteArray frame = QByteArray::number(payload.size()) + "\n" + payload;
+        if (m_socket.write(frame) != frame.size())
+            return false;
+        return m_socket.waitForBytesWritten(5000) || m_socket.bytesToWrite() == 0;
+    }
+
+    QJsonObject read(int timeoutMs = 5000) {
+        QByteArray payload;
+        for (;;) {
+            const FrameDecoder::Result r = m_decoder.next(payload);
+            if (r == FrameDecoder::Result::Frame)
+                return QJsonDocument::fromJson(payload).object();
+            if (r == FrameDecoder::Result::Error)
+                return QJsonObject();
+            if (m_decoder.readFrom(&m_socket) <= 0 && !m_socket.waitForReadyRead(timeoutMs))
+                return QJsonObject();
+        }
+    }
+
+private:
+    QTcpSocket m_socket;
+    FrameDecoder m_decoder;
+};
+
+struct Result {
+    QVector<qint64> single;
+    QVector<qint64> pair;
+
+    static qint64 percentile(QVector<qint64> us, int p) {
+        if (us.isEmpty())
+            return -1;
+        std::sort(us.begin(), us.end());
+        return us.at(qMin(us.size() - 1, us.size() * p / 100));
+    }
+
+    void print(const char* what) const {
+        std::printf("  %-22s ping p50 %5lld us, p99 %6lld us; two pings p50 %6lld us, p99 %6lld us\n", what,
+                    percentile(single, 50), percentile(single, 99), percentile(pair, 50), percentile(pair, 99));
+    }
+};
+
+template <typename Client>
+Result round_trips(Client& c, int n) {
+    const QJsonObject ping{ { "id", 1 }, { "method", "ping" } };
+    Result r;
+    for (int i = 0; i < n; ++i) {
+        QElapsedTimer t;
+        t.start();
+        bench_check(c.send(ping) && !c.read().isEmpty(), kBench, "ping lost");
+        r.single.push_back(t.nsecsElapsed() / 1000);
+
+        t.restart();
+        bench_check(c.send(ping) && c.send(ping), kBench, "write failed");
+        bench_check(!c.read().isEmpty() && !c.read().isEmpty(), kBench, "ping lost");
+        r.pair.push_back(t.nsecsElapsed() / 1000);
+    }
+    return r;
+}
+
+// Starts the server over TCP with the given TCP_NODELAY setting. Returns the port, 0 on failure.
+quint16 start_tcp_server(bool noDelay) {
+    qputenv("QT_INJECTED_TRANSPORT", "tcp");
+    qputenv("QT_INJECTED_TCP_NODELAY", noDelay ? "1" : "0");
+    qputenv("QT_INJECTED_SERVER_PORT", QByteArray::number(20000 + QCoreApplication::applicationPid() % 20000));
+    QtHelloServer* server = QtHelloServer::instance();
+    QSignalSpy started(server, &QtHelloServer::started);
+    server->start();
+    if (!started.wait(5000))
+        return 0;
+    return started.first().first().value<quint16>();
+}
+
+Result tcp(bool noDelay, int n) {
+    const quint16 port = start_tcp_server(noDelay);
+    bench_check(port != 0, kBench, "TCP server did not start");
+    Result r;
+    run_client([&]() {
+        TcpClient c;
+        bench_check(c.connectTo(port, noDelay), kBench, "no TCP connection");
+        r = round_trips(c, n);
+    });
+    QtHelloServer::instance()->stop();
+    return r;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int n = argc > 1 ? std::atoi(argv[1]) : 2000;
+
+    const Result noDelay = tcp(true, n);
+    const Result nagle = tcp(false, n);
+
+    const QString name = start_local_server();
+    bench_check(!name.isEmpty(), kBench, "local server did not start");
+    Result local;
+    run_client([&]() {
+        TestClient c;
+        bench_check(c.connectTo(name), kBench, "no local connection");
+        local = round_trips(c, n);
+    });
+    QtHelloServer::instance()->stop();
+
+    std::printf("%d round trips each:\n", n);
+    noDelay.print("TCP, TCP_NODELAY");
+    nagle.print("TCP, Nagle");
+    local.print("local socket");
+    return 0;
+}
@@ -0,0 +1,115 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QLabel>
+#include <QScrollBar>
+#include <QWidget>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// elements.treeDelta on a large tree: the full snapshot, then deltas after nothing, one
+// widget change, one scene item move, a repaint only, and a scroll of the graphics view.
+// A delta should cost what changed, not what the tree holds.
+// Usage: bench_tree_delta [labels] [scene items]
+
+namespace {
+
+const char* const kBench = "bench_tree_delta";
+
+struct Delta {
+    QJsonObject result;
+    qint64 us = 0;
+};
+
+Delta delta(int rootId, double& version) {
+    QElapsedTimer t;
+    t.start();
+    const QJsonObject resp = handle_request(QStringLiteral("elements.treeDelta"),
+                                            { { "id", rootId }, { "since", version } });
+    Delta d;
+    d.us = t.nsecsElapsed() / 1000;
+    d.result = resp.value("result").toObject();
+    bench_check(!d.result.isEmpty(), kBench, "treeDelta failed");
+    version = d.result.value("version").toDouble();
+    return d;
+}
+
+int changes(const Delta& d) {
+    return d.result.value("added").toArray().size() + d.result.value("modified").toArray().size() +
+           d.result.value("removed").toArray().size();
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int labels = argc > 1 ? std::atoi(argv[1]) : 20000;
+    const int items  = argc > 2 ? std::atoi(argv[2]) : 20000;
+
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_tree_delta"));
+    window.resize(800, 600);
+    QWidget* group = nullptr;
+    QLabel* label = nullptr;
+    for (int i = 0; i < labels; ++i) {
+        if (i % 100 == 0)
+            group = new QWidget(&window);
+        label = new QLabel(QString::number(i), group);
+    }
+    QGraphicsScene scene(0, 0, 4000, 4000);
+    QGraphicsItem* item = nullptr;
+    for (int i = 0; i < items; ++i)
+        item = scene.addRect(i % 200 * 10, i / 200 * 10, 8, 8);
+    auto* view = new QGraphicsView(&scene, &window);
+    view->setGeometry(0, 0, 400, 300);
+    window.show();
+    QTest::qWait(50);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+
+    double version = 0;
+    const Delta full = delta(rootId, version);
+    const int nodes = full.result.value("added").toArray().size();
+    bench_check(nodes >= 1 + labels + items, kBench, "full delta is missing nodes");
+    QTest::qWait(20);
+    delta(rootId, version);
+
+    const Delta none = delta(rootId, version);
+    bench_check(changes(none) == 0, kBench, "changes reported for an idle tree");
+
+    label->setEnabled(false);
+    const Delta widget = delta(rootId, version);
+    bench_check(changes(widget) == 1, kBench, "one widget change not reported as one");
+
+    item->moveBy(0, 5);
+    QTest::qWait(20);
+    const Delta moved = delta(rootId, version);
+    bench_check(changes(moved) == 1, kBench, "one item move not reported as one");
+
+    item->update();
+    view->viewport()->update();
+    QTest::qWait(20);
+    const Delta repaint = delta(rootId, version);
+    bench_check(changes(repaint) == 0, kBench, "a repaint reported as a change");
+
+    view->verticalScrollBar()->setValue(view->verticalScrollBar()->value() + 50);
+    QTest::qWait(20);
+    const Delta scrolled = delta(rootId, version);
+    bench_check(changes(scrolled) >= items, kBench, "scrolled items not reported");
+
+    std::printf("%d nodes (%d labels, %d scene items): full %lld us\n", nodes, labels, items, full.us);
+    std::printf("  delta: idle %lld us, one widget %lld us, one item moved %lld us, repaint %lld us\n",
+                none.us, widget.us, moved.us, repaint.us);
+    std::printf("  delta after scrolling the view: %lld us, %d changes\n", scrolled.us, changes(scrolled));
+    return 0;
+}
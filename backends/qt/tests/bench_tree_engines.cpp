@@ -0,0 +1,92 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QLabel>
+#include <QListWidget>
+#include <QPushButton>
+#include <QWidget>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// The two traversal engines on the same window: elements.tree per node and an elements.find
+// by auto_id with "tree_mode" "objects" and "accessible". The accessible walk also reaches the
+// list's cells, which the object walk doesn't see.
+// Usage: bench_tree_engines [widgets] [list items]
+
+namespace {
+
+const char* const kBench = "bench_tree_engines";
+
+struct Walk {
+    int nodes = 0;
+    double nsPerNode = 0;
+    double findUs = 0;
+};
+
+Walk measure(int rootId, const char* mode, int reps) {
+    Walk w;
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < reps; ++i) {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.tree"), { { "id", rootId }, { "tree_mode", mode } });
+        w.nodes = resp.value("result").toObject().value("nodes").toArray().size();
+    }
+    bench_check(w.nodes > 0, kBench, "elements.tree failed");
+    w.nsPerNode = double(t.nsecsElapsed()) / reps / w.nodes;
+
+    t.restart();
+    for (int i = 0; i < reps; ++i) {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.find"),
+                                                { { "id", rootId }, { "tree_mode", mode }, { "auto_id", "okButton" },
+                                                  { "max_results", 1 } });
+        bench_check(resp.value("result").toObject().value("matches").toArray().size() == 1, kBench,
+                    "the button was not found");
+    }
+    w.findUs = t.nsecsElapsed() / 1000.0 / reps;
+    return w;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int widgets = argc > 1 ? std::atoi(argv[1]) : 5000;
+    const int cells   = argc > 2 ? std::atoi(argv[2]) : 1000;
+    const int reps = 10;
+
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_tree_engines"));
+    window.resize(800, 600);
+    QWidget* group = nullptr;
+    for (int i = 0; i < widgets; ++i) {
+        if (i % 100 == 0)
+            group = new QWidget(&window);
+        new QLabel(QString::number(i), group);
+    }
+    (new QPushButton(QStringLiteral("OK"), group))->setObjectName(QStringLiteral("okButton"));
+    auto* list = new QListWidget(&window);
+    for (int i = 0; i < cells; ++i)
+        list->addItem(QStringLiteral("item %1").arg(i));
+    window.show();
+    QTest::qWait(20);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+
+    const Walk objects = measure(rootId, "objects", reps);
+    const Walk accessible = measure(rootId, "accessible", reps);
+    bench_check(accessible.nodes >= widgets + cells, kBench, "the accessible tree is missing nodes");
+
+    std::printf("%d widgets and a list of %d items:\n", widgets, cells);
+    std::printf("  objects     elements.tree %6d nodes, %6.0f ns/node; elements.find %8.0f us\n", objects.nodes,
+                objects.nsPerNode, objects.findUs);
+    std::printf("  accessible  elements.tree %6d nodes, %6.0f ns/node; elements.find %8.0f us\n", accessible.nodes,
+                accessible.nsPerNode, accessible.findUs);
+    return 0;
+}
@@ -0,0 +1,88 @@
+#include <QApplication>
+#include <QCborMap>
+#include <QCborValue>
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QLabel>
+#include <QWidget>
+
+#include "bench_common.h"
+#include "test_common.h"
+
+// An elements.tree reply as JSON and as CBOR, the way write_frame and decode_request turn
+// it into frames and back: bytes on the wire, encode and decode time.
+// Usage: bench_wire_format [nodes]
+
+namespace {
+
+const char* const kBench = "bench_wire_format";
+
+struct Format {
+    qint64 bytes = 0;
+    double encodeUs = 0;
+    double decodeUs = 0;
+};
+
+template <typename Encode, typename Decode>
+Format measure(const QJsonObject& reply, int reps, Encode encode, Decode decode) {
+    Format f;
+    QByteArray payload;
+    QElapsedTimer t;
+    t.start();
+    for (int i = 0; i < reps; ++i)
+        payload = encode(reply);
+    f.encodeUs = t.nsecsElapsed() / 1000.0 / reps;
+    f.bytes = payload.size();
+
+    t.restart();
+    for (int i = 0; i < reps; ++i)
+        bench_check(decode(payload) == reply, kBench, "reply changed on the way");
+    f.decodeUs = t.nsecsElapsed() / 1000.0 / reps;
+    return f;
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    QApplication app(argc, argv);
+    const int nodes = argc > 1 ? std::atoi(argv[1]) : 10000;
+    const int reps = 20;
+
+    QWidget window;
+    window.setWindowTitle(QStringLiteral("bench_wire_format"));
+    window.resize(800, 600);
+    QWidget* group = nullptr;
+    for (int i = 1; i < nodes; ++i) {
+        if (i % 100 == 1)
+            group = new QWidget(&window);
+        else
+            (new QLabel(QString::number(i), group))->setObjectName(QStringLiteral("label%1").arg(i));
+    }
+    window.show();
+    QTest::qWait(20);
+
+    int rootId = 0;
+    const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                     .value("result").toArray();
+    for (const QJsonValue& v : roots) {
+        if (v.toObject().value("name").toString() == window.windowTitle())
+            rootId = v.toObject().value("id").toInt();
+    }
+    bench_check(rootId > 0, kBench, "window not found");
+    const QJsonObject reply = handle_request(QStringLiteral("elements.tree"), { { "id", rootId } });
+    const int count = reply.value("result").toObject().value("nodes").toArray().size();
+    bench_check(count == nodes, kBench, "elements.tree is missing nodes");
+
+    const Format json = measure(
+            reply, reps, [](const QJsonObject& o) { return QJsonDocument(o).toJson(QJsonDocument::Compact); },
+            [](const QByteArray& b) { return QJsonDocument::fromJson(b).object(); });
+    const Format cbor = measure(
+            reply, reps, [](const QJsonObject& o) { return QCborValue::fromJsonValue(o).toCbor(); },
+            [](const QByteArray& b) { return QCborValue::fromCbor(b).toMap().toJsonObject(); });
+
+    std::printf("elements.tree reply, %d nodes:\n", count);
+    std::printf("  json  %9lld bytes, encode %8.0f us, decode %8.0f us\n", json.bytes, json.encodeUs, json.decodeUs);
+    std::printf("  cbor  %9lld bytes, encode %8.0f us, decode %8.0f us\n", cbor.bytes, cbor.encodeUs, cbor.decodeUs);
+    std::printf("  cbor/json bytes %.2f\n", double(cbor.bytes) / json.bytes);
+    return 0;
+}
@@ -0,0 +1,22 @@
+"""Feeds CBOR through injectlib.cbor for test_cbor.
+
+Reads one CBOR item on stdin. Writes it back re-encoded with injectlib.cbor, or as JSON
+with --json, so the test can check decoding and encoding separately.
+"""
+
+import json
+import sys
+
+from injectlib import cbor
+
+
+def main():
+    obj = cbor.loads(sys.stdin.buffer.read())
+    if '--json' in sys.argv[1:]:
+        sys.stdout.write(json.dumps(obj))
+    else:
+        sys.stdout.buffer.write(cbor.dumps(obj))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,130 @@
+#include <QApplication>
+#include <QCheckBox>
+#include <QListWidget>
+#include <QPushButton>
+#include <QSlider>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include "test_common.h"
+
+// "tree_mode": "accessible" next to the default object walk: widgets keep their ids across
+// both engines, item view cells exist only in the accessible one and keep their ids between
+// requests, and accessible summaries report role, value and state.
+class TestAccessible : public QObject {
+    Q_OBJECT
+
+    QWidget m_window;
+    QPushButton* m_button = nullptr;
+    QListWidget* m_list = nullptr;
+
+    static QJsonArray find(const QJsonObject& params, bool accessible) {
+        QJsonObject p = params;
+        if (accessible)
+            p["tree_mode"] = "accessible";
+        return handle_request(QStringLiteral("elements.find"), p).value("result").toObject().value("matches").toArray();
+    }
+
+    static int findOne(const QJsonObject& params, bool accessible) {
+        const QJsonArray matches = find(params, accessible);
+        return matches.size() == 1 ? matches.first().toObject().value("id").toInt() : 0;
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Accessible"));
+        auto* layout = new QVBoxLayout(&m_window);
+        m_button = new QPushButton(QStringLiteral("OK"));
+        m_button->setObjectName(QStringLiteral("ok"));
+        auto* slider = new QSlider(Qt::Horizontal);
+        slider->setObjectName(QStringLiteral("slider"));
+        slider->setRange(0, 100);
+        slider->setValue(40);
+        auto* check = new QCheckBox(QStringLiteral("Disabled"));
+        check->setObjectName(QStringLiteral("check"));
+        check->setEnabled(false);
+        m_list = new QListWidget;
+        m_list->setObjectName(QStringLiteral("list"));
+        m_list->addItems({ QStringLiteral("alpha"), QStringLiteral("beta"), QStringLiteral("gamma") });
+        layout->addWidget(m_button);
+        layout->addWidget(slider);
+        layout->addWidget(check);
+        layout->addWidget(m_list);
+        m_window.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&m_window));
+    }
+
+    void widgetsHaveOneIdInBothEngines() {
+        const QJsonObject window{ { "id", 0 }, { "name", m_window.windowTitle() }, { "max_depth", 0 } };
+        const int objectsWindow = findOne(window, false);
+        QVERIFY(objectsWindow > 0);
+        QCOMPARE(findOne(window, true), objectsWindow);
+
+        const QJsonObject button{ { "id", objectsWindow }, { "auto_id", "ok" } };
+        const int objectsButton = findOne(button, false);
+        QVERIFY(objectsButton > 0);
+        QCOMPARE(findOne(button, true), objectsButton);
+
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "tree_mode", "accessible" } })
+                                         .value("result").toArray();
+        bool found = false;
+        for (const QJsonValue& v : roots)
+            found = found || v.toObject().value("id").toInt() == objectsWindow;
+        QVERIFY(found);
+    }
+
+    void cellsOnlyInTheAccessibleTree() {
+        const QJsonObject beta{ { "id", 0 }, { "name", "beta" }, { "fields", QJsonArray{ "name", "class", "role" } } };
+        QVERIFY(find(beta, false).isEmpty());
+
+        const QJsonArray matches = find(beta, true);
+        QCOMPARE(matches.size(), 1);
+        const QJsonObject cell = matches.first().toObject();
+        QCOMPARE(cell.value("class").toString(), QStringLiteral("QAccessibleInterface"));
+        QCOMPARE(cell.value("role").toString(), QStringLiteral("ListItem"));
+        const int cellId = cell.value("id").toInt();
+        QVERIFY(cellId > 0);
+
+        // Stable between requests, and usable without repeating the mode.
+        QCOMPARE(findOne(beta, true), cellId);
+        const QJsonObject info = handle_request(QStringLiteral("elements.info"),
+                                                { { "id", cellId }, { "fields", QJsonArray{ "name" } } });
+        QCOMPARE(info.value("result").toObject().value("name").toString(), QStringLiteral("beta"));
+
+        // The list's accessible children include its cells.
+        const int listId = findOne({ { "id", 0 }, { "auto_id", "list" } }, false);
+        const QJsonArray kids = handle_request(QStringLiteral("elements.children"),
+                                               { { "id", listId }, { "tree_mode", "accessible" },
+                                                 { "fields", QJsonArray{ "name" } } })
+                                        .value("result").toArray();
+        bool hasCell = false;
+        for (const QJsonValue& v : kids)
+            hasCell = hasCell || v.toObject().value("id").toInt() == cellId;
+        QVERIFY(hasCell);
+    }
+
+    void roleValueAndState() {
+        const QJsonArray fields{ "role", "value", "state", "enabled" };
+        const QJsonArray slider = find({ { "id", 0 }, { "auto_id", "slider" }, { "fields", fields } }, true);
+        QCOMPARE(slider.size(), 1);
+        QCOMPARE(slider.first().toObject().value("role").toString(), QStringLiteral("Slider"));
+        QCOMPARE(slider.first().toObject().value("value").toInt(), 40);
+
+        const QJsonArray check = find({ { "id", 0 }, { "auto_id", "check" }, { "fields", fields } }, true);
+        QCOMPARE(check.size(), 1);
+        QCOMPARE(check.first().toObject().value("enabled").toBool(), false);
+        QVERIFY(check.first().toObject().value("state").toArray().contains(QStringLiteral("disabled")));
+        QVERIFY(check.first().toObject().value("state").toArray().contains(QStringLiteral("checkable")));
+    }
+
+    void actionsTakeIdsFromTheAccessibleTree() {
+        const int buttonId = findOne({ { "id", 0 }, { "auto_id", "ok" } }, true);
+        QVERIFY(buttonId > 0);
+        QSignalSpy clicked(m_button, &QPushButton::clicked);
+        QVERIFY(handle_request(QStringLiteral("elements.click"), { { "id", buttonId } }).contains("result"));
+        QTRY_COMPARE(clicked.count(), 1);
+    }
+};
+
+QTEST_MAIN(TestAccessible)
+#include "test_accessible.moc"
@@ -0,0 +1,130 @@
+#include <QApplication>
+#include <QComboBox>
+#include <QLineEdit>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include "test_common.h"
+
+// elements.setText and actions.batch. Requests are validated when they arrive and applied
+// from the event loop afterwards, hence the qWait before looking at the widgets.
+class TestActions : public QObject {
+    Q_OBJECT
+
+    QWidget m_window;
+    QComboBox* m_choice = nullptr;
+    QComboBox* m_editable = nullptr;
+    QLineEdit* m_edit = nullptr;
+    QHash<QString, int> m_ids;
+
+    static QJsonObject setText(int id, const QString& text) {
+        return handle_request(QStringLiteral("elements.setText"), { { "id", id }, { "text", text } });
+    }
+
+    static QJsonObject batch(const QJsonArray& actions, bool stopOnError = false) {
+        return handle_request(QStringLiteral("actions.batch"), { { "actions", actions }, { "stop_on_error", stopOnError } })
+                .value("result").toObject();
+    }
+
+    static QJsonObject setTextAction(int id, const QString& text) {
+        return { { "action", "setText" }, { "id", id }, { "text", text } };
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Actions"));
+        auto* layout = new QVBoxLayout(&m_window);
+        m_choice = new QComboBox;
+        m_choice->setObjectName(QStringLiteral("choice"));
+        m_choice->addItems({ QStringLiteral("red"), QStringLiteral("green"), QStringLiteral("blue") });
+        m_editable = new QComboBox;
+        m_editable->setObjectName(QStringLiteral("editable"));
+        m_editable->setEditable(true);
+        m_editable->addItems({ QStringLiteral("one"), QStringLiteral("two") });
+        m_edit = new QLineEdit;
+        m_edit->setObjectName(QStringLiteral("edit"));
+        layout->addWidget(m_choice);
+        layout->addWidget(m_editable);
+        layout->addWidget(m_edit);
+        m_window.show();
+
+        int rootId = 0;
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == m_window.windowTitle())
+                rootId = v.toObject().value("id").toInt();
+        }
+        QVERIFY(rootId > 0);
+        const QJsonArray kids = handle_request(QStringLiteral("elements.children"),
+                                               { { "id", rootId }, { "fields", QJsonArray{ "auto_id" } } })
+                                        .value("result").toArray();
+        for (const QJsonValue& v : kids)
+            m_ids.insert(v.toObject().value("auto_id").toString(), v.toObject().value("id").toInt());
+        QVERIFY(m_ids.value(QStringLiteral("choice")) > 0);
+        QVERIFY(m_ids.value(QStringLiteral("editable")) > 0);
+        QVERIFY(m_ids.value(QStringLiteral("edit")) > 0);
+    }
+
+    void nonEditableComboSelectsTheItem() {
+        const QJsonObject resp = setText(m_ids.value(QStringLiteral("choice")), QStringLiteral("blue"));
+        QVERIFY(resp.value("result").toObject().value("ok").toBool());
+        QTRY_COMPARE(m_choice->currentIndex(), 2);
+        QCOMPARE(m_choice->currentText(), QStringLiteral("blue"));
+    }
+
+    void nonEditableComboRejectsUnknownText() {
+        const int before = m_choice->currentIndex();
+        const QJsonObject resp = setText(m_ids.value(QStringLiteral("choice")), QStringLiteral("purple"));
+        QCOMPARE(resp.value("error").toObject().value("code").toInt(), -32010);
+        QTest::qWait(20);
+        QCOMPARE(m_choice->currentIndex(), before);
+        QCOMPARE(m_choice->count(), 3);
+    }
+
+    void editableComboTakesAnyText() {
+        const QJsonObject resp = setText(m_ids.value(QStringLiteral("editable")), QStringLiteral("three"));
+        QVERIFY(resp.value("result").toObject().value("ok").toBool());
+        QTRY_COMPARE(m_editable->currentText(), QStringLiteral("three"));
+        QCOMPARE(m_editable->lineEdit()->text(), QStringLiteral("three"));
+
+        QVERIFY(setText(m_ids.value(QStringLiteral("editable")), QStringLiteral("two")).contains("result"));
+        QTRY_COMPARE(m_editable->currentText(), QStringLiteral("two"));
+    }
+
+    void batchAppliesInOrder() {
+        const int editId = m_ids.value(QStringLiteral("edit"));
+        const QJsonObject result = batch({ setTextAction(editId, QStringLiteral("first")),
+                                           setTextAction(m_ids.value(QStringLiteral("choice")), QStringLiteral("red")),
+                                           setTextAction(editId, QStringLiteral("second")) });
+        QVERIFY(result.value("ok").toBool());
+        QCOMPARE(result.value("applied").toInt(), 3);
+        QTRY_COMPARE(m_edit->text(), QStringLiteral("second"));
+        QCOMPARE(m_choice->currentText(), QStringLiteral("red"));
+    }
+
+    void batchReportsFailuresPerAction() {
+        const int choiceId = m_ids.value(QStringLiteral("choice"));
+        const int editId = m_ids.value(QStringLiteral("edit"));
+        QJsonObject result = batch({ setTextAction(choiceId, QStringLiteral("purple")),
+                                     setTextAction(editId, QStringLiteral("after")) });
+        QVERIFY(!result.value("ok").toBool());
+        QCOMPARE(result.value("applied").toInt(), 1);
+        QJsonArray results = result.value("results").toArray();
+        QCOMPARE(results.at(0).toObject().value("error").toObject().value("code").toInt(), -32010);
+        QVERIFY(results.at(1).toObject().value("ok").toBool());
+        QTRY_COMPARE(m_edit->text(), QStringLiteral("after"));
+
+        result = batch({ setTextAction(choiceId, QStringLiteral("purple")),
+                         setTextAction(editId, QStringLiteral("skipped")) },
+                       true);
+        QCOMPARE(result.value("applied").toInt(), 0);
+        results = result.value("results").toArray();
+        QVERIFY(results.at(1).toObject().value("skipped").toBool());
+        QTest::qWait(20);
+        QCOMPARE(m_edit->text(), QStringLiteral("after"));
+    }
+};
+
+QTEST_MAIN(TestActions)
+#include "test_actions.moc"
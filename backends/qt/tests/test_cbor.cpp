@@ -0,0 +1,126 @@
+#include <QApplication>
+#include <QLabel>
+#include <QLineEdit>
+#include <QProcess>
+#include <QProcessEnvironment>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include "test_common.h"
+
+// The CBOR wire format: negotiated over a local socket, replies carry what the JSON ones do,
+// and what the server encodes survives a trip through the Python codec (injectlib.cbor) in
+// both directions. The Python part needs an interpreter, found by CMake.
+class TestCbor : public QObject {
+    Q_OBJECT
+
+    QWidget m_window;
+    QString m_server;
+    int m_rootId = 0;
+
+    QJsonObject tree() {
+        return handle_request(QStringLiteral("elements.tree"), { { "id", m_rootId } }).value("result").toObject();
+    }
+
+#ifdef INJECTLIB_PYTHON
+    // Runs cbor_roundtrip.py on input; empty on failure.
+    static QByteArray python(const QByteArray& input, const QStringList& args = QStringList()) {
+        QProcess p;
+        QProcessEnvironment env = QProcessEnvironment::systemEnvironment();
+        env.insert(QStringLiteral("PYTHONPATH"), QStringLiteral(INJECTLIB_PYTHON_SRC));
+        p.setProcessEnvironment(env);
+        p.start(QStringLiteral(INJECTLIB_PYTHON), QStringList{ QStringLiteral(INJECTLIB_CBOR_ROUNDTRIP) } + args);
+        if (!p.waitForStarted(10000))
+            return QByteArray();
+        p.write(input);
+        p.closeWriteChannel();
+        if (!p.waitForFinished(30000) || p.exitCode() != 0) {
+            qWarning("%s", p.readAllStandardError().constData());
+            return QByteArray();
+        }
+        return p.readAllStandardOutput();
+    }
+#endif
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("CBOR äöü ✓"));
+        auto* layout = new QVBoxLayout(&m_window);
+        for (int i = 0; i < 20; ++i) {
+            QWidget* w = i % 2 ? static_cast<QWidget*>(new QLabel(QStringLiteral("label %1").arg(i)))
+                               : new QLineEdit(QStringLiteral("edit %1").arg(i));
+            w->setObjectName(QStringLiteral("w%1").arg(i));
+            layout->addWidget(w);
+        }
+        m_window.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&m_window));
+
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == m_window.windowTitle())
+                m_rootId = v.toObject().value("id").toInt();
+        }
+        QVERIFY(m_rootId > 0);
+        m_server = start_local_server();
+        QVERIFY(!m_server.isEmpty());
+    }
+
+    void repliesMatchJsonAfterTheSwitch() {
+        const QJsonObject expected = tree();
+        QJsonObject ping, switched, reply, badEncoding;
+        run_client([&]() {
+            TestClient c;
+            if (!c.connectTo(m_server))
+                return;
+            ping = c.call({ { "id", 1 }, { "method", "ping" } });
+            switched = c.call({ { "id", 2 }, { "method", "session.setEncoding" },
+                                { "params", QJsonObject{ { "encoding", "cbor" } } } });
+            c.useCbor();
+            reply = c.call({ { "id", 3 }, { "method", "elements.tree" }, { "params", QJsonObject{ { "id", m_rootId } } } });
+            badEncoding = c.call({ { "id", 4 }, { "method", "session.setEncoding" },
+                                   { "params", QJsonObject{ { "encoding", "xml" } } } });
+        });
+
+        QVERIFY(ping.value("result").toObject().value("encodings").toArray().contains(QStringLiteral("cbor")));
+        QCOMPARE(switched.value("result").toObject().value("encoding").toString(), QStringLiteral("cbor"));
+        QCOMPARE(reply.value("id").toInt(), 3);
+        QCOMPARE(reply.value("result").toObject(), expected);
+        QCOMPARE(badEncoding.value("error").toObject().value("code").toInt(), -32602);
+    }
+
+    void pythonCodecRoundTrip() {
+#ifndef INJECTLIB_PYTHON
+        QSKIP("no Python interpreter found at configure time");
+#else
+        QJsonObject doc = tree();
+        doc["edge_cases"] = QJsonObject{
+            { "negative", -5 },          { "large", 1099511627776.0 }, { "fraction", 0.5 },
+            { "tiny", -1e-300 },         { "flags", QJsonArray{ true, false, QJsonValue() } },
+            { "text", QStringLiteral("äöü ✓ \U0001F600") },
+            { "empty", QJsonObject() },  { "none", QJsonArray() },
+        };
+        const QByteArray encoded = QCborValue::fromJsonValue(doc).toCbor();
+
+        // Python decodes what the server writes...
+        const QByteArray json = python(encoded, { QStringLiteral("--json") });
+        QVERIFY(!json.isEmpty());
+        QCOMPARE(QJsonDocument::fromJson(json).object(), doc);
+
+        // ...and the server decodes what Python writes.
+        const QByteArray reencoded = python(encoded);
+        QVERIFY(!reencoded.isEmpty());
+        QCborParserError error;
+        const QCborValue decoded = QCborValue::fromCbor(reencoded, &error);
+        QVERIFY2(error.error == QCborError::NoError, qPrintable(error.errorString()));
+        QCOMPARE(decoded.toMap().toJsonObject(), doc);
+#endif
+    }
+
+    void cleanupTestCase() {
+        QtHelloServer::instance()->stop();
+    }
+};
+
+QTEST_MAIN(TestCbor)
+#include "test_cbor.moc"
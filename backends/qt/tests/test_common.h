@@ -0,0 +1,136 @@
+#pragma once
+
+#include <QByteArray>
+#include <QCborMap>
+#include <QCborValue>
+#include <QCoreApplication>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QLocalSocket>
+#include <QSignalSpy>
+#include <QTest>
+
+#include <atomic>
+#include <thread>
+
+#include "qt_frame_decoder.h"
+#include "qt_server.h"
+
+// Helpers shared by the offscreen tests. The server core runs in the test process itself:
+// requests either go straight to QtHelloServer on the GUI thread (handle_request), or
+// through the network thread over a local socket (TestClient).
+
+// One request through QtHelloServer::handleRequest, the way the GUI thread dispatches it.
+inline QJsonObject handle_request(const QString& method, const QJsonObject& params = QJsonObject(),
+                                  int requestId = 1) {
+    QtHelloServer::PendingRequest pending;
+    pending.req["id"]     = requestId;
+    pending.req["method"] = method;
+    pending.req["params"] = params;
+    pending.reply = [](const QJsonObject&) {};
+    pending.push  = [](const QJsonObject&) {};
+    pending.queued.start();
+    return QtHelloServer::instance()->handleRequest(pending);
+}
+
+// Starts the server on a local socket named after the test process. Returns the full
+// server name, empty if it didn't come up. GUI thread.
+inline QString start_local_server() {
+    qputenv("QT_INJECTED_TRANSPORT", "local");
+    qputenv("QT_INJECTED_LOCAL_NAME",
+            QByteArray("injectlib-test-") + QByteArray::number(QCoreApplication::applicationPid()));
+
+    QtHelloServer* server = QtHelloServer::instance();
+    if (server->isRunning())
+        return server->localServerName();
+    QSignalSpy started(server, &QtHelloServer::startedLocal);
+    server->start();
+    if (!started.wait(5000))
+        return QString();
+    return started.first().first().toString();
+}
+
+// Runs fn on a thread of its own while the calling (GUI) thread keeps processing events,
+// so that the server can answer what fn sends. fn must finish on its own (use timeouts).
+template <typename Fn>
+void run_client(Fn fn) {
+    std::atomic<bool> done{ false };
+    std::thread client([&]() { fn(); done.store(true); });
+    while (!done.load())
+        QTest::qWait(1);
+    client.join();
+}
+
+// Blocking client of the server's text framing. It never runs an event loop, so it is meant
+// for a client thread (see run_client); create and use it on that thread.
+class TestClient {
+public:
+    bool connectTo(const QString& name, int timeoutMs = 5000) {
+        m_socket.connectToServer(name);
+        return m_socket.waitForConnected(timeoutMs);
+    }
+
+    bool sendRaw(const QByteArray& bytes) {
+        if (m_socket.write(bytes) != bytes.size())
+            return false;
+        return m_socket.waitForBytesWritten(5000) || m_socket.bytesToWrite() == 0;
+    }
+
+    bool send(const QJsonObject& req) {
+        if (m_cbor) {
+            const QByteArray payload = QCborValue::fromJsonValue(req).toCbor();
+            const quint32 n = static_cast<quint32>(payload.size());
+            const char prefix[4] = { char(n >> 24), char(n >> 16), char(n >> 8), char(n) };
+            return sendRaw(QByteArray(prefix, 4) + payload);
+        }
+        const QByteArray payload = QJsonDocument(req).toJson(QJsonDocument::Compact);
+        return sendRaw(QByteArray::number(payload.size()) + "\n" + payload);
+    }
+
+    // Switches both directions to CBOR frames; call once session.setEncoding has been answered.
+    void useCbor() {
+        m_cbor = true;
+        m_decoder.setBinary(true);
+    }
+
+    // Next frame from the server, empty on timeout, error or disconnect.
+    QJsonObject read(int timeoutMs = 5000) {
+        QByteArray payload;
+        for (;;) {
+            const FrameDecoder::Result r = m_decoder.next(payload);
+            if (r == FrameDecoder::Result::Frame) {
+                if (m_cbor)
+                    return QCborValue::fromCbor(payload).toMap().toJsonObject();
+                return QJsonDocument::fromJson(payload).object();
+            }
+            if (r == FrameDecoder::Result::Error)
+                return QJsonObject();
+            if (m_decoder.readFrom(&m_socket) <= 0 && !m_socket.waitForReadyRead(timeoutMs))
+                return QJsonObject();
+        }
+    }
+
+    // Sends req and returns the first frame carrying its id (streamed chunks included).
+    QJsonObject call(const QJsonObject& req, int timeoutMs = 5000) {
+        if (!send(req))
+            return QJsonObject();
+        for (;;) {
+            const QJsonObject frame = read(timeoutMs);
+            if (frame.isEmpty() || frame.value("id") == req.value("id"))
+                return frame;
+        }
+    }
+
+    bool connected() const { return m_socket.state() == QLocalSocket::ConnectedState; }
+
+    // True once the server has closed the connection.
+    bool waitForDisconnected(int timeoutMs = 5000) {
+        return m_socket.state() == QLocalSocket::UnconnectedState || m_socket.waitForDisconnected(timeoutMs);
+    }
+
+private:
+    QLocalSocket m_socket;
+    FrameDecoder m_decoder;
+    bool m_cbor = false;
+};
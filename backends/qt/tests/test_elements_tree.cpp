@@ -0,0 +1,132 @@
+#include <QApplication>
+#include <QGroupBox>
+#include <QHash>
+#include <QPushButton>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include "test_common.h"
+
+// elements.tree: one reply for a whole subtree, breadth-first, with parent/depth links.
+class TestElementsTree : public QObject {
+    Q_OBJECT
+
+    static constexpr int kGroups  = 3;
+    static constexpr int kButtons = 4;
+
+    QWidget m_window;
+    int m_rootId = 0;
+
+    QJsonArray tree(const QJsonObject& extra, QJsonObject* result = nullptr) {
+        QJsonObject params = extra;
+        params["id"] = m_rootId;
+        const QJsonObject resp = handle_request(QStringLiteral("elements.tree"), params);
+        if (result)
+            *result = resp.value("result").toObject();
+        return resp.value("result").toObject().value("nodes").toArray();
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Tree test"));
+        auto* layout = new QVBoxLayout(&m_window);
+        for (int g = 0; g < kGroups; ++g) {
+            auto* group = new QGroupBox(QStringLiteral("Group %1").arg(g));
+            group->setObjectName(QStringLiteral("group%1").arg(g));
+            auto* inner = new QVBoxLayout(group);
+            for (int b = 0; b < kButtons; ++b)
+                inner->addWidget(new QPushButton(QStringLiteral("Button %1.%2").arg(g).arg(b)));
+            layout->addWidget(group);
+        }
+        m_window.show();
+
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"),
+                                                { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == m_window.windowTitle())
+                m_rootId = v.toObject().value("id").toInt();
+        }
+        QVERIFY(m_rootId > 0);
+    }
+
+    void wholeSubtreeWithParentLinks() {
+        QJsonObject result;
+        const QJsonArray nodes = tree(QJsonObject(), &result);
+        QCOMPARE(nodes.size(), 1 + kGroups + kGroups * kButtons);
+        QCOMPARE(result.value("root").toInt(), m_rootId);
+        QCOMPARE(result.value("truncated").toBool(), false);
+
+        const QJsonObject root = nodes.first().toObject();
+        QCOMPARE(root.value("id").toInt(), m_rootId);
+        QCOMPARE(root.value("parent").toInt(), 0);
+        QCOMPARE(root.value("depth").toInt(), 0);
+
+        // Breadth-first: every parent comes before its children, one level deeper.
+        QHash<int, int> depthOf;
+        int lastDepth = 0;
+        for (const QJsonValue& v : nodes) {
+            const QJsonObject n = v.toObject();
+            const int id = n.value("id").toInt();
+            const int depth = n.value("depth").toInt();
+            QVERIFY(!depthOf.contains(id));
+            QVERIFY(depth >= lastDepth);
+            if (id != m_rootId) {
+                QVERIFY(depthOf.contains(n.value("parent").toInt()));
+                QCOMPARE(depth, depthOf.value(n.value("parent").toInt()) + 1);
+            }
+            depthOf.insert(id, depth);
+            lastDepth = depth;
+        }
+
+        // The summaries are the ones elements.children returns.
+        const QJsonArray children = handle_request(QStringLiteral("elements.children"),
+                                                   { { "id", m_rootId } })
+                                            .value("result").toArray();
+        QCOMPARE(children.size(), kGroups);
+        QJsonObject fromTree = nodes.at(1).toObject();
+        fromTree.remove("parent");
+        fromTree.remove("depth");
+        QCOMPARE(fromTree, children.first().toObject());
+    }
+
+    void maxDepth() {
+        const QJsonArray nodes = tree({ { "max_depth", 1 } });
+        QCOMPARE(nodes.size(), 1 + kGroups);
+        for (const QJsonValue& v : nodes)
+            QVERIFY(v.toObject().value("depth").toInt() <= 1);
+    }
+
+    void maxNodesTruncates() {
+        QJsonObject result;
+        const QJsonArray nodes = tree({ { "max_nodes", 5 } }, &result);
+        QCOMPARE(nodes.size(), 5);
+        QCOMPARE(result.value("truncated").toBool(), true);
+    }
+
+    void fieldsLimitTheSummaries() {
+        const QJsonArray nodes = tree({ { "fields", QJsonArray{ "name", "class" } } });
+        QVERIFY(!nodes.isEmpty());
+        for (const QJsonValue& v : nodes) {
+            const QJsonObject n = v.toObject();
+            QVERIFY(n.contains("id") && n.contains("name") && n.contains("class"));
+            QVERIFY(n.contains("parent") && n.contains("depth"));
+            QVERIFY(!n.contains("rect") && !n.contains("visible") && !n.contains("control_type"));
+        }
+    }
+
+    void unknownRootIsAnError() {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.tree"), { { "id", 0x7fffffff } });
+        QCOMPARE(resp.value("error").toObject().value("code").toInt(), -32602);
+    }
+
+    void destroyedElementsDropOut() {
+        QWidget* extra = new QPushButton(QStringLiteral("Short-lived"), m_window.findChild<QGroupBox*>("group0"));
+        const int before = tree(QJsonObject()).size();
+        delete extra;
+        QCOMPARE(tree(QJsonObject()).size(), before - 1);
+    }
+};
+
+QTEST_MAIN(TestElementsTree)
+#include "test_elements_tree.moc"
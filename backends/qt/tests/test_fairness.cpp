@@ -0,0 +1,143 @@
+#include <QApplication>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QLabel>
+#include <QMetaObject>
+#include <QWidget>
+
+#include <functional>
+
+#include "test_common.h"
+
+// Two connections on one server: a large bulk request (elements.tree, elements.treeDelta,
+// scene.items) on one must not hold back cheap requests on the other. Bulk requests run in
+// slices of QT_INJECTED_SLICE_MS and elements.info gets in between them. Requests go
+// through QtHelloServer::submit, the way the network thread hands them over.
+class TestFairness : public QObject {
+    Q_OBJECT
+
+    static constexpr int kGroups = 200;
+    static constexpr int kLabels = 100;
+    static constexpr int kItems  = 50000;
+
+    QWidget m_window;
+    QGraphicsScene m_scene;
+    QGraphicsView m_view;
+    int m_rootId = 0;
+    int m_viewId = 0;
+
+    static void submit(quint64 conn, const QJsonObject& req, std::function<void(const QJsonObject&)> reply) {
+        QtHelloServer::PendingRequest pending;
+        pending.req   = req;
+        pending.reply = std::move(reply);
+        pending.push  = [](const QJsonObject&) {};
+        pending.conn  = conn;
+        pending.queued.start();
+        QtHelloServer::instance()->submit(pending);
+    }
+
+    int rootId(const QString& title) {
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"),
+                                                { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == title)
+                return v.toObject().value("id").toInt();
+        }
+        return 0;
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Fairness"));
+        for (int g = 0; g < kGroups; ++g) {
+            auto* group = new QWidget(&m_window);
+            for (int l = 0; l < kLabels; ++l)
+                new QLabel(QStringLiteral("%1.%2").arg(g).arg(l), group);
+        }
+        m_window.show();
+
+        for (int i = 0; i < kItems; ++i)
+            m_scene.addRect(i % 250 * 4, i / 250 * 4, 3, 3);
+        m_view.setScene(&m_scene);
+        m_view.setWindowTitle(QStringLiteral("Fairness scene"));
+        m_view.show();
+
+        m_rootId = rootId(m_window.windowTitle());
+        m_viewId = rootId(m_view.windowTitle());
+        QVERIFY(m_rootId > 0);
+        QVERIFY(m_viewId > 0);
+
+        // Short slices, and a scene page large enough to take several of them.
+        qputenv("QT_INJECTED_SLICE_MS", "2");
+        qputenv("QT_INJECTED_MAX_SCENE_PAGE", QByteArray::number(kItems));
+        QVERIFY(!start_local_server().isEmpty());
+    }
+
+    void infoOvertakesBulkOnAnotherConnection_data() {
+        QTest::addColumn<QString>("method");
+        QTest::addColumn<bool>("onScene");
+        QTest::addColumn<QString>("key");
+        QTest::addColumn<int>("count");
+
+        const int nodes = 1 + kGroups + kGroups * kLabels;
+        QTest::newRow("elements.tree")      << "elements.tree" << false << "nodes" << nodes;
+        QTest::newRow("elements.treeDelta") << "elements.treeDelta" << false << "added" << nodes;
+        QTest::newRow("scene.items")        << "scene.items" << true << "items" << kItems;
+    }
+
+    void infoOvertakesBulkOnAnotherConnection() {
+        QFETCH(QString, method);
+        QFETCH(bool, onScene);
+        QFETCH(QString, key);
+        QFETCH(int, count);
+
+        QJsonObject params{ { "id", onScene ? m_viewId : m_rootId } };
+        if (onScene)
+            params["limit"] = kItems;
+        QJsonObject bulk;
+        bool bulkDone = false;
+        submit(1, { { "id", 1 }, { "method", method }, { "timing", true }, { "params", params } },
+               [&](const QJsonObject& resp) { bulk = resp; bulkDone = true; });
+
+        // One elements.info at a time on connection 2; the next goes out from the event loop
+        // after a reply, i.e. behind the bulk slice of the same pass.
+        int infosDuringBulk = 0;
+        bool infoFailed = false;
+        bool infoPending = false;
+        std::function<void()> sendInfo = [&]() {
+            infoPending = true;
+            submit(2, { { "id", 2 }, { "method", "elements.info" }, { "params", QJsonObject{ { "id", m_rootId } } } },
+                   [&](const QJsonObject& resp) {
+                       infoFailed = infoFailed || !resp.contains("result");
+                       if (bulkDone) {
+                           infoPending = false;
+                           return;
+                       }
+                       ++infosDuringBulk;
+                       QMetaObject::invokeMethod(this, [&]() { sendInfo(); }, Qt::QueuedConnection);
+                   });
+        };
+        sendInfo();
+        QTRY_VERIFY_WITH_TIMEOUT(bulkDone && !infoPending, 60000);
+
+        QVERIFY(!infoFailed);
+        QCOMPARE(bulk.value("result").toObject().value(key).toArray().size(), count);
+        const int slices = bulk.value("timing").toObject().value("slices").toInt();
+        QVERIFY2(slices > 1, qPrintable(QStringLiteral("%1 ran in %2 slice(s)").arg(method).arg(slices)));
+        // The first info overtakes the queued bulk request; every further one was sent after a
+        // bulk slice had run, so the bulk request let it in before finishing.
+        QVERIFY2(infosDuringBulk >= 2,
+                 qPrintable(QStringLiteral("%1 elements.info replies during %2").arg(infosDuringBulk).arg(method)));
+
+        QtHelloServer::instance()->connectionClosed(1);
+        QtHelloServer::instance()->connectionClosed(2);
+    }
+
+    void cleanupTestCase() {
+        QtHelloServer::instance()->stop();
+    }
+};
+
+QTEST_MAIN(TestFairness)
+#include "test_fairness.moc"
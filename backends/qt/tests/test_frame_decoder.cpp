@@ -0,0 +1,238 @@
+#include <QLocalServer>
+#include <QRandomGenerator>
+#include <QVector>
+
+#include "test_common.h"
+
+// FrameDecoder against fragmented, coalesced and malformed input, in memory and over a
+// local socket, and the server dropping a client that sends a bad header.
+class TestFrameDecoder : public QObject {
+    Q_OBJECT
+
+    static QByteArray textFrame(const QByteArray& payload) {
+        return QByteArray::number(payload.size()) + "\n" + payload;
+    }
+
+    static QByteArray binaryFrame(const QByteArray& payload) {
+        const quint32 n = static_cast<quint32>(payload.size());
+        const char prefix[4] = { char(n >> 24), char(n >> 16), char(n >> 8), char(n) };
+        return QByteArray(prefix, 4) + payload;
+    }
+
+    // Payload i: recognizable content, sizes from a few bytes to several times the
+    // decoder's initial buffer.
+    static QByteArray payload(QRandomGenerator& rng, int i) {
+        const int size = (i % 17 == 0) ? rng.bounded(100000, 300000) : rng.bounded(1, 2000);
+        QByteArray p(size, 'a' + i % 26);
+        p.replace(0, qMin(size, 8), QByteArray::number(i).leftJustified(8, ' ', true).left(size));
+        return p;
+    }
+
+    // Everything decoded so far (copies: the views die with the next append).
+    static bool drain(FrameDecoder& d, QVector<QByteArray>& out) {
+        QByteArray p;
+        FrameDecoder::Result r;
+        while ((r = d.next(p)) == FrameDecoder::Result::Frame)
+            out.push_back(QByteArray(p.constData(), p.size()));
+        return r != FrameDecoder::Result::Error;
+    }
+
+    static FrameDecoder::Result decodeOne(const QByteArray& bytes, int maxFrame = 1024) {
+        FrameDecoder d(maxFrame);
+        d.append(bytes.constData(), bytes.size());
+        QByteArray p;
+        return d.next(p);
+    }
+
+private slots:
+    void everySplitPoint() {
+        const QVector<QByteArray> payloads = { "{}", "{\"id\":1}", QByteArray(300, 'x'), "z" };
+        QByteArray stream;
+        for (const QByteArray& p : payloads)
+            stream += textFrame(p);
+
+        for (int a = 0; a <= stream.size(); ++a) {
+            for (int b = a; b <= stream.size(); b += 7) {
+                FrameDecoder d;
+                QVector<QByteArray> got;
+                d.append(stream.constData(), a);
+                QVERIFY(drain(d, got));
+                d.append(stream.constData() + a, b - a);
+                QVERIFY(drain(d, got));
+                d.append(stream.constData() + b, stream.size() - b);
+                QVERIFY(drain(d, got));
+                QVERIFY(got == payloads);
+                QCOMPARE(d.buffered(), 0);
+            }
+        }
+    }
+
+    void randomFragmentationFuzz() {
+        QRandomGenerator rng(12345);
+        for (int round = 0; round < 20; ++round) {
+            QVector<QByteArray> payloads;
+            QByteArray stream;
+            for (int i = 0; i < 200; ++i) {
+                payloads.push_back(payload(rng, i));
+                stream += textFrame(payloads.back());
+            }
+
+            FrameDecoder d(1024 * 1024);
+            QVector<QByteArray> got;
+            for (int pos = 0; pos < stream.size();) {
+                // Mostly small reads, sometimes many frames at once.
+                const int n = qMin(stream.size() - pos, rng.bounded(8) == 0 ? rng.bounded(1, 500000)
+                                                                            : rng.bounded(1, 1500));
+                d.append(stream.constData() + pos, n);
+                pos += n;
+                QVERIFY(drain(d, got));
+            }
+            QCOMPARE(got.size(), payloads.size());
+            QVERIFY(got == payloads);
+        }
+    }
+
+    void switchToBinaryBetweenFrames() {
+        QByteArray stream = textFrame("text") + binaryFrame("binary one") + binaryFrame(QByteArray(70000, 'b'));
+        FrameDecoder d;
+        d.append(stream.constData(), stream.size());
+        QByteArray p;
+        QVERIFY(d.next(p) == FrameDecoder::Result::Frame);
+        QCOMPARE(p, QByteArray("text"));
+        d.setBinary(true);
+        QVERIFY(d.next(p) == FrameDecoder::Result::Frame);
+        QCOMPARE(p, QByteArray("binary one"));
+        QVERIFY(d.next(p) == FrameDecoder::Result::Frame);
+        QCOMPARE(p.size(), 70000);
+        QVERIFY(d.next(p) == FrameDecoder::Result::NeedMore);
+    }
+
+    void headers_data() {
+        QTest::addColumn<QByteArray>("bytes");
+        QTest::addColumn<int>("result");
+        const int frame = int(FrameDecoder::Result::Frame);
+        const int error = int(FrameDecoder::Result::Error);
+        const int more  = int(FrameDecoder::Result::NeedMore);
+        QTest::newRow("plain")          << QByteArray("2\n{}")        << frame;
+        QTest::newRow("crlf")           << QByteArray("2\r\n{}")      << frame;
+        QTest::newRow("blanks around")  << QByteArray(" \t2 \r\n{}")  << frame;
+        QTest::newRow("leading zeros")  << QByteArray("0002\n{}")     << frame;
+        QTest::newRow("partial")        << QByteArray("2\n{")         << more;
+        QTest::newRow("no newline yet") << QByteArray("12")           << more;
+        QTest::newRow("blank inside")   << QByteArray("1 2\n{}")      << error;
+        QTest::newRow("letters")        << QByteArray("1a\n{}")       << error;
+        QTest::newRow("sign")           << QByteArray("-2\n{}")       << error;
+        QTest::newRow("plus")           << QByteArray("+2\n{}")       << error;
+        QTest::newRow("zero")           << QByteArray("0\n")          << error;
+        QTest::newRow("empty")          << QByteArray("\n{}")         << error;
+        QTest::newRow("oversized")      << QByteArray("1025\n")       << error;
+        QTest::newRow("huge")           << QByteArray("99999999999999\n") << error;
+        QTest::newRow("header too long") << QByteArray(FrameDecoder::kMaxHeader + 1, '1') << error;
+    }
+
+    void headers() {
+        QFETCH(QByteArray, bytes);
+        QFETCH(int, result);
+        QCOMPARE(int(decodeOne(bytes)), result);
+    }
+
+    void garbageNeverCrashes() {
+        QRandomGenerator rng(777);
+        for (int round = 0; round < 2000; ++round) {
+            QByteArray bytes(rng.bounded(1, 64), Qt::Uninitialized);
+            for (char& ch : bytes)
+                ch = "0123456789 \r\n\t{}x"[rng.bounded(17)];
+            FrameDecoder d(256);
+            QByteArray p;
+            for (int pos = 0; pos < bytes.size(); ++pos) {
+                d.append(bytes.constData() + pos, 1);
+                FrameDecoder::Result r;
+                while ((r = d.next(p)) == FrameDecoder::Result::Frame)
+                    QVERIFY(p.size() > 0 && p.size() <= 256);
+                if (r == FrameDecoder::Result::Error) {
+                    // Errors are final.
+                    d.append("2\n{}", 4);
+                    QVERIFY(d.next(p) == FrameDecoder::Result::Error);
+                    break;
+                }
+            }
+        }
+    }
+
+    void overLocalSocket() {
+        QLocalServer server;
+        const QString name = QStringLiteral("injectlib-decoder-%1").arg(QCoreApplication::applicationPid());
+        QLocalServer::removeServer(name);
+        QVERIFY(server.listen(name));
+
+        QRandomGenerator rng(4242);
+        QVector<QByteArray> payloads;
+        QByteArray stream;
+        for (int i = 0; i < 500; ++i) {
+            payloads.push_back(payload(rng, i));
+            stream += textFrame(payloads.back());
+        }
+
+        // Writer: random write sizes, each flushed on its own, so the reader sees fragments
+        // as well as several frames coalesced into one read.
+        std::thread writer([&]() {
+            QLocalSocket s;
+            s.connectToServer(name);
+            if (!s.waitForConnected(5000))
+                return;
+            QRandomGenerator wrng(99);
+            for (int pos = 0; pos < stream.size();) {
+                const int n = qMin(stream.size() - pos, wrng.bounded(1, 40000));
+                s.write(stream.constData() + pos, n);
+                s.waitForBytesWritten(5000);
+                pos += n;
+            }
+            while (s.bytesToWrite() > 0 && s.waitForBytesWritten(5000)) {}
+            s.disconnectFromServer();
+            if (s.state() != QLocalSocket::UnconnectedState)
+                s.waitForDisconnected(5000);
+        });
+
+        QVERIFY(server.waitForNewConnection(5000));
+        QLocalSocket* reader = server.nextPendingConnection();
+        FrameDecoder d(1024 * 1024);
+        QVector<QByteArray> got;
+        int reads = 0;
+        while (got.size() < payloads.size()) {
+            if (d.readFrom(reader) <= 0 && !reader->waitForReadyRead(5000))
+                break;
+            ++reads;
+            QVERIFY(drain(d, got));
+        }
+        writer.join();
+
+        QCOMPARE(got.size(), payloads.size());
+        QVERIFY(got == payloads);
+        QVERIFY(reads > 1);
+    }
+
+    void serverDropsOnlyTheMalformedClient() {
+        const QString name = start_local_server();
+        QVERIFY(!name.isEmpty());
+
+        bool dropped = false;
+        QJsonObject after;
+        run_client([&]() {
+            TestClient bad;
+            TestClient good;
+            if (!bad.connectTo(name) || !good.connectTo(name))
+                return;
+            // The old parser read this as 12 and kept waiting for the payload.
+            bad.sendRaw("1 2\n{}");
+            dropped = bad.waitForDisconnected(2000);
+            after = good.call({ { "id", 3 }, { "method", "ping" } });
+        });
+
+        QVERIFY(dropped);
+        QCOMPARE(after.value("id").toInt(), 3);
+        QtHelloServer::instance()->stop();
+    }
+};
+
+QTEST_MAIN(TestFrameDecoder)
+#include "test_frame_decoder.moc"
@@ -0,0 +1,137 @@
+#include <QApplication>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QGraphicsWidget>
+#include <QSet>
+
+#include <memory>
+
+#include "qt_id_table.h"
+#include "test_common.h"
+
+// ElementIdTable on its own: stable ids while elements live, stale ids once they are gone,
+// and no id ever handed out twice.
+class TestIdTable : public QObject {
+    Q_OBJECT
+
+private slots:
+    void objectIdsAreStable() {
+        ElementIdTable t;
+        QObject a, b;
+        const int ia = t.idForObject(&a);
+        QVERIFY(ia > 0);
+        QCOMPARE(t.idForObject(&a), ia);
+        QCOMPARE(t.find(&a), ia);
+        QVERIFY(t.idForObject(&b) != ia);
+        QCOMPARE(t.object(ia), &a);
+        QCOMPARE(t.size(), 2);
+        QCOMPARE(t.find(nullptr), 0);
+        QCOMPARE(t.idForObject(nullptr), 0);
+    }
+
+    void deletedObjectsGoStale() {
+        ElementIdTable t;
+        auto* obj = new QObject;
+        const int id = t.idForObject(obj);
+        delete obj;
+        QCOMPARE(t.object(id), nullptr);
+        QCOMPARE(t.size(), 0);
+
+        // The slot is reused under a new generation; the old id stays dead.
+        QObject other;
+        const int reused = t.idForObject(&other);
+        QVERIFY(reused != id);
+        QCOMPARE(t.object(id), nullptr);
+        QCOMPARE(t.object(reused), &other);
+    }
+
+    void idsNeverRepeat() {
+        // 1024 generations per slot: the slot is retired after that instead of wrapping.
+        ElementIdTable t;
+        QSet<int> seen;
+        for (int i = 0; i < 1100; ++i) {
+            QObject obj;
+            const int id = t.idForObject(&obj);
+            QVERIFY(id > 0);
+            QVERIFY2(!seen.contains(id), qPrintable(QStringLiteral("id %1 repeated").arg(id)));
+            seen.insert(id);
+            t.release(id);
+            QCOMPARE(t.object(id), nullptr);
+        }
+        QCOMPARE(t.retired(), 1);
+        QCOMPARE(t.size(), 0);
+    }
+
+    void plainItemsFollowTheirScene() {
+        ElementIdTable t;
+        QGraphicsScene scene;
+        QGraphicsItem* item = scene.addRect(0, 0, 10, 10);
+        const int id = t.idForItem(item);
+        QVERIFY(id > 0);
+        QCOMPARE(t.idForItem(item), id);
+        QCOMPARE(t.graphicsItem(id), item);
+        QCOMPARE(t.object(id), nullptr);
+
+        // Deleted while the scene lives on: caught on the next pass.
+        delete item;
+        t.newPass();
+        QCOMPARE(t.graphicsItem(id), nullptr);
+        QCOMPARE(t.size(), 0);
+    }
+
+    void plainItemsDieWithTheirScene() {
+        ElementIdTable t;
+        auto scene = std::make_unique<QGraphicsScene>();
+        const int id = t.idForItem(scene->addRect(0, 0, 10, 10));
+        scene.reset();
+        QCOMPARE(t.graphicsItem(id), nullptr);
+    }
+
+    void sceneLessItemsUnderAGraphicsObjectAreStable() {
+        ElementIdTable t;
+        QGraphicsWidget parent; // a QGraphicsObject without a scene
+        QGraphicsItem* child = new QGraphicsRectItem(0, 0, 5, 5, &parent);
+        const int id = t.idForItem(child);
+        QVERIFY(id > 0);
+        QCOMPARE(t.idForItem(child), id);
+        t.newPass();
+        QCOMPARE(t.graphicsItem(id), child);
+
+        delete child;
+        t.newPass();
+        QCOMPARE(t.graphicsItem(id), nullptr);
+    }
+
+    void ownerlessItemsGetNoId() {
+        ElementIdTable t;
+        QGraphicsRectItem loose(0, 0, 5, 5);
+        QCOMPARE(t.idForItem(&loose), 0);
+        QCOMPARE(t.size(), 0);
+        QVERIFY(!t.takeOverflow());
+    }
+
+    void graphicsObjectsHaveOneId() {
+        ElementIdTable t;
+        QGraphicsScene scene;
+        auto* w = new QGraphicsWidget;
+        scene.addItem(w);
+        const int id = t.idForItem(w);
+        QCOMPARE(t.idForObject(w), id);
+        QCOMPARE(t.find(w), id);
+        QCOMPARE(t.graphicsItem(id), static_cast<QGraphicsItem*>(w));
+    }
+
+    void accessibleIdsFollowTheirOwner() {
+        ElementIdTable t;
+        auto* owner = new QObject;
+        const int id = t.idForAccessible(42, owner);
+        QVERIFY(id > 0);
+        QCOMPARE(t.idForAccessible(42, owner), id);
+        QCOMPARE(t.accessibleId(id), 42u);
+        delete owner;
+        QCOMPARE(t.accessibleId(id), 0u);
+    }
+};
+
+QTEST_MAIN(TestIdTable)
+#include "test_id_table.moc"
@@ -0,0 +1,179 @@
+#include <QAbstractTableModel>
+#include <QApplication>
+#include <QTableView>
+
+#include <climits>
+
+#include "test_common.h"
+
+namespace {
+
+// rows x columns of generated text; records which rows data() was asked for.
+class BigModel : public QAbstractTableModel {
+public:
+    BigModel(int rows, int columns) : m_rows(rows), m_columns(columns) {}
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : m_rows;
+    }
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override {
+        return parent.isValid() ? 0 : m_columns;
+    }
+    QVariant data(const QModelIndex& index, int role) const override {
+        if (role != Qt::DisplayRole)
+            return QVariant();
+        ++calls;
+        minRow = qMin(minRow, index.row());
+        maxRow = qMax(maxRow, index.row());
+        return QStringLiteral("r%1c%2").arg(index.row()).arg(index.column());
+    }
+
+    void resetCounters() {
+        calls = 0;
+        minRow = INT_MAX;
+        maxRow = -1;
+    }
+
+    mutable int calls = 0;
+    mutable int minRow = INT_MAX;
+    mutable int maxRow = -1;
+
+private:
+    int m_rows;
+    int m_columns;
+};
+
+} // namespace
+
+// model.info / model.rows: pages of a huge model without touching the rest of it, and the
+// per-request cell limit for wide models.
+class TestModelRows : public QObject {
+    Q_OBJECT
+
+    static constexpr int kRows = 1000000;
+
+    BigModel m_model{ kRows, 8 };
+    BigModel m_wide{ 10000, 100 };
+    QTableView m_view;
+    QTableView m_wideView;
+    int m_viewId = 0;
+    int m_wideId = 0;
+
+    // Id of a top-level widget, as elements.roots reports it.
+    static int rootId(const QWidget& w) {
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"),
+                                                { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == w.windowTitle())
+                return v.toObject().value("id").toInt();
+        }
+        return 0;
+    }
+
+    static QJsonObject rows(int viewId, const QJsonObject& extra) {
+        QJsonObject params = extra;
+        params["id"] = viewId;
+        return handle_request(QStringLiteral("model.rows"), params);
+    }
+
+private slots:
+    void initTestCase() {
+        m_view.setWindowTitle(QStringLiteral("Blotter"));
+        m_view.setModel(&m_model);
+        m_view.setSelectionBehavior(QAbstractItemView::SelectRows);
+        m_view.resize(800, 600);
+        m_view.show();
+        m_wideView.setWindowTitle(QStringLiteral("Wide blotter"));
+        m_wideView.setModel(&m_wide);
+        m_wideView.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&m_view));
+
+        m_viewId = rootId(m_view);
+        m_wideId = rootId(m_wideView);
+        QVERIFY(m_viewId > 0 && m_wideId > 0);
+    }
+
+    void info() {
+        const QJsonObject r = handle_request(QStringLiteral("model.info"), { { "id", m_viewId } })
+                                  .value("result").toObject();
+        QCOMPARE(r.value("rows").toInt(), kRows);
+        QCOMPARE(r.value("columns").toInt(), 8);
+        QCOMPARE(r.value("headers").toArray().size(), 8);
+    }
+
+    void pageTouchesOnlyItsRows() {
+        m_model.resetCounters();
+        const QJsonObject r = rows(m_viewId, { { "row", 500000 }, { "count", 100 } }).value("result").toObject();
+
+        const QJsonArray items = r.value("items").toArray();
+        QCOMPARE(items.size(), 100);
+        QCOMPARE(r.value("rows").toInt(), kRows);
+        QCOMPARE(r.value("row").toInt(), 500000);
+        QVERIFY(!r.contains("truncated"));
+
+        const QJsonObject first = items.first().toObject();
+        QCOMPARE(first.value("row").toInt(), 500000);
+        const QJsonArray cells = first.value("cells").toArray();
+        QCOMPARE(cells.size(), 8);
+        QCOMPARE(cells.at(3).toObject().value("text").toString(), QStringLiteral("r500000c3"));
+        QCOMPARE(items.last().toObject().value("row").toInt(), 500099);
+
+        QCOMPARE(m_model.minRow, 500000);
+        QCOMPARE(m_model.maxRow, 500099);
+        QCOMPARE(m_model.calls, 100 * 8);
+    }
+
+    void clampedToTheModel() {
+        const QJsonObject r = rows(m_viewId, { { "row", kRows - 50 }, { "count", 100 },
+                                               { "column", 6 }, { "columns", 5 } })
+                                  .value("result").toObject();
+        QCOMPARE(r.value("items").toArray().size(), 50);
+        QCOMPARE(r.value("column").toInt(), 6);
+        QCOMPARE(r.value("headers").toArray().size(), 2);
+        QCOMPARE(r.value("items").toArray().first().toObject().value("cells").toArray().size(), 2);
+    }
+
+    void fieldsAndSelection() {
+        m_view.selectRow(10);
+        const QJsonArray items = rows(m_viewId, { { "row", 9 }, { "count", 3 },
+                                                  { "fields", QJsonArray{ "selected" } } })
+                                     .value("result").toObject().value("items").toArray();
+        QCOMPARE(items.size(), 3);
+        for (int i = 0; i < 3; ++i) {
+            const QJsonObject cell = items.at(i).toObject().value("cells").toArray().first().toObject();
+            QVERIFY(!cell.contains("text") && !cell.contains("rect"));
+            QCOMPARE(cell.value("selected").toBool(), i == 1);
+        }
+    }
+
+    void visibleCellsHaveRects() {
+        const QJsonArray cells = rows(m_viewId, { { "row", 0 }, { "count", 1 } })
+                                     .value("result").toObject().value("items").toArray()
+                                     .first().toObject().value("cells").toArray();
+        const QJsonObject cell = cells.first().toObject();
+        QCOMPARE(cell.value("rect").toArray().size(), 4);
+        QCOMPARE(cell.value("visible").toBool(), true);
+    }
+
+    void wideModelsAreCappedByCells() {
+        // 1000 rows (the page limit) x 100 columns is over the 20000 cell default.
+        const QJsonObject capped = rows(m_wideId, { { "row", 0 }, { "count", 1000 } }).value("result").toObject();
+        QCOMPARE(capped.value("items").toArray().size(), 200);
+        QCOMPARE(capped.value("truncated").toBool(), true);
+
+        const QJsonObject narrow = rows(m_wideId, { { "row", 0 }, { "count", 1000 }, { "columns", 10 } })
+                                       .value("result").toObject();
+        QCOMPARE(narrow.value("items").toArray().size(), 1000);
+        QVERIFY(!narrow.contains("truncated"));
+    }
+
+    void errors() {
+        QCOMPARE(rows(0x7fffffff, QJsonObject()).value("error").toObject().value("code").toInt(), -32602);
+        QCOMPARE(rows(m_viewId, { { "parent", QJsonArray{ kRows } } })
+                     .value("error").toObject().value("code").toInt(), -32602);
+    }
+};
+
+QTEST_MAIN(TestModelRows)
+#include "test_model_rows.moc"
@@ -0,0 +1,222 @@
+#include <QApplication>
+#include <QCheckBox>
+#include <QColor>
+#include <QLineEdit>
+#include <QSpinBox>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#ifdef INJECTLIB_HAVE_QUICK
+#include <QQuickItem>
+#include <QQuickWindow>
+#endif
+
+#include "qt_property_reader.h"
+#include "test_common.h"
+
+// Property types the widgets don't cover: colors, enums and object references.
+class Gadget : public QObject {
+    Q_OBJECT
+    Q_PROPERTY(QColor color MEMBER color)
+    Q_PROPERTY(Mode mode MEMBER mode)
+    Q_PROPERTY(QObject* target MEMBER target)
+
+public:
+    enum Mode { Idle, Busy };
+    Q_ENUM(Mode)
+
+    QColor color = QColor(255, 0, 0);
+    Mode mode = Busy;
+    QObject* target = nullptr;
+};
+
+// elements.properties on widgets (and on Qt Quick items when built with Quick), and the
+// per-class index cache of PropertyReader behind it.
+class TestProperties : public QObject {
+    Q_OBJECT
+
+    QWidget m_window;
+    QLineEdit* m_edit = nullptr;
+    QCheckBox* m_check = nullptr;
+    QSpinBox* m_spin = nullptr;
+    QHash<QObject*, int> m_ids;
+
+    static QJsonArray read(const QJsonArray& ids, const QJsonArray& properties, QJsonObject* error = nullptr) {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.properties"),
+                                                { { "ids", ids }, { "properties", properties } });
+        if (error)
+            *error = resp.value("error").toObject();
+        return resp.value("result").toObject().value("items").toArray();
+    }
+
+    // Ids of the direct children of parentId, by objectName.
+    static QHash<QString, int> children(int parentId) {
+        QHash<QString, int> out;
+        const QJsonArray kids = handle_request(QStringLiteral("elements.children"),
+                                               { { "id", parentId }, { "fields", QJsonArray{ "auto_id" } } })
+                                        .value("result").toArray();
+        for (const QJsonValue& v : kids)
+            out.insert(v.toObject().value("auto_id").toString(), v.toObject().value("id").toInt());
+        return out;
+    }
+
+    static int rootId(const QString& title) {
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"),
+                                                { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == title)
+                return v.toObject().value("id").toInt();
+        }
+        return 0;
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Properties"));
+        auto* layout = new QVBoxLayout(&m_window);
+        m_edit = new QLineEdit(QStringLiteral("hello"));
+        m_edit->setObjectName(QStringLiteral("edit"));
+        m_edit->setProperty("tag", QStringLiteral("dynamic"));
+        m_check = new QCheckBox(QStringLiteral("Check"));
+        m_check->setObjectName(QStringLiteral("check"));
+        m_check->setChecked(true);
+        m_spin = new QSpinBox;
+        m_spin->setObjectName(QStringLiteral("spin"));
+        m_spin->setRange(0, 100);
+        m_spin->setValue(42);
+        layout->addWidget(m_edit);
+        layout->addWidget(m_check);
+        layout->addWidget(m_spin);
+        m_window.show();
+
+        const QHash<QString, int> ids = children(rootId(m_window.windowTitle()));
+        m_ids.insert(m_edit, ids.value(QStringLiteral("edit")));
+        m_ids.insert(m_check, ids.value(QStringLiteral("check")));
+        m_ids.insert(m_spin, ids.value(QStringLiteral("spin")));
+        for (int id : qAsConst(m_ids))
+            QVERIFY(id > 0);
+    }
+
+    void widgetsInOneCall() {
+        const QJsonArray items = read({ m_ids.value(m_edit), m_ids.value(m_check), m_ids.value(m_spin) },
+                                      { "objectName", "enabled", "text", "checked", "value", "geometry" });
+        QCOMPARE(items.size(), 3);
+
+        const QJsonObject edit = items.at(0).toObject();
+        QCOMPARE(edit.value("id").toInt(), m_ids.value(m_edit));
+        const QJsonObject ev = edit.value("values").toObject();
+        QCOMPARE(ev.value("text").toString(), QStringLiteral("hello"));
+        QCOMPARE(ev.value("objectName").toString(), QStringLiteral("edit"));
+        QCOMPARE(ev.value("enabled").toBool(), true);
+        QCOMPARE(ev.value("geometry").toArray().size(), 4);
+        // QLineEdit has neither "checked" nor "value".
+        QCOMPARE(edit.value("missing").toArray(), (QJsonArray{ "checked", "value" }));
+
+        QCOMPARE(items.at(1).toObject().value("values").toObject().value("checked").toBool(), true);
+        QCOMPARE(items.at(2).toObject().value("values").toObject().value("value").toInt(), 42);
+        QVERIFY(!items.at(2).toObject().value("values").toObject().contains("checked"));
+    }
+
+    void dynamicProperties() {
+        const QJsonArray items = read({ m_ids.value(m_edit) }, { "tag" });
+        QCOMPARE(items.first().toObject().value("values").toObject().value("tag").toString(),
+                 QStringLiteral("dynamic"));
+    }
+
+    void valuesFollowTheWidgets() {
+        m_spin->setValue(7);
+        const QJsonArray items = read({ m_ids.value(m_spin) }, { "value" });
+        QCOMPARE(items.first().toObject().value("values").toObject().value("value").toInt(), 7);
+    }
+
+    void unknownIdsAreReportedPerItem() {
+        const QJsonArray items = read({ 0x7fffffff, m_ids.value(m_edit) }, { "text" });
+        QCOMPARE(items.size(), 2);
+        QCOMPARE(items.at(0).toObject().value("error").toObject().value("code").toInt(), -32602);
+        QVERIFY(items.at(1).toObject().contains("values"));
+    }
+
+    void requestSizeIsLimited() {
+        QJsonObject error;
+        read(QJsonArray(), { "text" }, &error);
+        QCOMPARE(error.value("code").toInt(), -32602);
+
+        // 101 ids x 100 properties is over the default of 10000 reads.
+        QJsonArray ids;
+        QJsonArray props;
+        for (int i = 0; i < 101; ++i)
+            ids.push_back(m_ids.value(m_edit));
+        for (int i = 0; i < 100; ++i)
+            props.push_back(QStringLiteral("p%1").arg(i));
+        read(ids, props, &error);
+        QCOMPARE(error.value("code").toInt(), -32602);
+    }
+
+    void readerCachesPerClass() {
+        injectlib::PropertyReader reader;
+        QLineEdit a, b;
+        QCheckBox c;
+        QJsonArray missing;
+        reader.read(&a, { "text", "nope" }, &missing);
+        reader.read(&b, { "text", "nope" }, &missing);
+        QCOMPARE(reader.cachedClasses(), 1);
+        reader.read(&c, { "text" }, nullptr);
+        QCOMPARE(reader.cachedClasses(), 2);
+        QCOMPARE(missing, (QJsonArray{ "nope", "nope" }));
+        QCOMPARE(reader.indexOf(&b, "text"), b.metaObject()->indexOfProperty("text"));
+        QCOMPARE(reader.indexOf(&b, "nope"), -1);
+    }
+
+    void colorsEnumsAndObjects() {
+        injectlib::PropertyReader reader;
+        Gadget g;
+        Gadget other;
+        g.target = &other;
+        const QJsonObject v = reader.read(&g, { "color", "mode", "target" }, nullptr,
+                                          [&](QObject* o) { return o == &other ? 99 : 0; });
+        QCOMPARE(v.value("color").toString(), QStringLiteral("#ffff0000"));
+        QCOMPARE(v.value("mode").toString(), QStringLiteral("Busy"));
+        QCOMPARE(v.value("target").toInt(), 99);
+    }
+
+#ifdef INJECTLIB_HAVE_QUICK
+    void quickItems() {
+        // A scene built in C++: what matters is the QQuickItem tree, not where it came from.
+        QQuickWindow window;
+        window.setTitle(QStringLiteral("Quick scene"));
+        auto* panel = new QQuickItem(window.contentItem());
+        panel->setObjectName(QStringLiteral("panel"));
+        panel->setSize(QSizeF(200, 100));
+        for (int i = 0; i < 3; ++i) {
+            auto* child = new QQuickItem(panel);
+            child->setObjectName(QStringLiteral("item%1").arg(i));
+            child->setPosition(QPointF(10 * i, 5));
+            child->setSize(QSizeF(20, 20));
+        }
+
+        const int windowId = rootId(window.title());
+        QVERIFY(windowId > 0);
+        const QHash<QString, int> top = children(windowId);
+        QVERIFY(top.value(QStringLiteral("panel")) > 0);
+
+        const QJsonArray nodes = handle_request(QStringLiteral("elements.tree"),
+                                                { { "id", windowId }, { "fields", QJsonArray{ "name", "class" } } })
+                                         .value("result").toObject().value("nodes").toArray();
+        QCOMPARE(nodes.size(), 1 + 1 + 3);
+        QCOMPARE(nodes.last().toObject().value("depth").toInt(), 2);
+        QCOMPARE(nodes.last().toObject().value("name").toString(), QStringLiteral("item2"));
+
+        const QHash<QString, int> items = children(top.value(QStringLiteral("panel")));
+        QCOMPARE(items.size(), 3);
+        const QJsonArray values = read({ items.value(QStringLiteral("item0")), items.value(QStringLiteral("item2")) },
+                                       { "x", "width", "visible" });
+        QCOMPARE(values.at(0).toObject().value("values").toObject().value("x").toDouble(), 0.0);
+        QCOMPARE(values.at(1).toObject().value("values").toObject().value("x").toDouble(), 20.0);
+        QCOMPARE(values.at(1).toObject().value("values").toObject().value("width").toDouble(), 20.0);
+    }
+#endif
+};
+
+QTEST_MAIN(TestProperties)
+#include "test_properties.moc"
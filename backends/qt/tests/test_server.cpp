@@ -0,0 +1,99 @@
+#include <QApplication>
+#include <QElapsedTimer>
+#include <QPushButton>
+#include <QThread>
+#include <QVBoxLayout>
+#include <QWidget>
+
+#include "test_common.h"
+
+// The server as a whole: sockets and framing on the network thread, widget work on the GUI
+// thread, per-request GUI time in "timing".
+class TestServer : public QObject {
+    Q_OBJECT
+
+    QString m_name;
+    QWidget m_window;
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Offscreen main window"));
+        auto* layout = new QVBoxLayout(&m_window);
+        layout->addWidget(new QPushButton(QStringLiteral("OK")));
+        m_window.show();
+
+        m_name = start_local_server();
+        QVERIFY(!m_name.isEmpty());
+        QVERIFY(QtHelloServer::instance()->netWorker() != nullptr);
+    }
+
+    void pingIsAnsweredWhileTheGuiThreadIsBusy() {
+        std::atomic<bool> ready{ false };
+        std::atomic<bool> busy{ false };
+        std::atomic<bool> done{ false };
+        QJsonObject reply;
+        bool answeredWhileBusy = false;
+
+        std::thread client([&]() {
+            TestClient c;
+            if (c.connectTo(m_name)) {
+                ready.store(true);
+                while (!busy.load())
+                    QThread::msleep(1);
+                reply = c.call({ { "id", 7 }, { "method", "ping" } }, 10000);
+                answeredWhileBusy = busy.load();
+            }
+            done.store(true);
+        });
+
+        QVERIFY(QTest::qWaitFor([&]() { return ready.load(); }, 5000));
+        // Block the GUI thread until the reply is in: only the network thread can answer.
+        busy.store(true);
+        QElapsedTimer blocked;
+        blocked.start();
+        while (!done.load() && blocked.elapsed() < 10000)
+            QThread::msleep(1);
+        busy.store(false);
+        QTRY_VERIFY_WITH_TIMEOUT(done.load(), 10000);
+        client.join();
+
+        QCOMPARE(reply.value("id").toInt(), 7);
+        QVERIFY(reply.value("result").toObject().value("ok").toBool());
+        QVERIFY2(answeredWhileBusy, "ping was only answered once the GUI thread was free");
+    }
+
+    void guiRequestsReportTiming() {
+        QJsonObject info;
+        QJsonObject roots;
+        run_client([&]() {
+            TestClient c;
+            if (!c.connectTo(m_name))
+                return;
+            info  = c.call({ { "id", 1 }, { "method", "app.info" }, { "timing", true } });
+            roots = c.call({ { "id", 2 }, { "method", "elements.roots" }, { "timing", true },
+                             { "params", QJsonObject{ { "fields", QJsonArray{ "name" } } } } });
+        });
+
+        QCOMPARE(info.value("result").toObject().value("pid").toInt(),
+                 static_cast<int>(QCoreApplication::applicationPid()));
+        const QJsonObject timing = info.value("timing").toObject();
+        QVERIFY(timing.contains("queue_us"));
+        QVERIFY(timing.value("gui_us").toInt(-1) >= 0);
+        QCOMPARE(timing.value("slices").toInt(), 1);
+
+        bool found = false;
+        for (const QJsonValue& v : roots.value("result").toArray())
+            found |= v.toObject().value("name").toString() == m_window.windowTitle();
+        QVERIFY(found);
+        QVERIFY(roots.contains("timing"));
+    }
+
+    void cleanupTestCase() {
+        QSignalSpy stopped(QtHelloServer::instance(), &QtHelloServer::stopped);
+        QtHelloServer::instance()->stop();
+        QCOMPARE(stopped.count(), 1);
+    }
+};
+
+QTEST_MAIN(TestServer)
+#include "test_server.moc"
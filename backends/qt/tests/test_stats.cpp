@@ -0,0 +1,113 @@
+#include <QApplication>
+#include <QLabel>
+
+#include "qt_stats.h"
+#include "qt_util.h"
+#include "test_common.h"
+
+// server.stats: the latency histogram on its own, then the per-method counters, stages and
+// byte counts a client sees after a few requests over the local socket.
+class TestStats : public QObject {
+    Q_OBJECT
+
+    QLabel m_label;
+    QString m_server;
+    int m_labelId = 0;
+
+    static bool within(double value, double expected, double relative) {
+        return value >= expected * (1 - relative) && value <= expected * (1 + relative);
+    }
+
+private slots:
+    void initTestCase() {
+        m_label.setText(QStringLiteral("Stats"));
+        m_label.show();
+        m_labelId = handle_request(QStringLiteral("elements.roots")).value("result").toArray()
+                            .first().toObject().value("id").toInt();
+        QVERIFY(m_labelId > 0);
+        m_server = start_local_server();
+        QVERIFY(!m_server.isEmpty());
+    }
+
+    void histogramQuantiles() {
+        injectlib::LatencyHistogram h;
+        for (int i = 1; i <= 1000; ++i)
+            h.record(quint64(i) * 1000);
+        QCOMPARE(h.count(), quint64(1000));
+
+        const QJsonObject j = h.toJson();
+        QCOMPARE(j.value("count").toInt(), 1000);
+        QCOMPARE(j.value("max_us").toDouble(), 1000.0);
+        QVERIFY(within(j.value("mean_us").toDouble(), 500.5, 0.001));
+        // Buckets are at most 12.5% wide.
+        QVERIFY(within(j.value("p50_us").toDouble(), 500, 0.125));
+        QVERIFY(within(j.value("p90_us").toDouble(), 900, 0.125));
+        QVERIFY(within(j.value("p99_us").toDouble(), 990, 0.125));
+        QVERIFY(j.value("p99_us").toDouble() <= j.value("max_us").toDouble());
+
+        h.reset();
+        QCOMPARE(h.count(), quint64(0));
+        QCOMPARE(h.toJson(), QJsonObject{ { "count", 0 } });
+    }
+
+    void requestsShowUpPerMethod() {
+        QJsonObject stats;
+        run_client([&]() {
+            TestClient c;
+            if (!c.connectTo(m_server))
+                return;
+            c.call({ { "id", 1 }, { "method", "server.stats" }, { "params", QJsonObject{ { "reset", true } } } });
+            for (int i = 0; i < 3; ++i)
+                c.call({ { "id", 2 }, { "method", "ping" } });
+            for (int i = 0; i < 2; ++i)
+                c.call({ { "id", 3 }, { "method", "elements.info" }, { "params", QJsonObject{ { "id", m_labelId } } } });
+            c.call({ { "id", 4 }, { "method", "elements.info" }, { "params", QJsonObject{ { "id", 0x7ffffff0 } } } });
+            c.call({ { "id", 5 }, { "method", "no.such.method" } });
+            stats = c.call({ { "id", 6 }, { "method", "server.stats" } }).value("result").toObject();
+        });
+        QVERIFY(!stats.isEmpty());
+
+        const QJsonObject methods = stats.value("methods").toObject();
+        QCOMPARE(methods.value("ping").toObject().value("calls").toInt(), 3);
+        const QJsonObject info = methods.value("elements.info").toObject();
+        QCOMPARE(info.value("calls").toInt(), 3);
+        QCOMPARE(info.value("errors").toInt(), 1);
+        for (const char* stage : { "parse", "queue", "handle", "serialize", "write" })
+            QVERIFY2(info.value(QLatin1String(stage)).toObject().value("count").toInt() == 3, stage);
+        // ping never reaches the GUI thread.
+        QVERIFY(!methods.value("ping").toObject().contains("handle"));
+        QCOMPARE(methods.value("other").toObject().value("calls").toInt(), 1);
+        QVERIFY(!methods.contains("elements.tree"));
+
+        // Counted from the reset on: the reply to the resetting request is in, the reply to
+        // this one isn't yet.
+        QCOMPARE(stats.value("frames_in").toInt(), 8);
+        QCOMPARE(stats.value("frames_out").toInt(), 8);
+        QVERIFY(stats.value("bytes_in").toDouble() > 0);
+        QVERIFY(stats.value("bytes_out").toDouble() > 0);
+        QCOMPARE(stats.value("connections").toInt(), 1);
+        QCOMPARE(stats.value("inflight").toInt(), 0);
+        QVERIFY(stats.contains("log_level"));
+    }
+
+    void logLevelIsSetAtRuntime() {
+        const int before = injectlib::log_level();
+        QJsonObject reply;
+        run_client([&]() {
+            TestClient c;
+            if (c.connectTo(m_server))
+                reply = c.call({ { "id", 1 }, { "method", "server.setLogLevel" },
+                                 { "params", QJsonObject{ { "level", injectlib::LogTrace } } } });
+        });
+        QCOMPARE(reply.value("result").toObject().value("log_level").toInt(), int(injectlib::LogTrace));
+        QCOMPARE(injectlib::log_level(), int(injectlib::LogTrace));
+        injectlib::set_log_level(before);
+    }
+
+    void cleanupTestCase() {
+        QtHelloServer::instance()->stop();
+    }
+};
+
+QTEST_MAIN(TestStats)
+#include "test_stats.moc"
@@ -0,0 +1,131 @@
+#include <QApplication>
+#include <QLabel>
+#include <QWidget>
+
+#include "test_common.h"
+
+// Streamed replies ("stream": true): elements.tree and elements.find hand out their nodes in
+// chunk frames carrying the request id, then a final response with the rest and the chunk
+// count. Together they hold exactly what the unstreamed reply holds, in the same order.
+class TestStream : public QObject {
+    Q_OBJECT
+
+    static constexpr int kLabels = 50;
+
+    QWidget m_window;
+    QString m_server;
+    int m_rootId = 0;
+    QVector<QJsonObject> m_pushed;
+
+    QJsonObject streamed(const QString& method, const QJsonObject& params) {
+        QtHelloServer::PendingRequest pending;
+        pending.req   = QJsonObject{ { "id", 9 }, { "method", method }, { "stream", true }, { "params", params } };
+        pending.reply = [](const QJsonObject&) {};
+        pending.push  = [this](const QJsonObject& frame) { m_pushed.push_back(frame); };
+        pending.queued.start();
+        return QtHelloServer::instance()->handleRequest(pending);
+    }
+
+    // The chunks pushed so far followed by the final reply's items, checking the framing.
+    QJsonArray joined(const QJsonObject& last, const QString& key, int chunkSize) {
+        QJsonArray all;
+        for (int i = 0; i < m_pushed.size(); ++i) {
+            const QJsonObject& frame = m_pushed.at(i);
+            if (frame.value("id").toInt() != 9 || frame.value("chunk").toInt(-1) != i)
+                return QJsonArray();
+            const QJsonArray items = frame.value("result").toObject().value(key).toArray();
+            if (items.size() != chunkSize)
+                return QJsonArray();
+            for (const QJsonValue& v : items)
+                all.push_back(v);
+        }
+        const QJsonObject result = last.value("result").toObject();
+        if (last.contains("chunk") || result.value("chunks").toInt() != m_pushed.size())
+            return QJsonArray();
+        for (const QJsonValue& v : result.value(key).toArray())
+            all.push_back(v);
+        m_pushed.clear();
+        return all;
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Stream"));
+        for (int i = 0; i < kLabels; ++i)
+            (new QLabel(QString::number(i), &m_window))->setObjectName(QStringLiteral("label%1").arg(i));
+        m_window.show();
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == m_window.windowTitle())
+                m_rootId = v.toObject().value("id").toInt();
+        }
+        QVERIFY(m_rootId > 0);
+        m_server = start_local_server();
+        QVERIFY(!m_server.isEmpty());
+    }
+
+    void treeChunksAddUpToTheTree() {
+        const QJsonArray expected = handle_request(QStringLiteral("elements.tree"), { { "id", m_rootId } })
+                                            .value("result").toObject().value("nodes").toArray();
+        QCOMPARE(expected.size(), 1 + kLabels);
+
+        m_pushed.clear();
+        const QJsonObject last = streamed(QStringLiteral("elements.tree"), { { "id", m_rootId }, { "chunk_size", 7 } });
+        QCOMPARE(m_pushed.size(), (1 + kLabels) / 7);
+        QCOMPARE(joined(last, QStringLiteral("nodes"), 7), expected);
+    }
+
+    void findChunksAddUpToTheMatches() {
+        const QJsonObject params{ { "id", m_rootId }, { "auto_id_re", "^label" }, { "fields", QJsonArray{ "auto_id" } } };
+        const QJsonArray expected = handle_request(QStringLiteral("elements.find"), params)
+                                            .value("result").toObject().value("matches").toArray();
+        QCOMPARE(expected.size(), kLabels);
+
+        m_pushed.clear();
+        QJsonObject streamParams = params;
+        streamParams["chunk_size"] = 10;
+        const QJsonObject last = streamed(QStringLiteral("elements.find"), streamParams);
+        QCOMPARE(m_pushed.size(), kLabels / 10);
+        // The last match fills the last chunk; the final response has no items left.
+        QVERIFY(last.value("result").toObject().value("matches").toArray().isEmpty());
+        QCOMPARE(joined(last, QStringLiteral("matches"), 10), expected);
+    }
+
+    void chunksArriveBeforeTheResponseOnTheSocket() {
+        QVector<QJsonObject> frames;
+        run_client([&]() {
+            TestClient c;
+            if (!c.connectTo(m_server) ||
+                !c.send({ { "id", 3 }, { "method", "elements.tree" }, { "stream", true },
+                          { "params", QJsonObject{ { "id", m_rootId }, { "chunk_size", 16 } } } }))
+                return;
+            for (;;) {
+                const QJsonObject frame = c.read();
+                if (frame.isEmpty())
+                    return;
+                frames.push_back(frame);
+                if (!frame.contains("chunk"))
+                    return;
+            }
+        });
+
+        QCOMPARE(frames.size(), (1 + kLabels) / 16 + 1);
+        int nodes = 0;
+        for (int i = 0; i < frames.size(); ++i) {
+            QCOMPARE(frames.at(i).value("id").toInt(), 3);
+            if (i + 1 < frames.size())
+                QCOMPARE(frames.at(i).value("chunk").toInt(), i);
+            nodes += frames.at(i).value("result").toObject().value("nodes").toArray().size();
+        }
+        QCOMPARE(frames.last().value("result").toObject().value("chunks").toInt(), frames.size() - 1);
+        QCOMPARE(nodes, 1 + kLabels);
+    }
+
+    void cleanupTestCase() {
+        QtHelloServer::instance()->stop();
+    }
+};
+
+QTEST_MAIN(TestStream)
+#include "test_stream.moc"
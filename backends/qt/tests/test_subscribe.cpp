@@ -0,0 +1,241 @@
+#include <QApplication>
+#include <QGraphicsScene>
+#include <QGraphicsTextItem>
+#include <QGraphicsView>
+#include <QLineEdit>
+#include <QPushButton>
+#include <QTimer>
+#include <QWidget>
+
+#include "test_common.h"
+
+// elements.subscribe: changes to watched widgets and graphics objects come back as
+// elements.changed frames, one per subscription and event-loop pass. Pushes are collected
+// per request here; the last test checks they also reach a client over the socket.
+class TestSubscribe : public QObject {
+    Q_OBJECT
+
+    QWidget m_window;
+    QLineEdit* m_edit = nullptr;
+    QWidget* m_group = nullptr;
+    QGraphicsScene m_scene;
+    QGraphicsView* m_view = nullptr;
+    QGraphicsTextItem* m_text = nullptr;
+    QHash<QString, int> m_ids;
+    QVector<QJsonObject> m_pushed;
+
+    QJsonObject request(quint64 conn, const QString& method, const QJsonObject& params) {
+        QtHelloServer::PendingRequest pending;
+        pending.req   = QJsonObject{ { "id", 1 }, { "method", method }, { "params", params } };
+        pending.reply = [](const QJsonObject&) {};
+        pending.push  = [this](const QJsonObject& frame) { m_pushed.push_back(frame); };
+        pending.conn  = conn;
+        pending.queued.start();
+        return QtHelloServer::instance()->handleRequest(pending);
+    }
+
+    int subscribe(const QJsonObject& params, quint64 conn = 1) {
+        return request(conn, QStringLiteral("elements.subscribe"), params)
+                .value("result").toObject().value("subscription").toInt();
+    }
+
+    void unsubscribe(int subscription, quint64 conn = 1) {
+        QVERIFY(request(conn, QStringLiteral("elements.unsubscribe"), { { "subscription", subscription } })
+                        .contains("result"));
+    }
+
+    // Changes pushed once the pending pass has run, by element id; clears the pushes.
+    QHash<int, QJsonObject> takeChanges(int subscription) {
+        QTest::qWait(20);
+        QHash<int, QJsonObject> out;
+        for (const QJsonObject& frame : qAsConst(m_pushed)) {
+            const QJsonObject params = frame.value("params").toObject();
+            if (frame.value("method").toString() != QLatin1String("elements.changed") ||
+                params.value("subscription").toInt() != subscription)
+                continue;
+            for (const QJsonValue& v : params.value("changes").toArray())
+                out.insert(v.toObject().value("id").toInt(), v.toObject());
+        }
+        m_pushed.clear();
+        return out;
+    }
+
+    static QJsonArray events(const QJsonObject& change) {
+        return change.value("events").toArray();
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Subscribe"));
+        m_window.resize(400, 300);
+        m_edit = new QLineEdit(&m_window);
+        m_edit->setObjectName(QStringLiteral("edit"));
+        m_group = new QWidget(&m_window);
+        m_group->setObjectName(QStringLiteral("group"));
+        m_group->setGeometry(0, 40, 200, 50);
+        m_text = m_scene.addText(QStringLiteral("text"));
+        m_view = new QGraphicsView(&m_scene, &m_window);
+        m_view->setObjectName(QStringLiteral("view"));
+        m_view->setGeometry(0, 100, 300, 200);
+        m_window.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&m_window));
+
+        int rootId = 0;
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"), { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        for (const QJsonValue& v : roots) {
+            if (v.toObject().value("name").toString() == m_window.windowTitle())
+                rootId = v.toObject().value("id").toInt();
+        }
+        QVERIFY(rootId > 0);
+        m_ids.insert(QStringLiteral("window"), rootId);
+        const QJsonArray kids = handle_request(QStringLiteral("elements.children"),
+                                               { { "id", rootId }, { "fields", QJsonArray{ "auto_id" } } })
+                                        .value("result").toArray();
+        for (const QJsonValue& v : kids)
+            m_ids.insert(v.toObject().value("auto_id").toString(), v.toObject().value("id").toInt());
+        const QPointF textPos = m_text->boundingRect().center();
+        const QJsonArray items = handle_request(QStringLiteral("scene.items"),
+                                                { { "id", m_ids.value(QStringLiteral("view")) }, { "coords", "scene" },
+                                                  { "point", QJsonArray{ textPos.x(), textPos.y() } } })
+                                         .value("result").toObject().value("items").toArray();
+        QVERIFY(!items.isEmpty());
+        m_ids.insert(QStringLiteral("text"), items.first().toObject().value("id").toInt());
+        for (int id : qAsConst(m_ids))
+            QVERIFY(id > 0);
+    }
+
+    void changesInOnePassAreCoalesced() {
+        const int editId = m_ids.value(QStringLiteral("edit"));
+        const int sub = subscribe({ { "ids", QJsonArray{ editId } }, { "fields", QJsonArray{ "enabled", "rect" } } });
+        QVERIFY(sub > 0);
+
+        m_edit->setEnabled(false);
+        m_edit->move(10, 5);
+        m_edit->move(20, 5);
+        m_edit->resize(120, 30);
+        QTRY_VERIFY(!m_pushed.isEmpty());
+        QCOMPARE(m_pushed.size(), 1);
+        const QHash<int, QJsonObject> changes = takeChanges(sub);
+        QCOMPARE(changes.size(), 1);
+        const QJsonArray ev = events(changes.value(editId));
+        QVERIFY(ev.contains(QStringLiteral("enabled")));
+        QVERIFY(ev.contains(QStringLiteral("move")));
+        QVERIFY(ev.contains(QStringLiteral("resize")));
+        const QJsonObject element = changes.value(editId).value("element").toObject();
+        QCOMPARE(element.value("enabled").toBool(), false);
+        QVERIFY(!element.contains("class"));
+
+        unsubscribe(sub);
+        m_edit->setEnabled(true);
+        QVERIFY(takeChanges(sub).isEmpty());
+    }
+
+    void onlyRequestedEventsArePushed() {
+        const int editId = m_ids.value(QStringLiteral("edit"));
+        const int sub = subscribe({ { "ids", QJsonArray{ editId } }, { "events", QJsonArray{ "hide", "show" } } });
+        m_edit->move(30, 5);
+        QVERIFY(takeChanges(sub).isEmpty());
+
+        m_edit->hide();
+        QCOMPARE(events(takeChanges(sub).value(editId)), QJsonArray{ "hide" });
+        m_edit->show();
+        QCOMPARE(events(takeChanges(sub).value(editId)), QJsonArray{ "show" });
+        unsubscribe(sub);
+    }
+
+    void subtreeCoversChildrenAddedLater() {
+        const int groupId = m_ids.value(QStringLiteral("group"));
+        const int sub = subscribe({ { "ids", QJsonArray{ groupId } }, { "subtree", true },
+                                    { "fields", QJsonArray{ "auto_id" } } });
+        auto* button = new QPushButton(QStringLiteral("late"), m_group);
+        button->setObjectName(QStringLiteral("late"));
+        QVERIFY(events(takeChanges(sub).value(groupId)).contains(QStringLiteral("children")));
+
+        button->setEnabled(false);
+        const QHash<int, QJsonObject> changes = takeChanges(sub);
+        QCOMPARE(changes.size(), 1);
+        const QJsonObject change = changes.constBegin().value();
+        QCOMPARE(change.value("element").toObject().value("auto_id").toString(), QStringLiteral("late"));
+        QCOMPARE(events(change), QJsonArray{ "enabled" });
+        const int buttonId = change.value("id").toInt();
+
+        delete button;
+        const QHash<int, QJsonObject> gone = takeChanges(sub);
+        QVERIFY(events(gone.value(buttonId)).contains(QStringLiteral("destroyed")));
+        QVERIFY(!gone.value(buttonId).contains("element"));
+        QVERIFY(events(gone.value(groupId)).contains(QStringLiteral("children")));
+        unsubscribe(sub);
+    }
+
+    void graphicsObjectsReportThroughSignals() {
+        const int textId = m_ids.value(QStringLiteral("text"));
+        const int sub = subscribe({ { "ids", QJsonArray{ textId } } });
+        QVERIFY(sub > 0);
+        m_text->setPos(15, 25);
+        QVERIFY(events(takeChanges(sub).value(textId)).contains(QStringLiteral("move")));
+        m_text->setVisible(false);
+        QVERIFY(events(takeChanges(sub).value(textId)).contains(QStringLiteral("hide")));
+        m_text->setVisible(true);
+        takeChanges(sub);
+        unsubscribe(sub);
+    }
+
+    void invalidRequests() {
+        QJsonObject resp = request(1, QStringLiteral("elements.subscribe"), { { "ids", QJsonArray{ 0x7ffffff0 } } });
+        QCOMPARE(resp.value("error").toObject().value("code").toInt(), -32602);
+
+        // A subscription belongs to its connection.
+        const int sub = subscribe({ { "ids", QJsonArray{ m_ids.value(QStringLiteral("edit")) } } });
+        resp = request(2, QStringLiteral("elements.unsubscribe"), { { "subscription", sub } });
+        QCOMPARE(resp.value("error").toObject().value("code").toInt(), -32602);
+
+        // Closing the connection drops it.
+        QtHelloServer::instance()->connectionClosed(1);
+        m_edit->setEnabled(false);
+        QVERIFY(takeChanges(sub).isEmpty());
+        m_edit->setEnabled(true);
+        resp = request(1, QStringLiteral("elements.unsubscribe"), { { "subscription", sub } });
+        QCOMPARE(resp.value("error").toObject().value("code").toInt(), -32602);
+    }
+
+    void pushesReachTheSocket() {
+        const QString server = start_local_server();
+        QVERIFY(!server.isEmpty());
+        const int editId = m_ids.value(QStringLiteral("edit"));
+
+        // The change is made on the GUI thread once the client has its subscription.
+        std::atomic<bool> subscribed{ false };
+        QTimer poke;
+        connect(&poke, &QTimer::timeout, this, [&]() {
+            if (subscribed.load()) {
+                poke.stop();
+                m_edit->setEnabled(false);
+            }
+        });
+        poke.start(1);
+
+        QJsonObject reply, pushed;
+        run_client([&]() {
+            TestClient c;
+            if (!c.connectTo(server))
+                return;
+            reply = c.call({ { "id", 7 }, { "method", "elements.subscribe" },
+                             { "params", QJsonObject{ { "ids", QJsonArray{ editId } } } } });
+            subscribed.store(true);
+            pushed = c.read(10000);
+        });
+
+        QVERIFY(reply.value("result").toObject().value("subscription").toInt() > 0);
+        QCOMPARE(pushed.value("method").toString(), QStringLiteral("elements.changed"));
+        QVERIFY(!pushed.contains("id"));
+        const QJsonObject change = pushed.value("params").toObject().value("changes").toArray().first().toObject();
+        QCOMPARE(change.value("id").toInt(), editId);
+        QVERIFY(events(change).contains(QStringLiteral("enabled")));
+        m_edit->setEnabled(true);
+        QtHelloServer::instance()->stop();
+    }
+};
+
+QTEST_MAIN(TestSubscribe)
+#include "test_subscribe.moc"
@@ -0,0 +1,200 @@
+#include <QApplication>
+#include <QGraphicsRectItem>
+#include <QGraphicsScene>
+#include <QGraphicsView>
+#include <QLabel>
+#include <QScrollBar>
+#include <QSet>
+#include <QWidget>
+
+#include "test_common.h"
+
+// elements.treeDelta against a widget tree with a graphics view: a full snapshot first, then
+// only what changed. Scene changes are picked up from QGraphicsScene::changed, which is
+// emitted from the event loop, hence the qWait after changing the scene.
+class TestTreeDelta : public QObject {
+    Q_OBJECT
+
+    static constexpr int kLabels = 20;
+
+    QWidget m_window;
+    QWidget* m_group = nullptr;
+    QGraphicsScene m_scene;
+    QGraphicsView* m_view = nullptr;
+    QGraphicsRectItem* m_item = nullptr;
+    int m_rootId = 0;
+    int m_groupId = 0;
+    int m_labelId = 0;
+    int m_viewId = 0;
+    int m_itemId = 0;
+    double m_version = 0;
+
+    // The next delta on top of the last one (conn 0, like every handle_request call).
+    QJsonObject delta() {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.treeDelta"),
+                                                { { "id", m_rootId }, { "since", m_version } });
+        const QJsonObject result = resp.value("result").toObject();
+        m_version = result.value("version").toDouble();
+        return result;
+    }
+
+    static bool isEmpty(const QJsonObject& d) {
+        return d.value("added").toArray().isEmpty() && d.value("modified").toArray().isEmpty() &&
+               d.value("removed").toArray().isEmpty();
+    }
+
+    static QSet<int> ids(const QJsonArray& nodes) {
+        QSet<int> out;
+        for (const QJsonValue& v : nodes)
+            out.insert(v.isObject() ? v.toObject().value("id").toInt() : v.toInt());
+        return out;
+    }
+
+    static QJsonObject byName(const QJsonArray& nodes, const QString& name) {
+        for (const QJsonValue& v : nodes) {
+            if (v.toObject().value("name").toString() == name)
+                return v.toObject();
+        }
+        return QJsonObject();
+    }
+
+    int itemAt(const QPointF& scenePos) {
+        const QJsonArray items = handle_request(QStringLiteral("scene.items"),
+                                                { { "id", m_viewId }, { "coords", "scene" },
+                                                  { "point", QJsonArray{ scenePos.x(), scenePos.y() } } })
+                                         .value("result").toObject().value("items").toArray();
+        return items.isEmpty() ? 0 : items.first().toObject().value("id").toInt();
+    }
+
+private slots:
+    void initTestCase() {
+        m_window.setWindowTitle(QStringLiteral("Tree delta"));
+        m_window.resize(400, 300);
+        m_group = new QWidget(&m_window);
+        m_group->setObjectName(QStringLiteral("group"));
+        for (int i = 0; i < kLabels; ++i)
+            (new QLabel(&m_window))->setObjectName(QStringLiteral("label%1").arg(i));
+        m_item = m_scene.addRect(0, 0, 50, 50);
+        m_view = new QGraphicsView(&m_scene, &m_window);
+        m_view->setObjectName(QStringLiteral("view"));
+        m_view->setGeometry(0, 100, 300, 200);
+        m_window.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&m_window));
+
+        const QJsonArray roots = handle_request(QStringLiteral("elements.roots"),
+                                                { { "fields", QJsonArray{ "name" } } })
+                                         .value("result").toArray();
+        m_rootId = byName(roots, m_window.windowTitle()).value("id").toInt();
+        QVERIFY(m_rootId > 0);
+    }
+
+    void firstDeltaIsTheWholeTree() {
+        const QJsonObject d = delta();
+        QVERIFY(d.value("full").toBool());
+        const QJsonArray added = d.value("added").toArray();
+        QVERIFY(ids(added).contains(m_rootId));
+        QVERIFY(!byName(added, QStringLiteral("label%1").arg(kLabels - 1)).isEmpty());
+
+        m_groupId = byName(added, QStringLiteral("group")).value("id").toInt();
+        m_labelId = byName(added, QStringLiteral("label0")).value("id").toInt();
+        m_viewId  = byName(added, QStringLiteral("view")).value("id").toInt();
+        QVERIFY(m_groupId > 0);
+        QVERIFY(m_labelId > 0);
+        QVERIFY(m_viewId > 0);
+        m_itemId = itemAt(QPointF(25, 25));
+        QVERIFY(m_itemId > 0);
+        QVERIFY(ids(added).contains(m_itemId));
+    }
+
+    void nothingChangedNothingReported() {
+        QTest::qWait(50);
+        delta();
+        const double version = m_version;
+        const QJsonObject d = delta();
+        QVERIFY(!d.value("full").toBool());
+        QVERIFY(isEmpty(d));
+        QCOMPARE(m_version, version);
+    }
+
+    void widgetChanges() {
+        m_window.findChild<QLabel*>(QStringLiteral("label0"))->setEnabled(false);
+        QJsonObject d = delta();
+        QVERIFY(ids(d.value("modified").toArray()).contains(m_labelId));
+        QVERIFY(d.value("added").toArray().isEmpty());
+
+        auto* added = new QLabel(m_group);
+        added->setObjectName(QStringLiteral("added"));
+        d = delta();
+        const QJsonObject node = byName(d.value("added").toArray(), QStringLiteral("added"));
+        QVERIFY(!node.isEmpty());
+        QCOMPARE(node.value("parent").toInt(), m_groupId);
+        const int addedId = node.value("id").toInt();
+
+        delete added;
+        d = delta();
+        QCOMPARE(ids(d.value("removed").toArray()), QSet<int>{ addedId });
+        QVERIFY(d.value("added").toArray().isEmpty());
+    }
+
+    void sceneItemAddedMovedAndRemoved() {
+        auto* item = m_scene.addRect(100, 0, 20, 20);
+        QTest::qWait(50);
+        QJsonObject d = delta();
+        QJsonArray added = d.value("added").toArray();
+        QCOMPARE(added.size(), 1);
+        QCOMPARE(added.first().toObject().value("parent").toInt(), m_viewId);
+        const int itemId = added.first().toObject().value("id").toInt();
+
+        // A child inside its parent's bounds is found under the parent.
+        new QGraphicsRectItem(105, 5, 5, 5, item);
+        QTest::qWait(50);
+        d = delta();
+        added = d.value("added").toArray();
+        QCOMPARE(added.size(), 1);
+        QCOMPARE(added.first().toObject().value("parent").toInt(), itemId);
+        const int childId = added.first().toObject().value("id").toInt();
+
+        item->setPos(0, 40);
+        QTest::qWait(50);
+        d = delta();
+        QVERIFY(ids(d.value("modified").toArray()).contains(itemId));
+        QVERIFY(d.value("removed").toArray().isEmpty());
+
+        delete item;
+        QTest::qWait(50);
+        d = delta();
+        QCOMPARE(ids(d.value("removed").toArray()), (QSet<int>{ itemId, childId }));
+    }
+
+    void repaintsAreNotChanges() {
+        m_item->update();
+        m_view->viewport()->update();
+        QTest::qWait(50);
+        QVERIFY(isEmpty(delta()));
+    }
+
+    void scrollingMovesItems() {
+        m_scene.setSceneRect(0, 0, 2000, 2000);
+        QTest::qWait(50);
+        delta();
+        m_view->verticalScrollBar()->setValue(m_view->verticalScrollBar()->value() + 100);
+        QTest::qWait(50);
+        QVERIFY(ids(delta().value("modified").toArray()).contains(m_itemId));
+    }
+
+    void staleVersionStartsOver() {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.treeDelta"),
+                                                { { "id", m_rootId }, { "since", m_version + 1000 } });
+        QVERIFY(resp.value("result").toObject().value("full").toBool());
+        m_version = resp.value("result").toObject().value("version").toDouble();
+        QVERIFY(isEmpty(delta()));
+    }
+
+    void unknownRoot() {
+        const QJsonObject resp = handle_request(QStringLiteral("elements.treeDelta"), { { "id", 0x7ffffff0 } });
+        QCOMPARE(resp.value("error").toObject().value("code").toInt(), -32602);
+    }
+};
+
+QTEST_MAIN(TestTreeDelta)
+#include "test_tree_delta.moc"
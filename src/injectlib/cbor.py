@@ -0,0 +1,133 @@
+"""Minimal CBOR (RFC 8949) codec for the injected Qt server wire format.
+
+Covers what QCborValue produces for JSON-like data: integers, floats, text and byte
+strings, arrays, maps, booleans and null. Tags are skipped and their content returned.
+"""
+
+import struct
+
+
+class CborDecodeError(ValueError):
+    pass
+
+
+def _encode_head(major, value):
+    if value < 24:
+        return struct.pack('>B', (major << 5) | value)
+    if value < 0x100:
+        return struct.pack('>BB', (major << 5) | 24, value)
+    if value < 0x10000:
+        return struct.pack('>BH', (major << 5) | 25, value)
+    if value < 0x100000000:
+        return struct.pack('>BI', (major << 5) | 26, value)
+    return struct.pack('>BQ', (major << 5) | 27, value)
+
+
+def _encode(obj, out):
+    if obj is None:
+        out.append(b'\xf6')
+    elif obj is True:
+        out.append(b'\xf5')
+    elif obj is False:
+        out.append(b'\xf4')
+    elif isinstance(obj, int):
+        out.append(_encode_head(0, obj) if obj >= 0 else _encode_head(1, -1 - obj))
+    elif isinstance(obj, float):
+        out.append(b'\xfb' + struct.pack('>d', obj))
+    elif isinstance(obj, str):
+        data = obj.encode('utf-8')
+        out.append(_encode_head(3, len(data)))
+        out.append(data)
+    elif isinstance(obj, (bytes, bytearray)):
+        out.append(_encode_head(2, len(obj)))
+        out.append(bytes(obj))
+    elif isinstance(obj, (list, tuple)):
+        out.append(_encode_head(4, len(obj)))
+        for item in obj:
+            _encode(item, out)
+    elif isinstance(obj, dict):
+        out.append(_encode_head(5, len(obj)))
+        for key, value in obj.items():
+            _encode(key, out)
+            _encode(value, out)
+    else:
+        raise TypeError('Cannot encode {} as CBOR'.format(type(obj).__name__))
+
+
+def dumps(obj):
+    out = []
+    _encode(obj, out)
+    return b''.join(out)
+
+
+class _Decoder(object):
+    def __init__(self, data):
+        self.data = memoryview(data)
+        self.pos = 0
+
+    def _take(self, n):
+        if self.pos + n > len(self.data):
+            raise CborDecodeError('Truncated CBOR data')
+        chunk = self.data[self.pos:self.pos + n]
+        self.pos += n
+        return chunk
+
+    def _argument(self, info):
+        if info < 24:
+            return info
+        if info == 24:
+            return self._take(1)[0]
+        if info == 25:
+            return struct.unpack('>H', self._take(2))[0]
+        if info == 26:
+            return struct.unpack('>I', self._take(4))[0]
+        if info == 27:
+            return struct.unpack('>Q', self._take(8))[0]
+        raise CborDecodeError('Unsupported additional info {}'.format(info))
+
+    def decode(self):
+        initial = self._take(1)[0]
+        major, info = initial >> 5, initial & 0x1f
+
+        if major == 7:
+            if info == 20:
+                return False
+            if info == 21:
+                return True
+            if info in (22, 23):
+                return None
+            if info == 25:
+                return struct.unpack('>e', self._take(2))[0]
+            if info == 26:
+                return struct.unpack('>f', self._take(4))[0]
+            if info == 27:
+                return struct.unpack('>d', self._take(8))[0]
+            raise CborDecodeError('Unsupported simple value {}'.format(info))
+
+        value = self._argument(info)
+        if major == 0:
+            return value
+        if major == 1:
+            return -1 - value
+        if major == 2:
+            return bytes(self._take(value))
+        if major == 3:
+            return str(self._take(value), 'utf-8')
+        if major == 4:
+            return [self.decode() for _ in range(value)]
+        if major == 5:
+            result = {}
+            for _ in range(value):
+                key = self.decode()
+                result[key] = self.decode()
+            return result
+        # major == 6: tag, return the tagged item as is
+        return self.decode()
+
+
+def loads(data):
+    decoder = _Decoder(data)
+    obj = decoder.decode()
+    if decoder.pos != len(decoder.data):
+        raise CborDecodeError('Trailing data after CBOR item')
+    return obj
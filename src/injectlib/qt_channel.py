@@ -0,0 +1,452 @@
+import collections
+import itertools
+import json
+import logging
+import os
+import socket
+import struct
+import sys
+import tempfile
+import time
+
+from . import cbor
+
+logger = logging.getLogger(__package__)
+
+
+class QtServerError(Exception):
+    """Error reply from the injected Qt server"""
+
+    def __init__(self, code, message):
+        super(QtServerError, self).__init__('{}: {}'.format(code, message))
+        self.code = code
+        self.message = message
+
+
+class QtConnectionError(Exception):
+    pass
+
+
+class _PipeSocket(object):
+    """The socket calls QtSocket uses, on top of a Windows named pipe client handle."""
+
+    def __init__(self, path):
+        self._pipe = open(path, 'r+b', buffering=0)
+
+    def sendall(self, data):
+        view = memoryview(data)
+        while view:
+            view = view[self._pipe.write(view):]
+
+    def recv(self, size):
+        return self._pipe.read(size)
+
+    def settimeout(self, timeout):
+        # Blocking reads only; notification() timeouts are not supported over pipes.
+        pass
+
+    def close(self):
+        self._pipe.close()
+
+
+def local_socket_path(name):
+    """Where QLocalServer listens for a name: a named pipe on Windows, a socket file elsewhere."""
+    if sys.platform == 'win32':
+        return name if name.startswith('\\\\') else '\\\\.\\pipe\\' + name
+    return name if os.path.isabs(name) else os.path.join(tempfile.gettempdir(), name)
+
+
+class QtSocket(object):
+    """Client for the injected Qt server (qt_srv).
+
+    Frames are "<decimal length>\\n<compact JSON>", or "<4-byte big-endian length><CBOR>"
+    after use_cbor(). Requests are pipelined: send() returns immediately with the request id
+    and responses are matched by id, so they may arrive in any order. Responses for other
+    ids read while waiting are kept until asked for.
+
+    With local_name the client connects to a server started with QT_INJECTED_TRANSPORT=local
+    (QT_INJECTED_LOCAL_NAME, default "injectlib-qt-<pid>") instead of host:port.
+    """
+
+    def __init__(self, host='127.0.0.1', port=5555, local_name=None):
+        self.host = host
+        self.port = port
+        self.local_name = local_name
+        self.sock = None
+        self._buffer = b''
+        self._ids = itertools.count(1)
+        self._responses = {}
+        self._notifications = collections.deque()
+        self._chunks = {}
+        self.encoding = 'json'
+
+    def connect(self, n_attempts=30, delay=1, timeout=None):
+        if self.local_name is not None:
+            address = local_socket_path(self.local_name)
+        else:
+            address = '{}:{}'.format(self.host, self.port)
+        for i in range(n_attempts):
+            try:
+                self.sock = self._open(timeout)
+                logger.info('Connected to the Qt server {}'.format(address))
+                return True
+            except OSError as e:
+                logger.warning('Attempt {}/{}: failed to connect to the Qt server {} ({})'.format(
+                    i + 1, n_attempts, address, e))
+                time.sleep(delay)
+        return False
+
+    def _open(self, timeout):
+        if self.local_name is None:
+            sock = socket.create_connection((self.host, self.port), timeout=timeout)
+            sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+            return sock
+        path = local_socket_path(self.local_name)
+        if sys.platform == 'win32':
+            return _PipeSocket(path)
+        sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        try:
+            sock.settimeout(timeout)
+            sock.connect(path)
+        except OSError:
+            sock.close()
+            raise
+        return sock
+
+    def close(self):
+        if self.sock is not None:
+            self.sock.close()
+            self.sock = None
+
+    def send(self, method, params=None, **extra):
+        """Send a request without waiting for its response, return the request id."""
+        request_id = next(self._ids)
+        request = {'id': request_id, 'method': method}
+        if params is not None:
+            request['params'] = params
+        request.update(extra)
+        if self.encoding == 'cbor':
+            self._write_frame(cbor.dumps(request))
+        else:
+            self._write_frame(json.dumps(request, separators=(',', ':')).encode('utf-8'))
+        return request_id
+
+    def response(self, request_id):
+        """Block until the response with the given id arrives and return it as a dict."""
+        while request_id not in self._responses:
+            self._dispatch(self._read_message())
+        return self._responses.pop(request_id)
+
+    def notification(self, timeout=None):
+        """Return the next unsolicited frame's params (e.g. elements.changed), None on timeout."""
+        deadline = None if timeout is None else time.monotonic() + timeout
+        while not self._notifications:
+            if deadline is not None:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return None
+                self.sock.settimeout(remaining)
+            try:
+                self._dispatch(self._read_message())
+            except socket.timeout:
+                return None
+            finally:
+                self.sock.settimeout(None)
+        return self._notifications.popleft()
+
+    def subscribe(self, ids, subtree=False, events=None, fields=None):
+        """Watch elements for changes, return the subscription id (see notification())."""
+        params = {'ids': list(ids), 'subtree': subtree}
+        if events is not None:
+            params['events'] = list(events)
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.call('elements.subscribe', **params)['subscription']
+
+    def unsubscribe(self, subscription):
+        self.call('elements.unsubscribe', subscription=subscription)
+
+    def wait_for(self, element_id, predicate, timeout=10, fields=None):
+        """Wait until predicate(element summary) is true, driven by change notifications.
+
+        Returns the matching summary or None on timeout.
+        """
+        subscription = self.subscribe([element_id], fields=fields)
+        others = []
+        try:
+            params = {'id': element_id}
+            if fields is not None:
+                params['fields'] = list(fields)
+            element = self.call('elements.info', **params)
+            if predicate(element):
+                return element
+            deadline = time.monotonic() + timeout
+            while True:
+                remaining = deadline - time.monotonic()
+                if remaining <= 0:
+                    return None
+                note = self.notification(remaining)
+                if note is None:
+                    return None
+                if note.get('subscription') != subscription:
+                    others.append(note)
+                    continue
+                for change in note.get('changes', []):
+                    if change.get('id') != element_id:
+                        continue
+                    if 'destroyed' in change.get('events', []):
+                        return None
+                    element = change.get('element', element)
+                    if predicate(element):
+                        return element
+        finally:
+            # Keep notifications of other subscriptions for later notification() calls.
+            self._notifications.extend(others)
+            self.unsubscribe(subscription)
+
+    def result(self, request_id):
+        """Like response(), but return only the "result" part and raise QtServerError on errors."""
+        reply = self.response(request_id)
+        if 'error' in reply:
+            raise QtServerError(reply['error'].get('code'), reply['error'].get('message'))
+        return reply.get('result')
+
+    def call(self, method, **params):
+        return self.result(self.send(method, params or None))
+
+    def use_cbor(self):
+        """Switch this connection to CBOR if the server advertises it, return True on success.
+
+        Must not be called with other requests in flight: the switch applies to every
+        frame after the server's reply.
+        """
+        if 'cbor' not in (self.call('ping') or {}).get('encodings', []):
+            return False
+        self.call('session.setEncoding', encoding='cbor')
+        self.encoding = 'cbor'
+        return True
+
+    def batch(self, actions, stop_on_error=False):
+        """Apply UI actions in order with one request (actions.batch).
+
+        actions are dicts like {'action': 'setText', 'id': 5, 'text': 'abc'} or tuples
+        ('click', id) / ('setText', id, text). Returns the server's per-action results;
+        with stop_on_error the actions after the first failing one are skipped.
+        """
+        items = []
+        for action in actions:
+            if isinstance(action, dict):
+                items.append(action)
+            elif action[0] == 'setText':
+                items.append({'action': 'setText', 'id': action[1], 'text': action[2]})
+            else:
+                items.append({'action': action[0], 'id': action[1]})
+        return self.call('actions.batch', actions=items, stop_on_error=stop_on_error)
+
+    def tree_delta(self, root=0, since=0, max_depth=-1, fields=None):
+        """Changes of the tree under root since the version returned by the previous call.
+
+        The first call (since=0), or one with a version the server no longer holds, returns
+        the whole tree with full=True. See TreeMirror for applying the result.
+        """
+        params = {'id': root, 'since': since, 'max_depth': max_depth}
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.call('elements.treeDelta', **params)
+
+    def model_info(self, view_id, parent=()):
+        """Row/column counts and headers of an item view's model (parent: row path for trees)."""
+        return self.call('model.info', id=view_id, parent=list(parent))
+
+    def model_rows(self, view_id, row=0, count=100, column=0, columns=-1, parent=(), fields=None):
+        """One page of cells of an item view's model; see model.rows."""
+        params = {'id': view_id, 'parent': list(parent), 'row': row, 'count': count,
+                  'column': column, 'columns': columns}
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.call('model.rows', **params)
+
+    def scene_items(self, view_id, rect=None, point=None, scene_coords=False, top_level=None,
+                    offset=0, limit=None, fields=None):
+        """Graphics items of a view's scene in a screen (or scene) rect/point, or all of them paged."""
+        params = {'id': view_id, 'offset': offset, 'coords': 'scene' if scene_coords else 'screen'}
+        if rect is not None:
+            params['rect'] = list(rect)
+        if point is not None:
+            params['point'] = list(point)
+        if top_level is not None:
+            params['top_level'] = top_level
+        if limit is not None:
+            params['limit'] = limit
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.call('scene.items', **params)
+
+    def scene_item_at(self, view_id, point, scene_coords=False, fields=None):
+        """Topmost graphics item at a point of a view, None if there is none."""
+        params = {'id': view_id, 'point': list(point), 'coords': 'scene' if scene_coords else 'screen'}
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.call('scene.itemAt', **params)
+
+    def from_point(self, x, y, fields=None):
+        """Deepest element at a screen point: {'element': summary or None, 'ancestors': [ids]}.
+
+        Ancestor ids are nearest first and end with the top-level element.
+        """
+        params = {'point': [x, y]}
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.call('elements.fromPoint', **params)
+
+    def set_session_limits(self, max_nodes):
+        """Cap the nodes elements.tree/find visit for this connection (0 = unlimited).
+
+        Returns the limits in effect.
+        """
+        return self.call('session.setLimits', max_nodes=max_nodes)
+
+    def properties(self, ids, names):
+        """Read Qt properties of several elements at once (elements.properties).
+
+        Returns {id: {name: value}}; names an element doesn't have are left out, and unknown
+        ids map to None.
+        """
+        items = self.call('elements.properties', ids=list(ids), properties=list(names))['items']
+        return {item['id']: item.get('values') for item in items}
+
+    def stats(self, reset=False):
+        """Server counters and per-method latency percentiles (server.stats)."""
+        return self.call('server.stats', reset=reset)
+
+    def set_log_level(self, level):
+        """0 = off, 1 = errors, 2 = info (default), 3 = per-request, 4 = per-node tracing."""
+        return self.call('server.setLogLevel', level=level)['log_level']
+
+    def iter_tree(self, root=0, max_depth=-1, max_nodes=0, fields=None, chunk_size=500, tree_mode='objects'):
+        """Like elements.tree, but yield the nodes as the server streams them in chunks.
+
+        tree_mode='accessible' walks QAccessible interfaces instead of widgets/windows: it
+        also finds item view cells and reports role/value/state, but costs more per node.
+        """
+        params = {'id': root, 'max_depth': max_depth, 'max_nodes': max_nodes, 'chunk_size': chunk_size,
+                  'tree_mode': tree_mode}
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.stream('elements.tree', params, 'nodes')
+
+    def iter_find(self, root=0, max_results=0, fields=None, chunk_size=500, tree_mode='objects', **predicates):
+        """Like elements.find, but yield the matches as the server streams them in chunks."""
+        params = dict(predicates, id=root, max_results=max_results, chunk_size=chunk_size, tree_mode=tree_mode)
+        if fields is not None:
+            params['fields'] = list(fields)
+        return self.stream('elements.find', params, 'matches')
+
+    def stream(self, method, params, key):
+        """Send a request with "stream": true and yield the items of result[key] chunk by chunk.
+
+        Only the current chunk is held in memory. Raises QtServerError if the request fails.
+        """
+        request_id = self.send(method, params, stream=True)
+        try:
+            while True:
+                chunks = self._chunks.get(request_id)
+                if chunks:
+                    for item in chunks.popleft()['result'][key]:
+                        yield item
+                elif request_id in self._responses:
+                    for item in self.result(request_id).get(key, []):
+                        yield item
+                    return
+                else:
+                    self._dispatch(self._read_message())
+        finally:
+            self._chunks.pop(request_id, None)
+
+    def call_many(self, requests):
+        """Pipeline (method, params) pairs and return their results in request order."""
+        ids = [self.send(method, params) for method, params in requests]
+        return [self.result(request_id) for request_id in ids]
+
+    def _write_frame(self, payload):
+        if self.encoding == 'cbor':
+            header = struct.pack('>I', len(payload))
+        else:
+            header = str(len(payload)).encode('ascii') + b'\n'
+        try:
+            self.sock.sendall(header + payload)
+        except OSError as e:
+            raise QtConnectionError('Failed to send a request: {}'.format(e))
+
+    def _take_frame(self):
+        """Cut one complete frame off the receive buffer, None if it is not complete yet."""
+        if self.encoding == 'cbor':
+            if len(self._buffer) < 4:
+                return None
+            size = struct.unpack_from('>I', self._buffer)[0]
+            start = 4
+        else:
+            newline = self._buffer.find(b'\n')
+            if newline < 0:
+                return None
+            size = int(self._buffer[:newline])
+            start = newline + 1
+        if len(self._buffer) < start + size:
+            return None
+        frame = self._buffer[start:start + size]
+        self._buffer = self._buffer[start + size:]
+        return frame
+
+    def _read_frame(self):
+        # Partial data stays buffered, so a socket timeout never loses a frame.
+        frame = self._take_frame()
+        while frame is None:
+            chunk = self.sock.recv(64 * 1024)
+            if not chunk:
+                raise QtConnectionError('Connection closed by the Qt server')
+            self._buffer += chunk
+            frame = self._take_frame()
+        return frame
+
+    def _dispatch(self, message):
+        if 'id' not in message and 'method' in message:
+            self._notifications.append(message.get('params', {}))
+        elif 'chunk' in message:
+            self._chunks.setdefault(message['id'], collections.deque()).append(message)
+        else:
+            self._responses[message.get('id')] = message
+
+    def _read_message(self):
+        if self.encoding == 'cbor':
+            return cbor.loads(self._read_frame())
+        return json.loads(self._read_frame().decode('utf-8'))
+
+
+class TreeMirror(object):
+    """Local copy of an element tree, kept current with elements.treeDelta.
+
+    nodes maps element id -> summary (with "parent" and "depth").
+    """
+
+    def __init__(self, channel, root=0, max_depth=-1, fields=None):
+        self.channel = channel
+        self.root = root
+        self.max_depth = max_depth
+        self.fields = fields
+        self.version = 0
+        self.nodes = {}
+
+    def update(self):
+        """Fetch and apply the changes since the last update, return the delta."""
+        delta = self.channel.tree_delta(self.root, self.version, self.max_depth, self.fields)
+        if delta['full']:
+            self.nodes = {}
+        for element_id in delta['removed']:
+            self.nodes.pop(element_id, None)
+        for node in delta['added']:
+            self.nodes[node['id']] = node
+        for node in delta['modified']:
+            if node['id'] in self.nodes:
+                self.nodes[node['id']] = node
+        self.version = delta['version']
+        return delta